@@ -8,7 +8,7 @@ QT       += core gui
 QT       += serialport
 CONFIG += c++11
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets printsupport
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets printsupport svg
 
 TARGET = serial_port_plotter
 TEMPLATE = app
@@ -16,15 +16,35 @@ TEMPLATE = app
 SOURCES += main.cpp\
         mainwindow.cpp \
         qcustomplot/qcustomplot.cpp \
-        helpwindow.cpp
+        helpwindow.cpp \
+        hexviewwindow.cpp \
+        serialworker.cpp \
+        persistencemap.cpp \
+        triggerengine.cpp \
+        spectrumworker.cpp \
+        exportworker.cpp \
+        derivedchannels.cpp \
+        filterbank.cpp
 
 HEADERS  += mainwindow.hpp \
         qcustomplot/qcustomplot.h \
-        helpwindow.hpp
+        helpwindow.hpp \
+        hexviewwindow.hpp \
+        bytering.hpp \
+        serialworker.hpp \
+        rangetracker.hpp \
+        persistencemap.hpp \
+        serialframe.hpp \
+        triggerengine.hpp \
+        spectrumworker.hpp \
+        exportworker.hpp \
+        derivedchannels.hpp \
+        filterbank.hpp
 
 
 FORMS    += mainwindow.ui \
-    helpwindow.ui
+    helpwindow.ui \
+    hexviewwindow.ui
 
 RESOURCES += \
     res/serial_port_plotter.qrc \
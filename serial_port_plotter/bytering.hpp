@@ -0,0 +1,139 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#ifndef BYTERING_HPP
+#define BYTERING_HPP
+
+#include <QtGlobal>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+/**
+ * @brief 单生产者/单消费者无锁字节环形缓冲区
+ *
+ * 生产者（串口读取）调用 push()，消费者（界面刷新）调用 pop()/discard()/clear()。
+ * 缓冲区满时不会覆盖旧数据，多出来的字节直接丢弃并计入 droppedBytes()，
+ * 这样生产者永远不会被消费者阻塞。
+ */
+class ByteRing
+{
+public:
+    /* capacity 会被向上取整到 2 的幂 */
+    explicit ByteRing (quint32 capacity = 65536) :
+        m_head (0),
+        m_tail (0),
+        m_dropped (0)
+    {
+        quint32 size = 1;
+        while (size < capacity)
+            size <<= 1;
+        m_buffer.resize (size);
+        m_mask = size - 1;
+    }
+
+    quint32 capacity() const { return m_mask + 1; }
+
+    /* 可读取的字节数 */
+    quint32 available() const
+    {
+        return m_head.load (std::memory_order_acquire) - m_tail.load (std::memory_order_acquire);
+    }
+
+    /* 被丢弃的字节数（缓冲区满时） */
+    quint64 droppedBytes() const { return m_dropped.load (std::memory_order_relaxed); }
+
+    /**
+     * @brief 生产者：写入数据，返回实际写入的字节数
+     */
+    quint32 push (const char *data, quint32 len)
+    {
+        const quint32 head = m_head.load (std::memory_order_relaxed);
+        const quint32 tail = m_tail.load (std::memory_order_acquire);
+        const quint32 space = capacity() - (head - tail);
+        const quint32 n = len < space ? len : space;
+
+        const quint32 pos = head & m_mask;
+        const quint32 first = qMin (n, capacity() - pos);
+        std::memcpy (&m_buffer[pos], data, first);
+        std::memcpy (&m_buffer[0], data + first, n - first);
+
+        m_head.store (head + n, std::memory_order_release);
+        if (n < len)
+            m_dropped.fetch_add (len - n, std::memory_order_relaxed);
+        return n;
+    }
+
+    /**
+     * @brief 消费者：读出最多 maxLen 个字节，返回实际读出的字节数
+     */
+    quint32 pop (char *dest, quint32 maxLen)
+    {
+        const quint32 tail = m_tail.load (std::memory_order_relaxed);
+        const quint32 head = m_head.load (std::memory_order_acquire);
+        const quint32 count = head - tail;
+        const quint32 n = maxLen < count ? maxLen : count;
+
+        const quint32 pos = tail & m_mask;
+        const quint32 first = qMin (n, capacity() - pos);
+        std::memcpy (dest, &m_buffer[pos], first);
+        std::memcpy (dest + first, &m_buffer[0], n - first);
+
+        m_tail.store (tail + n, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * @brief 消费者：跳过最多 len 个最旧的字节
+     */
+    quint32 discard (quint32 len)
+    {
+        const quint32 tail = m_tail.load (std::memory_order_relaxed);
+        const quint32 head = m_head.load (std::memory_order_acquire);
+        const quint32 n = qMin (len, head - tail);
+        m_tail.store (tail + n, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * @brief 消费者：清空缓冲区
+     */
+    void clear()
+    {
+        m_tail.store (m_head.load (std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    std::vector<char> m_buffer;
+    quint32 m_mask;
+    std::atomic<quint32> m_head;                                                          // 写位置，只由生产者修改
+    std::atomic<quint32> m_tail;                                                          // 读位置，只由消费者修改
+    std::atomic<quint64> m_dropped;
+
+    Q_DISABLE_COPY (ByteRing)
+};
+
+#endif // BYTERING_HPP
@@ -0,0 +1,436 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#include "derivedchannels.hpp"
+#include <qmath.h>
+#include <qnumeric.h>
+
+/**
+ * @brief 编译表达式
+ * @param text 表达式，例如 "ch2 - ch1"
+ * @param error 输出，编译失败的原因
+ * @return true 编译成功，失败时保留之前的表达式
+ */
+bool ChannelExpression::compile (const QString &text, QString *error)
+{
+    Parser parser (text);
+    bool ok = parser.parseSum();
+    parser.skipSpaces();
+    if (ok && parser.pos < text.size())
+        ok = parser.fail (QString ("多余的字符 '%1'").arg (text[parser.pos]));
+    if (ok && parser.maxDepth > DERIVED_STACK_MAX)
+        ok = parser.fail ("表达式太复杂");
+
+    if (!ok)
+    {
+        if (error != nullptr)
+            *error = parser.error;
+        return false;
+    }
+
+    m_text = text.trimmed();
+    m_code = parser.code;
+    return true;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 按列对一组帧计算表达式
+ *
+ * 栈的每一层是一列，每条指令对整组帧执行一次循环。栈的深度在编译时已经检查过，不分配内存。
+ * 结果是 NaN 或 Inf 时（帧中没有用到的通道、sqrt(-1)、除以0）输出 DERIVED_INVALID。
+ * @param frames 这一组帧，values[firstField] 是 ch0
+ * @param count 帧数，不超过 DERIVED_BLOCK
+ * @param firstField ch0 在 values 中的下标
+ * @param fields 每一帧的字段数，chN 只能用到 values[fields - 1]
+ * @param results 输出，每一帧一个值
+ */
+void ChannelExpression::evaluate (const SerialFrame *frames, int count, int firstField, int fields, double *results) const
+{
+    double stack[DERIVED_STACK_MAX][DERIVED_BLOCK];
+    int top = -1;
+
+    for (const Instruction &ins : m_code)
+    {
+        /* 压栈的指令写入新的一列，二元运算把结果写入下一层，一元运算原地计算 */
+        const bool binary = (ins.op >= OP_ADD && ins.op <= OP_POW) || ins.op >= OP_MIN;
+        if (ins.op <= OP_TIME)
+            top++;
+        else if (binary)
+            top--;
+        double *x = stack[top];
+        const double *y = binary ? stack[top + 1] : nullptr;
+
+        switch (ins.op)
+        {
+        case OP_CONST:
+            for (int j = 0; j < count; j++) x[j] = ins.value;
+            break;
+        case OP_CHANNEL:
+            if (firstField + ins.channel < fields)
+                for (int j = 0; j < count; j++) x[j] = frames[j].values[firstField + ins.channel];
+            else
+                for (int j = 0; j < count; j++) x[j] = qQNaN();
+            break;
+        case OP_TIME:
+            for (int j = 0; j < count; j++) x[j] = frames[j].timestamp;
+            break;
+        case OP_ADD:   for (int j = 0; j < count; j++) x[j] += y[j]; break;
+        case OP_SUB:   for (int j = 0; j < count; j++) x[j] -= y[j]; break;
+        case OP_MUL:   for (int j = 0; j < count; j++) x[j] *= y[j]; break;
+        case OP_DIV:   for (int j = 0; j < count; j++) x[j] /= y[j]; break;
+        case OP_POW:   for (int j = 0; j < count; j++) x[j] = std::pow (x[j], y[j]); break;
+        case OP_MIN:   for (int j = 0; j < count; j++) x[j] = qMin (x[j], y[j]); break;
+        case OP_MAX:   for (int j = 0; j < count; j++) x[j] = qMax (x[j], y[j]); break;
+        case OP_ATAN2: for (int j = 0; j < count; j++) x[j] = std::atan2 (x[j], y[j]); break;
+        case OP_NEG:   for (int j = 0; j < count; j++) x[j] = -x[j]; break;
+        case OP_SQRT:  for (int j = 0; j < count; j++) x[j] = std::sqrt (x[j]); break;
+        case OP_ABS:   for (int j = 0; j < count; j++) x[j] = std::fabs (x[j]); break;
+        case OP_SIN:   for (int j = 0; j < count; j++) x[j] = std::sin (x[j]); break;
+        case OP_COS:   for (int j = 0; j < count; j++) x[j] = std::cos (x[j]); break;
+        case OP_TAN:   for (int j = 0; j < count; j++) x[j] = std::tan (x[j]); break;
+        case OP_ASIN:  for (int j = 0; j < count; j++) x[j] = std::asin (x[j]); break;
+        case OP_ACOS:  for (int j = 0; j < count; j++) x[j] = std::acos (x[j]); break;
+        case OP_ATAN:  for (int j = 0; j < count; j++) x[j] = std::atan (x[j]); break;
+        case OP_EXP:   for (int j = 0; j < count; j++) x[j] = std::exp (x[j]); break;
+        case OP_LOG:   for (int j = 0; j < count; j++) x[j] = std::log (x[j]); break;
+        case OP_LOG10: for (int j = 0; j < count; j++) x[j] = std::log10 (x[j]); break;
+        case OP_FLOOR: for (int j = 0; j < count; j++) x[j] = std::floor (x[j]); break;
+        case OP_CEIL:  for (int j = 0; j < count; j++) x[j] = std::ceil (x[j]); break;
+        }
+    }
+
+    for (int j = 0; j < count; j++)
+    {
+        results[j] = top == 0 && qIsFinite (stack[0][j]) ? stack[0][j] : DERIVED_INVALID;
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 添加一条指令并记录运行时栈的最大深度
+ */
+void ChannelExpression::Parser::append (OpCode op, int channel, double value)
+{
+    switch (op)
+    {
+    case OP_CONST: case OP_CHANNEL: case OP_TIME:
+        depth++;
+        break;
+    case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_POW:
+    case OP_MIN: case OP_MAX: case OP_ATAN2:
+        depth--;
+        break;
+    default://一元运算不改变栈深度
+        break;
+    }
+    maxDepth = qMax (maxDepth, depth);
+
+    Instruction ins;
+    ins.op = op;
+    ins.channel = channel;
+    ins.value = value;
+    code.append (ins);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 记录第一个错误和它的位置
+ * @return 总是 false
+ */
+bool ChannelExpression::Parser::fail (const QString &message)
+{
+    if (error.isEmpty())
+        error = QString ("第 %1 个字符: %2").arg (pos + 1).arg (message);
+    return false;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void ChannelExpression::Parser::skipSpaces()
+{
+    while (pos < text.size() && text[pos].isSpace())
+        pos++;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 下一个非空白字符是 c 时跳过它
+ */
+bool ChannelExpression::Parser::accept (QChar c)
+{
+    skipSpaces();
+    if (pos < text.size() && text[pos] == c)
+    {
+        pos++;
+        return true;
+    }
+    return false;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief sum := product (('+' | '-') product)*
+ */
+bool ChannelExpression::Parser::parseSum()
+{
+    if (!parseProduct())
+        return false;
+    for (;;)
+    {
+        if (accept ('+'))
+        {
+            if (!parseProduct())
+                return false;
+            append (OP_ADD);
+        }
+        else if (accept ('-'))
+        {
+            if (!parseProduct())
+                return false;
+            append (OP_SUB);
+        }
+        else
+        {
+            return true;
+        }
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief product := unary (('*' | '/') unary)*
+ */
+bool ChannelExpression::Parser::parseProduct()
+{
+    if (!parseUnary())
+        return false;
+    for (;;)
+    {
+        if (accept ('*'))
+        {
+            if (!parseUnary())
+                return false;
+            append (OP_MUL);
+        }
+        else if (accept ('/'))
+        {
+            if (!parseUnary())
+                return false;
+            append (OP_DIV);
+        }
+        else
+        {
+            return true;
+        }
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief unary := ('-' | '+') unary | power，-a^2 等于 -(a^2)
+ */
+bool ChannelExpression::Parser::parseUnary()
+{
+    if (accept ('-'))
+    {
+        if (!parseUnary())
+            return false;
+        append (OP_NEG);
+        return true;
+    }
+    if (accept ('+'))
+        return parseUnary();
+    return parsePower();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief power := primary ('^' unary)?，右结合
+ */
+bool ChannelExpression::Parser::parsePower()
+{
+    if (!parsePrimary())
+        return false;
+    if (accept ('^'))
+    {
+        if (!parseUnary())
+            return false;
+        append (OP_POW);
+    }
+    return true;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief primary := 数字 | chN | t | pi | 函数 '(' 参数 ')' | '(' sum ')'
+ */
+bool ChannelExpression::Parser::parsePrimary()
+{
+    skipSpaces();
+    if (pos >= text.size())
+        return fail ("表达式不完整");
+
+    if (accept ('('))
+    {
+        if (!parseSum())
+            return false;
+        if (!accept (')'))
+            return fail ("缺少 ')'");
+        return true;
+    }
+
+    const int start = pos;
+    QChar c = text[pos];
+
+    /* 数字，可以带小数点和指数 */
+    if (c.isDigit() || c == '.')
+    {
+        while (pos < text.size() && (text[pos].isDigit() || text[pos] == '.'))
+            pos++;
+        if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E'))
+        {
+            pos++;
+            if (pos < text.size() && (text[pos] == '+' || text[pos] == '-'))
+                pos++;
+            while (pos < text.size() && text[pos].isDigit())
+                pos++;
+        }
+        bool ok = false;
+        double value = text.mid (start, pos - start).toDouble (&ok);
+        if (!ok)
+        {
+            pos = start;
+            return fail ("数字格式错误");
+        }
+        append (OP_CONST, 0, value);
+        return true;
+    }
+
+    if (!c.isLetter())
+        return fail (QString ("意外的字符 '%1'").arg (c));
+
+    while (pos < text.size() && (text[pos].isLetterOrNumber() || text[pos] == '_'))
+        pos++;
+    const QString name = text.mid (start, pos - start).toLower();
+
+    if (accept ('('))
+        return parseCall (name);
+
+    if (name == "t")
+    {
+        append (OP_TIME);
+        return true;
+    }
+    if (name == "pi")
+    {
+        append (OP_CONST, 0, M_PI);
+        return true;
+    }
+    if (name.startsWith ("ch"))
+    {
+        bool ok = false;
+        int channel = name.mid (2).toInt (&ok);
+        if (ok && channel >= 0)
+        {
+            append (OP_CHANNEL, channel);
+            return true;
+        }
+    }
+    pos = start;
+    return fail (QString ("未知的名称 '%1'").arg (name));
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 函数调用，'(' 已经读取
+ * @param name 函数名（小写）
+ */
+bool ChannelExpression::Parser::parseCall (const QString &name)
+{
+    static const struct
+    {
+        const char *name;
+        OpCode op;
+        int arguments;
+    } functions[] = {
+        {"sqrt", OP_SQRT, 1}, {"abs", OP_ABS, 1},
+        {"sin", OP_SIN, 1}, {"cos", OP_COS, 1}, {"tan", OP_TAN, 1},
+        {"asin", OP_ASIN, 1}, {"acos", OP_ACOS, 1}, {"atan", OP_ATAN, 1},
+        {"exp", OP_EXP, 1}, {"log", OP_LOG, 1}, {"log10", OP_LOG10, 1},
+        {"floor", OP_FLOOR, 1}, {"ceil", OP_CEIL, 1},
+        {"min", OP_MIN, 2}, {"max", OP_MAX, 2}, {"atan2", OP_ATAN2, 2}, {"pow", OP_POW, 2}
+    };
+
+    for (const auto &function : functions)
+    {
+        if (name != QLatin1String (function.name))
+            continue;
+
+        for (int i = 0; i < function.arguments; i++)
+        {
+            if (i > 0 && !accept (','))
+                return fail (QString ("%1() 需要 %2 个参数").arg (name).arg (function.arguments));
+            if (!parseSum())
+                return false;
+        }
+        if (!accept (')'))
+            return fail (QString ("%1() 需要 %2 个参数").arg (name).arg (function.arguments));
+        append (function.op);
+        return true;
+    }
+    return fail (QString ("未知的函数 '%1'").arg (name));
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 在一批帧的字段后面追加派生通道的值
+ *
+ * 每 DERIVED_BLOCK 帧为一组按列计算。表达式只使用前 fields 个字段，不使用其它派生通道；
+ * 调用者已经把短的帧补齐到 fields 个字段，派生通道在每一帧中的位置相同。
+ * 调用者按字段数加派生通道数预留了 values 的容量，追加时不会重新分配。
+ * @param frames 一次读取解析出来的帧
+ * @param fields 每一帧的字段数
+ */
+void DerivedChannels::apply (QVector<SerialFrame> &frames, int fields) const
+{
+    if (expressions.isEmpty())
+        return;
+
+    double results[DERIVED_BLOCK];
+    for (int start = 0; start < frames.size(); start += DERIVED_BLOCK)
+    {
+        const int count = qMin (DERIVED_BLOCK, frames.size() - start);
+        SerialFrame *block = frames.data() + start;
+        for (const ChannelExpression &expression : expressions)
+        {
+            expression.evaluate (block, count, firstField, fields, results);
+            for (int j = 0; j < count; j++)
+            {
+                block[j].values.append (results[j]);
+            }
+        }
+    }
+}
@@ -0,0 +1,125 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+
+#ifndef DERIVEDCHANNELS_HPP
+#define DERIVEDCHANNELS_HPP
+
+#include <QVector>
+#include <QString>
+#include <QMetaType>
+#include "serialframe.hpp"
+
+#define DERIVED_STACK_MAX   32                                                            // Deepest evaluation stack an expression may need
+#define DERIVED_BLOCK       64                                                            // Frames evaluated together, one stack column per frame
+#define DERIVED_INVALID     0                                                             // Value of a derived channel whose result is NaN or Inf
+#define DERIVED_SEPARATOR   ';'                                                           // Separates the expressions in lineDerived
+
+/**
+ * One derived channel, e.g. "ch2 - ch1" or "sqrt(ch0^2 + ch1^2)".
+ *
+ * The text is compiled once into postfix bytecode. evaluate() runs it column
+ * wise over a block of frames: every instruction is one loop over the block,
+ * so the dispatch costs once per block instead of once per frame, and the
+ * fixed size stack of columns never allocates.
+ *
+ * chN is field N of the message. With FILTER_VIEW_FILTERED it is the
+ * filtered value, with FILTER_VIEW_BOTH the raw value: the filtered copies
+ * appended after the fields can't be used.
+ *
+ * A result that is NaN or Inf (a channel the frame doesn't have, sqrt(-1),
+ * division by zero) is replaced by DERIVED_INVALID.
+ *
+ * Grammar: numbers, chN (channel N), t (host time of the read in seconds), pi,
+ * + - * / ^, parentheses and the functions sqrt abs sin cos tan asin acos
+ * atan exp log log10 floor ceil min max atan2 pow.
+ */
+class ChannelExpression
+{
+public:
+    bool compile (const QString &text, QString *error);                                   // false and error set when text is not valid
+    QString text() const { return m_text; }
+                                                                                          // One result per frame, count <= DERIVED_BLOCK, chN < fields
+    void evaluate (const SerialFrame *frames, int count, int firstField, int fields, double *results) const;
+
+private:
+    /* evaluate() tells push, binary and unary instructions apart by their range, keep the order */
+    enum OpCode
+    {
+        OP_CONST, OP_CHANNEL, OP_TIME,
+        OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_POW, OP_NEG,
+        OP_SQRT, OP_ABS, OP_SIN, OP_COS, OP_TAN, OP_ASIN, OP_ACOS, OP_ATAN,
+        OP_EXP, OP_LOG, OP_LOG10, OP_FLOOR, OP_CEIL,
+        OP_MIN, OP_MAX, OP_ATAN2
+    };
+
+    struct Instruction
+    {
+        OpCode op;
+        int channel;                                                                      // OP_CHANNEL
+        double value;                                                                     // OP_CONST
+    };
+
+    /* Recursive descent parser, emits the instructions in postfix order */
+    struct Parser
+    {
+        const QString &text;
+        int pos;
+        QString error;
+        QVector<Instruction> code;
+        int depth;                                                                        // Stack depth after the emitted instructions
+        int maxDepth;
+
+        explicit Parser (const QString &source) : text (source), pos (0), depth (0), maxDepth (0) {}
+
+        void append (OpCode op, int channel = 0, double value = 0);
+        bool fail (const QString &message);
+        void skipSpaces();
+        bool accept (QChar c);
+        bool parseSum();
+        bool parseProduct();
+        bool parseUnary();
+        bool parsePower();
+        bool parsePrimary();
+        bool parseCall (const QString &name);
+    };
+
+    QString m_text;
+    QVector<Instruction> m_code;
+};
+
+/* Derived channels of every port, sent from the GUI thread to every SerialWorker */
+struct DerivedChannels
+{
+    QVector<ChannelExpression> expressions;
+    int firstField = 0;                                                                   // Field of ch0 in SerialFrame::values (1 with device time)
+
+    int count() const { return expressions.size(); }
+    void apply (QVector<SerialFrame> &frames, int fields) const;                          // Append one value per expression to every frame, chN < fields
+};
+Q_DECLARE_METATYPE(DerivedChannels)
+
+#endif // DERIVEDCHANNELS_HPP
@@ -0,0 +1,157 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#include "exportworker.hpp"
+#include <QPdfWriter>
+#include <QSvgGenerator>
+
+/**
+ * @brief Constructor
+ */
+ExportWorker::ExportWorker(QObject *parent) :
+    QObject (parent)
+{
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 在GUI线程中把当前显示的绘图区记录为 QPicture
+ *
+ * 只记录绘图命令，耗时和一次重绘相当；记录的是此刻可见范围内的数据，
+ * 之后新到的数据不会影响导出的内容。
+ * @param width, height 导出的绘图区大小（像素）
+ * @param scale PNG 的像素与绘图区像素之比
+ */
+ExportJob ExportWorker::record (QCustomPlot *plot, const QString &fileName, int format, int width, int height, double scale)
+{
+    ExportJob job;
+    job.fileName = fileName;
+    job.format = format;
+    job.size = QSize (width, height);
+    job.scale = scale;
+    job.dpi = plot->logicalDpiX();
+
+    QCPPainter painter (&job.picture);
+    if (format == EXPORT_PDF || format == EXPORT_SVG)//矢量格式，不使用快速画线和缓存的位图
+        painter.setMode (QCPPainter::pmVectorized);
+    else if (scale > 1.0)//与 toPixmap 相同，放大时不使用 cosmetic 画笔
+        painter.setMode (QCPPainter::pmNonCosmetic);
+    plot->toPainter (&painter, width, height);
+    painter.end();
+    return job;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 在工作线程中绘制并保存一个导出任务
+ */
+void ExportWorker::exportPlot (ExportJob job)
+{
+    emit exportProgress (job.fileName, 0);
+    bool success;
+    switch (job.format)
+    {
+    case EXPORT_PDF: success = writePdf (job); break;
+    case EXPORT_SVG: success = writeSvg (job); break;
+    default: success = writePng (job); break;
+    }
+    emit exportProgress (job.fileName, 100);
+    emit exportFinished (job.fileName, success);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 把记录的绘图命令画到 QImage 上并编码为 PNG
+ *
+ * 工作线程中不能使用 QPixmap，所以这里用 QImage 代替 QCustomPlot::toPixmap。
+ */
+bool ExportWorker::writePng (const ExportJob &job)
+{
+    QImage image (qRound (job.size.width() * job.scale), qRound (job.size.height() * job.scale), QImage::Format_ARGB32_Premultiplied);
+    if (image.isNull())
+        return false;
+
+    /* 按绘图区的 DPI 绘制，文字大小与屏幕上一致 */
+    image.setDotsPerMeterX (qRound (job.dpi / 0.0254));
+    image.setDotsPerMeterY (qRound (job.dpi / 0.0254));
+    image.fill (Qt::transparent);
+
+    QPainter painter (&image);
+    painter.scale (job.scale, job.scale);
+    painter.drawPicture (0, 0, job.picture);
+    painter.end();
+    emit exportProgress (job.fileName, 50);
+
+    image.setDotsPerMeterX (qRound (EXPORT_PNG_DPI / 0.0254));//保存在PNG文件中的分辨率
+    image.setDotsPerMeterY (qRound (EXPORT_PNG_DPI / 0.0254));
+    return image.save (job.fileName, "PNG", EXPORT_PNG_QUALITY);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 把记录的绘图命令写入 PDF，保持矢量格式
+ *
+ * 页面大小与绘图区相同，分辨率为绘图区的 DPI，一个设备像素对应一个绘图区像素。
+ */
+bool ExportWorker::writePdf (const ExportJob &job)
+{
+    QPdfWriter writer (job.fileName);
+    writer.setCreator ("Serial Port Plotter");
+    writer.setResolution (job.dpi);
+    writer.setPageMargins (QMarginsF (0, 0, 0, 0));
+    writer.setPageSize (QPageSize (QSizeF (job.size) * 72.0 / job.dpi, QPageSize::Point, QString(), QPageSize::ExactMatch));
+
+    QPainter painter;
+    if (!painter.begin (&writer))
+        return false;
+    emit exportProgress (job.fileName, 50);
+    painter.drawPicture (0, 0, job.picture);
+    return painter.end();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 把记录的绘图命令写入 SVG
+ *
+ * QSvgGenerator 在 painter.end() 时才把整个文档写入文件，文档的大小取决于导出宽度，
+ * 坐标单位是绘图区像素。
+ */
+bool ExportWorker::writeSvg (const ExportJob &job)
+{
+    QSvgGenerator generator;
+    generator.setFileName (job.fileName);
+    generator.setTitle ("Serial Port Plotter");
+    generator.setSize (job.size);
+    generator.setViewBox (QRect (QPoint (0, 0), job.size));
+    generator.setResolution (job.dpi);
+
+    QPainter painter;
+    if (!painter.begin (&generator))
+        return false;
+    emit exportProgress (job.fileName, 50);
+    painter.drawPicture (0, 0, job.picture);
+    return painter.end();
+}
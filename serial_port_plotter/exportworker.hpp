@@ -0,0 +1,89 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#ifndef EXPORTWORKER_HPP
+#define EXPORTWORKER_HPP
+
+#include <QObject>
+#include <QPicture>
+#include <QMetaType>
+#include "qcustomplot/qcustomplot.h"
+
+/* Export file format */
+#define EXPORT_PNG          0
+#define EXPORT_PDF          1
+#define EXPORT_SVG          2
+
+#define EXPORT_PNG_QUALITY  50                                                            // Same as the former savePng call
+#define EXPORT_PNG_DPI      96                                                            // Resolution written to the PNG header
+
+/* Plot recorded on the GUI thread, rendered and written by the ExportWorker */
+struct ExportJob
+{
+    QString fileName;
+    int format = EXPORT_PNG;                                                              // EXPORT_*
+    QPicture picture;                                                                     // Paint commands of the plot, in plot pixels
+    QSize size;                                                                           // Plot size in pixels
+    double scale = 1;                                                                     // Image pixels per plot pixel (PNG only)
+    int dpi = EXPORT_PNG_DPI;                                                             // Logical DPI of the plot widget, keeps the font sizes
+};
+Q_DECLARE_METATYPE(ExportJob)
+
+/**
+ * Writes PNG, PDF and SVG exports of the plot. Lives in its own QThread: the
+ * GUI thread only records the visible plot into a QPicture (no rasterizing,
+ * no encoding), rasterizing and encoding the picture run here, so the replot
+ * and the serial ports keep running while a file is written.
+ *
+ * The plot is recorded at the export size, so graph lines already went
+ * through the adaptive min/max sampling of QCPGraph at the export width:
+ * the size of a PDF or SVG grows with the width, not with the data.
+ * The picture, the PDF page and the SVG document are all held in memory
+ * until the file is written, so they are bounded by the same width.
+ */
+class ExportWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ExportWorker(QObject *parent = nullptr);
+                                                                                          // Must run in the GUI thread
+    static ExportJob record(QCustomPlot *plot, const QString &fileName, int format, int width, int height, double scale);
+
+public slots:
+    void exportPlot(ExportJob job);
+
+signals:
+    void exportProgress(QString fileName, int percent);
+    void exportFinished(QString fileName, bool success);
+
+private:
+    bool writePng(const ExportJob &job);
+    bool writePdf(const ExportJob &job);
+    bool writeSvg(const ExportJob &job);
+};
+
+#endif // EXPORTWORKER_HPP
@@ -0,0 +1,335 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#include "filterbank.hpp"
+#include <QStringList>
+#include <qmath.h>
+#include <algorithm>
+
+/**
+ * @brief 按 RBJ Audio EQ Cookbook 设计二阶滤波器
+ * @param type "lowpass"、"highpass" 或 "bandpass"（峰值增益 0 dB）
+ * @param frequency 截止（中心）频率 / 采样率，0 到 0.5
+ * @param q 品质因数
+ */
+static void designBiquad (FilterStage *stage, const QString &type, double frequency, double q)
+{
+    double w0 = 2 * M_PI * frequency;
+    double cosw0 = qCos (w0);
+    double alpha = qSin (w0) / (2 * q);
+    double a0 = 1 + alpha;
+
+    if (type == "lowpass")
+    {
+        stage->b0 = (1 - cosw0) / 2;
+        stage->b1 = 1 - cosw0;
+        stage->b2 = (1 - cosw0) / 2;
+    }
+    else if (type == "highpass")
+    {
+        stage->b0 = (1 + cosw0) / 2;
+        stage->b1 = -(1 + cosw0);
+        stage->b2 = (1 + cosw0) / 2;
+    }
+    else//bandpass
+    {
+        stage->b0 = alpha;
+        stage->b1 = 0;
+        stage->b2 = -alpha;
+    }
+    stage->a1 = -2 * cosw0;
+    stage->a2 = 1 - alpha;
+
+    stage->type = FILTER_BIQUAD;
+    stage->b0 /= a0;
+    stage->b1 /= a0;
+    stage->b2 /= a0;
+    stage->a1 /= a0;
+    stage->a2 /= a0;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 解析滤波器链，多个滤波器用 ';' 分隔，按顺序执行
+ *
+ * avg N 滑动平均，ema a 指数平均（0 < a <= 1），median N 中值，
+ * lowpass f [q]、highpass f [q]、bandpass f [q]，f 是截止频率与采样率之比
+ *
+ * @param text 例如 "median 5; lowpass 0.05"，为空时关闭滤波
+ * @param error 输出，解析失败的原因
+ * @return true 解析成功，失败时保留之前的滤波器链
+ */
+bool FilterSettings::setChain (const QString &text, QString *error)
+{
+    QVector<FilterStage> chain;
+    const QStringList parts = text.split (FILTER_SEPARATOR);
+    for (const QString &part : parts)
+    {
+        const QStringList words = part.simplified().split (' ');
+        if (words[0].isEmpty())
+            continue;
+
+        const QString name = words[0].toLower();
+        bool ok = words.size() >= 2;
+        double parameter = ok ? words[1].toDouble (&ok) : 0;
+        FilterStage stage;
+
+        if (name == "avg" || name == "median")
+        {
+            ok = ok && words.size() == 2 && parameter >= 1 && parameter <= FILTER_WINDOW_MAX && parameter == qFloor (parameter);
+            stage.type = name == "avg" ? FILTER_BOXCAR : FILTER_MEDIAN;
+            stage.window = int(parameter);
+        }
+        else if (name == "ema")
+        {
+            ok = ok && words.size() == 2 && parameter > 0 && parameter <= 1;
+            stage.type = FILTER_EMA;
+            stage.alpha = parameter;
+        }
+        else if (name == "lowpass" || name == "highpass" || name == "bandpass")
+        {
+            double q = FILTER_Q_DEFAULT;
+            if (ok && words.size() == 3)
+                q = words[2].toDouble (&ok);
+            ok = ok && words.size() <= 3 && parameter > 0 && parameter < 0.5 && q > 0;
+            if (ok)
+                designBiquad (&stage, name, parameter, q);
+        }
+        else
+        {
+            if (error != nullptr)
+                *error = QString ("未知的滤波器 '%1'").arg (words[0]);
+            return false;
+        }
+
+        if (!ok)
+        {
+            if (error != nullptr)
+                *error = QString ("'%1' 的参数错误").arg (part.simplified());
+            return false;
+        }
+        chain.append (stage);
+    }
+
+    stages = chain;
+    return true;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 设置滤波器链，所有通道从下一个采样重新开始
+ */
+void FilterBank::setSettings (const FilterSettings &settings)
+{
+    m_settings = settings;
+    m_state = QVector<StageState> (settings.stages.size());
+    m_channels = 0;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 原始和滤波同时显示时，每个通道在字段后面追加一份滤波后的拷贝
+ * @param fields 一帧的字段数
+ * @return process() 追加的字段数，用于预留容量
+ */
+int FilterBank::appendedFields (int fields) const
+{
+    if (!m_settings.enabled() || m_settings.view != FILTER_VIEW_BOTH)
+        return 0;
+    return fields - qMin (m_settings.firstField, fields);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 对一批帧滤波
+ *
+ * 一个滤波器处理完整批数据后再执行下一个，每个滤波器的状态按通道连续存放。
+ * FILTER_VIEW_BOTH 时原始字段不变，滤波结果写入追加的拷贝。
+ */
+void FilterBank::process (QVector<SerialFrame> &frames)
+{
+    if (!m_settings.enabled())
+        return;
+
+    const bool both = m_settings.view == FILTER_VIEW_BOTH;
+    int channels = m_channels;
+    for (SerialFrame &frame : frames)
+    {
+        const int fields = frame.values.size();
+        const int count = fields - qMin (m_settings.firstField, fields);
+        channels = qMax (channels, count);
+        if (both)
+        {
+            for (int i = fields - count; i < fields; i++)
+            {
+                double value = frame.values[i];
+                frame.values.append (value);
+            }
+        }
+    }
+    if (channels > m_channels)
+    {
+        resize (channels);
+    }
+
+    for (int stage = 0; stage < m_state.size(); stage++)
+    {
+        for (SerialFrame &frame : frames)
+        {
+            const int fields = frame.values.size();
+            const int first = qMin (m_settings.firstField, fields);
+            const int count = both ? (fields - first) / 2 : fields - first;
+            runStage (stage, frame.values.data() + fields - count, count);
+        }
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 增加通道，已有通道的状态不变，新通道从第一个采样开始
+ */
+void FilterBank::resize (int channels)
+{
+    for (int stage = 0; stage < m_state.size(); stage++)
+    {
+        const FilterStage &filter = m_settings.stages[stage];
+        StageState &state = m_state[stage];
+
+        state.state1.resize (channels);
+        state.state2.resize (channels);
+        state.count.resize (channels);
+        state.head.resize (channels);
+        if (filter.type == FILTER_BOXCAR || filter.type == FILTER_MEDIAN)
+            state.ring.resize (channels * filter.window);
+        if (filter.type == FILTER_MEDIAN)
+            state.sorted.resize (channels * filter.window);
+    }
+    m_channels = channels;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 用一个滤波器处理一帧的通道
+ * @param stage 滤波器链中的下标
+ * @param values 这一帧的 ch0，结果写回原处
+ * @param count 通道数，不超过 m_channels
+ */
+void FilterBank::runStage (int stage, double *values, int count)
+{
+    const FilterStage &filter = m_settings.stages[stage];
+    StageState &state = m_state[stage];
+    double *state1 = state.state1.data();
+    double *state2 = state.state2.data();
+    int *seen = state.count.data();
+    int *head = state.head.data();
+    const int window = filter.window;
+
+    switch (filter.type)
+    {
+    case FILTER_BOXCAR:
+        for (int ch = 0; ch < count; ch++)
+        {
+            double *ring = state.ring.data() + ch * window;
+            if (seen[ch] < window)
+                seen[ch]++;
+            else
+                state1[ch] -= ring[head[ch]];
+            state1[ch] += values[ch];
+            ring[head[ch]] = values[ch];
+            if (++head[ch] == window)
+            {
+                head[ch] = 0;
+                /* 每个窗口重新求和一次，累加误差不会随时间增长 */
+                double sum = 0;
+                for (int i = 0; i < seen[ch]; i++)
+                    sum += ring[i];
+                state1[ch] = sum;
+            }
+            values[ch] = state1[ch] / seen[ch];
+        }
+        break;
+
+    case FILTER_EMA:
+        for (int ch = 0; ch < count; ch++)
+        {
+            if (seen[ch] == 0)
+            {
+                seen[ch] = 1;
+                state1[ch] = values[ch];
+            }
+            state1[ch] += filter.alpha * (values[ch] - state1[ch]);
+            values[ch] = state1[ch];
+        }
+        break;
+
+    case FILTER_BIQUAD://转置直接II型
+        for (int ch = 0; ch < count; ch++)
+        {
+            double x = values[ch];
+            if (seen[ch] == 0)//从第一个采样的稳态开始，没有启动时的跳变
+            {
+                seen[ch] = 1;
+                double y = x * (filter.b0 + filter.b1 + filter.b2) / (1 + filter.a1 + filter.a2);
+                state2[ch] = filter.b2 * x - filter.a2 * y;
+                state1[ch] = y - filter.b0 * x;
+            }
+            double y = filter.b0 * x + state1[ch];
+            state1[ch] = filter.b1 * x - filter.a1 * y + state2[ch];
+            state2[ch] = filter.b2 * x - filter.a2 * y;
+            values[ch] = y;
+        }
+        break;
+
+    case FILTER_MEDIAN:
+        for (int ch = 0; ch < count; ch++)
+        {
+            double *ring = state.ring.data() + ch * window;
+            double *sorted = state.sorted.data() + ch * window;
+            double x = values[ch];
+            int n = seen[ch];
+
+            if (n == window)//删除窗口中最早的采样
+            {
+                double *old = std::lower_bound (sorted, sorted + n, ring[head[ch]]);
+                std::copy (old + 1, sorted + n, old);
+                n--;
+            }
+            double *slot = std::upper_bound (sorted, sorted + n, x);
+            std::copy_backward (slot, sorted + n, sorted + n + 1);
+            *slot = x;
+            n++;
+
+            seen[ch] = n;
+            ring[head[ch]] = x;
+            if (++head[ch] == window)
+                head[ch] = 0;
+            values[ch] = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+        }
+        break;
+
+    default: break;
+    }
+}
@@ -0,0 +1,107 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+
+#ifndef FILTERBANK_HPP
+#define FILTERBANK_HPP
+
+#include <QVector>
+#include <QString>
+#include <QMetaType>
+#include "serialframe.hpp"
+
+/* Filter stage type */
+#define FILTER_BOXCAR       0                                                             // Moving average over window samples
+#define FILTER_EMA          1                                                             // Exponential average, y += alpha * (x - y)
+#define FILTER_BIQUAD       2                                                             // Low, high or band pass biquad
+#define FILTER_MEDIAN       3                                                             // Running median over window samples
+
+#define FILTER_WINDOW_MAX   1024                                                          // Longest boxcar or median window
+#define FILTER_Q_DEFAULT    0.70710678118654752                                           // Butterworth Q of the biquads
+#define FILTER_SEPARATOR    ';'                                                           // Separates the stages in lineFilter
+
+/* Display of the filtered channels (index of comboFilterView) */
+#define FILTER_VIEW_FILTERED 0                                                            // Channels are replaced by their filtered values
+#define FILTER_VIEW_BOTH     1                                                            // Filtered copies are appended after the fields
+
+/* One stage of the filter chain, biquad coefficients are designed on the GUI thread */
+struct FilterStage
+{
+    int type = FILTER_BOXCAR;                                                             // FILTER_*
+    int window = 1;                                                                       // Boxcar and median
+    double alpha = 1;                                                                     // Exponential average
+    double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;                                        // Biquad, normalized to a0 = 1
+};
+
+/* Filter chain, sent from the GUI thread to every SerialWorker */
+struct FilterSettings
+{
+    QVector<FilterStage> stages;                                                          // Applied in order to every channel
+    int view = FILTER_VIEW_FILTERED;                                                      // FILTER_VIEW_*
+    int firstField = 0;                                                                   // Field of ch0 in SerialFrame::values (1 with device time)
+
+    bool enabled() const { return !stages.isEmpty(); }
+    bool setChain (const QString &text, QString *error);                                  // e.g. "median 5; lowpass 0.05", false and error set when not valid
+};
+Q_DECLARE_METATYPE(FilterSettings)
+
+/**
+ * Per channel filter chain of one port. Runs in the acquisition thread on
+ * every batch of parsed frames, before the derived channels, the trigger
+ * and the graphs see them.
+ *
+ * The state is stored structure of arrays: every state variable of a stage
+ * is one array indexed by channel, and a stage runs over the whole batch
+ * before the next one, so the state of a stage stays in cache and the
+ * inner loop walks the channels of a frame in order.
+ */
+class FilterBank
+{
+public:
+    void setSettings (const FilterSettings &settings);                                    // Also drops the filter state
+    int appendedFields (int fields) const;                                                // Fields process() appends to a frame of fields fields
+    void process (QVector<SerialFrame> &frames);                                          // Filter a batch of frames in place
+
+private:
+    struct StageState
+    {
+        QVector<double> state1;                                                           // Boxcar sum, average, biquad z1
+        QVector<double> state2;                                                           // Biquad z2
+        QVector<int> count;                                                               // Samples seen, capped at the window, 0 before the first one
+        QVector<int> head;                                                                // Oldest sample in ring
+        QVector<double> ring;                                                             // window samples per channel
+        QVector<double> sorted;                                                           // Median only, ring in order
+    };
+
+    FilterSettings m_settings;
+    QVector<StageState> m_state;
+    int m_channels = 0;
+
+    void resize (int channels);
+    void runStage (int stage, double *values, int count);
+};
+
+#endif // FILTERBANK_HPP
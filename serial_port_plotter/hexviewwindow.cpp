@@ -0,0 +1,279 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#include "hexviewwindow.hpp"
+#include "ui_hexviewwindow.h"
+#include <QScrollBar>
+#include <QTextCursor>
+
+HexViewWindow::HexViewWindow(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::HexViewWindow)
+{
+    ui->setupUi(this);
+
+    /* 限制文本框行数，避免长时间运行后越来越慢 */
+    ui->plainTextHex->setMaximumBlockCount (HEXVIEW_MAX_ROWS);
+
+    m_startFormat.setForeground (QColor ("#b8bb26"));
+    m_startFormat.setFontWeight (QFont::Bold);
+    m_endFormat.setForeground (QColor ("#fb4934"));
+    m_endFormat.setFontWeight (QFont::Bold);
+
+    m_scratch.resize (HEXVIEW_MAX_BYTES_PER_TICK);
+
+    /* 定时刷新，刷新频率与串口速率无关 */
+    m_refreshTimer.setInterval (HEXVIEW_REFRESH_MS);
+    connect (&m_refreshTimer, SIGNAL (timeout()), this, SLOT (refresh()));
+}
+
+HexViewWindow::~HexViewWindow()
+{
+    delete ui;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 设置可以查看的串口，默认显示第一个
+ * @param names 串口名，显示在 comboPort 中
+ * @param rings 每个串口读取后写入的环形缓冲区，串口关闭时为空
+ */
+void HexViewWindow::setSources (const QStringList &names, const QVector<ByteRing*> &rings)
+{
+    m_rings = rings;
+    ui->comboPort->blockSignals (true);
+    ui->comboPort->clear();
+    ui->comboPort->addItems (names);
+    ui->comboPort->blockSignals (false);
+    ui->comboPort->setEnabled (rings.size() > 1);
+    setSource (m_rings.value (0));
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 设置数据来源
+ * @param ring 串口读取后写入的环形缓冲区
+ */
+void HexViewWindow::setSource (ByteRing *ring)
+{
+    m_ring = ring;
+    m_pending.clear();
+    if (m_ring)
+        m_ring->clear();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 选择其它串口，从它的最新数据开始重新显示
+ */
+void HexViewWindow::on_comboPort_currentIndexChanged (int index)
+{
+    if (index < 0)
+        return;
+    setSource (m_rings.value (index));
+    on_pushButton_Clear_clicked();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 设置需要高亮的帧头和帧尾
+ */
+void HexViewWindow::setFrameMarkers (char start, char end)
+{
+    m_startMarker = start;
+    m_endMarker = end;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 窗口显示时才开始采集，隐藏时串口读取路径不做任何拷贝
+ */
+void HexViewWindow::showEvent (QShowEvent *event)
+{
+    QDialog::showEvent (event);
+    if (m_ring)
+        m_ring->clear();
+    m_refreshTimer.start();
+    emit captureEnabled (true);
+}
+
+void HexViewWindow::hideEvent (QHideEvent *event)
+{
+    emit captureEnabled (false);
+    m_refreshTimer.stop();
+    QDialog::hideEvent (event);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 从环形缓冲区取出数据并显示
+ */
+void HexViewWindow::refresh()
+{
+    if (!m_ring)
+        return;
+
+    /* 暂停时直接丢掉数据，恢复后从最新的数据开始显示 */
+    if (ui->pushButton_Pause->isChecked())
+    {
+        m_ring->clear();
+        return;
+    }
+
+    /* 数据太多时只显示最新的部分，保证每次刷新的耗时有上限 */
+    quint32 avail = m_ring->available();
+    if (avail > HEXVIEW_MAX_BYTES_PER_TICK)
+    {
+        quint32 skip = m_ring->discard (avail - HEXVIEW_MAX_BYTES_PER_TICK);
+        m_skipped += skip + quint32(m_pending.size());
+        m_offset += skip + quint32(m_pending.size());
+        m_pending.clear();
+    }
+
+    quint32 n = m_ring->pop (m_scratch.data(), HEXVIEW_MAX_BYTES_PER_TICK);
+    if (n > 0)
+    {
+        m_pending.append (m_scratch.constData(), int(n));
+
+        /* 只显示完整的行，剩下的留到下次 */
+        int full = m_pending.size() - m_pending.size() % HEXVIEW_BYTES_PER_ROW;
+        if (full > 0)
+        {
+            appendRows (m_pending.constData(), full);
+            m_pending.remove (0, full);
+        }
+    }
+    updateStats();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 以 "偏移  十六进制  |ASCII|" 的格式追加若干行
+ * @param data 数据
+ * @param len 长度，必须是 HEXVIEW_BYTES_PER_ROW 的整数倍
+ */
+void HexViewWindow::appendRows (const char *data, int len)
+{
+    static const char hexDigits[] = "0123456789ABCDEF";
+
+    QScrollBar *bar = ui->plainTextHex->verticalScrollBar();
+    bool atBottom = bar->value() == bar->maximum();
+
+    QTextCursor cursor (ui->plainTextHex->document());
+    cursor.movePosition (QTextCursor::End);
+    cursor.beginEditBlock();
+
+    QString run;
+    run.reserve (128);
+
+    /* 连续的普通字节合并成一段插入，只有帧头帧尾单独设置格式 */
+    auto flushRun = [&]()
+    {
+        if (!run.isEmpty())
+        {
+            cursor.insertText (run, m_plainFormat);
+            run.clear();
+        }
+    };
+    auto insertByte = [&](char c, const QString &text)
+    {
+        if (c == m_startMarker || c == m_endMarker)
+        {
+            flushRun();
+            cursor.insertText (text, c == m_startMarker ? m_startFormat : m_endFormat);
+        }
+        else
+        {
+            run.append (text);
+        }
+    };
+
+    for (int row = 0; row < len; row += HEXVIEW_BYTES_PER_ROW)
+    {
+        const char *bytes = data + row;
+
+        if (!ui->plainTextHex->document()->isEmpty())
+            cursor.insertBlock();
+
+        run.append (QString ("%1  ").arg (m_offset, 8, 16, QChar ('0')).toUpper());
+
+        for (int i = 0; i < HEXVIEW_BYTES_PER_ROW; i++)
+        {
+            uchar b = uchar(bytes[i]);
+            QString hex;
+            hex.append (QChar (hexDigits[b >> 4]));
+            hex.append (QChar (hexDigits[b & 0x0F]));
+            insertByte (bytes[i], hex);
+            run.append (i == HEXVIEW_BYTES_PER_ROW / 2 - 1 ? "  " : " ");
+        }
+
+        run.append (" |");
+        for (int i = 0; i < HEXVIEW_BYTES_PER_ROW; i++)
+        {
+            uchar b = uchar(bytes[i]);
+            insertByte (bytes[i], QString (QChar ((b >= 0x20 && b < 0x7F) ? b : '.')));
+        }
+        run.append ('|');
+        flushRun();
+
+        m_offset += HEXVIEW_BYTES_PER_ROW;
+    }
+
+    cursor.endEditBlock();
+
+    /* 用户向上翻看时不要自动滚动 */
+    if (atBottom)
+        bar->setValue (bar->maximum());
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 刷新统计信息
+ */
+void HexViewWindow::updateStats()
+{
+    QString stats ("%1 字节");
+    stats = stats.arg (m_offset + quint64(m_pending.size()));
+    quint64 lost = m_skipped + (m_ring ? m_ring->droppedBytes() : 0);
+    if (lost > 0)
+        stats += QString (" (跳过 %1 字节)").arg (lost);
+    ui->labelStats->setText (stats);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 清空显示
+ */
+void HexViewWindow::on_pushButton_Clear_clicked()
+{
+    ui->plainTextHex->clear();
+    m_pending.clear();
+    m_offset = 0;
+    m_skipped = 0;
+    if (m_ring)
+        m_ring->clear();
+    updateStats();
+}
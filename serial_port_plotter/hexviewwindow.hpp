@@ -0,0 +1,91 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#ifndef HEXVIEWWINDOW_HPP
+#define HEXVIEWWINDOW_HPP
+
+#include <QDialog>
+#include <QTimer>
+#include <QTextCharFormat>
+#include <QStringList>
+#include <QVector>
+#include "bytering.hpp"
+
+#define HEXVIEW_BYTES_PER_ROW       16
+#define HEXVIEW_REFRESH_MS          100                                                   // 最多每秒刷新 10 次
+#define HEXVIEW_MAX_BYTES_PER_TICK  4096                                                  // 每次刷新最多显示的字节数
+#define HEXVIEW_MAX_ROWS            4000                                                  // 文本框中保留的最大行数
+
+namespace Ui {
+    class HexViewWindow;
+}
+
+class HexViewWindow : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit HexViewWindow(QWidget *parent = nullptr);
+    ~HexViewWindow();
+
+    void setSources (const QStringList &names, const QVector<ByteRing*> &rings);          // One entry of comboPort per open port, empty when closed
+    void setFrameMarkers (char start, char end);                                          // Bytes to highlight (START_MSG / END_MSG)
+
+signals:
+    void captureEnabled (bool enable);                                                    // Emitted when the window is shown / hidden
+
+protected:
+    void showEvent (QShowEvent *event);
+    void hideEvent (QHideEvent *event);
+
+private slots:
+    void refresh();                                                                       // Drain the ring and render new rows
+    void on_pushButton_Clear_clicked();
+    void on_comboPort_currentIndexChanged (int index);
+
+private:
+    Ui::HexViewWindow *ui;
+
+    QVector<ByteRing*> m_rings;                                                           // Ring of every open port, same index as comboPort
+    ByteRing *m_ring = nullptr;                                                           // Ring of the selected port
+    QTimer m_refreshTimer;
+    QByteArray m_pending;                                                                 // Bytes of an incomplete row
+    QByteArray m_scratch;
+    quint64 m_offset = 0;                                                                 // Offset of the next displayed row
+    quint64 m_skipped = 0;                                                                // Bytes skipped to keep up with the refresh cap
+
+    char m_startMarker = '\0';
+    char m_endMarker = '\0';
+    QTextCharFormat m_plainFormat;
+    QTextCharFormat m_startFormat;
+    QTextCharFormat m_endFormat;
+
+    void setSource (ByteRing *ring);
+    void appendRows (const char *data, int len);
+    void updateStats();
+};
+
+#endif // HEXVIEWWINDOW_HPP
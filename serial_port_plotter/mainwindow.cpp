@@ -69,11 +69,38 @@ MainWindow::MainWindow (QWidget *parent) :
     plotting (false),//默认没有绘图
     dataPointNumber (0),//默认接到0次数据
     channels(0),//默认0个通道
-    serialPort (nullptr),//默认没有打开串口
-    STATE (WAIT_START)//默认没有解析到帧头
+    data_format (DATA_FORMAT_ROLLING),//默认滚动显示
+    timeBetweenSamples (0),
+    lastFrameKey (0),
+    xAxisMode (X_AXIS_SAMPLES),//默认X轴为采样序号
+    timingLabel (nullptr)
 {
     ui->setupUi (this);
 
+    /* 工作线程发送的数据类型 */
+    qRegisterMetaType<SerialBatch> ("SerialBatch");
+    qRegisterMetaType<TriggerSettings> ("TriggerSettings");
+    qRegisterMetaType<SpectrumSettings> ("SpectrumSettings");
+    qRegisterMetaType<SpectrumBatch> ("SpectrumBatch");
+    qRegisterMetaType<ExportJob> ("ExportJob");
+    qRegisterMetaType<DerivedChannels> ("DerivedChannels");
+    qRegisterMetaType<FilterSettings> ("FilterSettings");
+
+    /* 频谱在单独的线程中计算 */
+    spectrumThread = new QThread (this);
+    spectrumWorker = new SpectrumWorker;
+    spectrumWorker->moveToThread (spectrumThread);
+    connect (spectrumWorker, SIGNAL(spectrumReady(SpectrumBatch)), this, SLOT(onSpectrumReady(SpectrumBatch)));
+    spectrumThread->start();
+
+    /* 导出图片在单独的线程中绘制和编码 */
+    exportThread = new QThread (this);
+    exportWorker = new ExportWorker;
+    exportWorker->moveToThread (exportThread);
+    connect (exportWorker, SIGNAL(exportProgress(QString, int)), this, SLOT(onExportProgress(QString, int)));
+    connect (exportWorker, SIGNAL(exportFinished(QString, bool)), this, SLOT(onExportFinished(QString, bool)));
+    exportThread->start();
+
     /* 初始化UI */
     createUI();
 
@@ -94,6 +121,31 @@ MainWindow::MainWindow (QWidget *parent) :
     /* 定时刷新绘图区 */
     connect (&updateTimer, SIGNAL (timeout()), this, SLOT (replot()));
 
+    /* 触发条件改变时发送给串口线程 */
+    connect (ui->spinTriggerChannel, SIGNAL(valueChanged(int)), this, SLOT(applyTrigger()));
+    connect (ui->spinTriggerLevel, SIGNAL(valueChanged(double)), this, SLOT(applyTrigger()));
+    connect (ui->spinTriggerHyst, SIGNAL(valueChanged(double)), this, SLOT(applyTrigger()));
+    connect (ui->spinTriggerPre, SIGNAL(valueChanged(int)), this, SLOT(applyTrigger()));
+    connect (ui->spinTriggerHoldoff, SIGNAL(valueChanged(int)), this, SLOT(applyTrigger()));
+
+    /* FFT参数改变时发送给频谱线程 */
+    connect (ui->comboFftSize, SIGNAL(currentIndexChanged(int)), this, SLOT(applySpectrum()));
+    connect (ui->spinFftOverlap, SIGNAL(valueChanged(int)), this, SLOT(applySpectrum()));
+    connect (ui->spinFftAverage, SIGNAL(valueChanged(int)), this, SLOT(applySpectrum()));
+
+    /* 自动截图 */
+    connect (&captureTimer, SIGNAL (timeout()), this, SLOT (onCaptureTimer()));
+    connect (ui->spinCaptureInterval, SIGNAL(valueChanged(int)), this, SLOT(applyCapture()));
+    connect (ui->spinCaptureChannel, SIGNAL(valueChanged(int)), this, SLOT(applyCapture()));
+    connect (ui->spinCaptureLevel, SIGNAL(valueChanged(double)), this, SLOT(applyCapture()));
+
+    /*串口打开成功槽函数*/
+    connect (this, SIGNAL(portOpenOK()), this, SLOT(portOpenedSuccess()));
+    /*串口打开失败槽函数*/
+    connect (this, SIGNAL(portOpenFail()), this, SLOT(portOpenedFail()));
+    /*串口关闭槽函数*/
+    connect (this, SIGNAL(portClosed()), this, SLOT(onPortClosed()));
+
     m_csvFile = nullptr;
 }
 
@@ -104,12 +156,17 @@ MainWindow::MainWindow (QWidget *parent) :
  */
 MainWindow::~MainWindow()
 {
+    closePorts();//停止所有串口线程
     closeCsvFile();
 
-    if (serialPort != nullptr)//删除串口
-    {
-        delete serialPort;
-    }
+    spectrumThread->quit();
+    spectrumThread->wait();
+    delete spectrumWorker;
+
+    exportThread->quit();
+    exportThread->wait();
+    delete exportWorker;
+
     delete ui;
 }
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -119,19 +176,89 @@ MainWindow::~MainWindow()
  */
 void MainWindow::createUI()
 {
+    /* 状态栏右侧显示帧间隔和抖动 */
+    timingLabel = new QLabel (this);
+    ui->statusBar->addPermanentWidget (timingLabel);
+
+    /* 状态栏右侧显示导出进度，只在导出时可见 */
+    exportProgressBar = new QProgressBar (this);
+    exportProgressBar->setRange (0, 100);
+    exportProgressBar->setMaximumWidth (220);
+    exportProgressBar->setVisible (false);
+    ui->statusBar->addPermanentWidget (exportProgressBar);
+
+    /* X轴数据来源 */
+    ui->comboXAxis->addItem ("采样序号");
+    ui->comboXAxis->addItem ("接收时间");
+    ui->comboXAxis->addItem ("设备时间(ms)");
+    ui->comboXAxis->addItem ("设备时间(us)");
+    ui->comboXAxis->setCurrentIndex (X_AXIS_SAMPLES);
+
+    /* 通道分组显示方式 */
+    ui->comboLayout->addItem ("叠加");
+    ui->comboLayout->addItem ("按串口");
+    ui->comboLayout->addItem ("按通道");
+    ui->comboLayout->setCurrentIndex (LAYOUT_OVERLAY);
+
+    /* 显示方式 */
+    ui->comboFormat->addItem ("滚动");
+    ui->comboFormat->addItem ("X-Y");
+    ui->comboFormat->setCurrentIndex (DATA_FORMAT_ROLLING);
+
+    /* Y轴自动缩放方式 */
+    ui->comboAutoY->addItem ("关闭");
+    ui->comboAutoY->addItem ("全部数据");
+    ui->comboAutoY->addItem ("可见范围");
+    ui->comboAutoY->setCurrentIndex (AUTO_Y_OFF);
+
+    /* 余辉显示 */
+    ui->comboPersist->addItem ("关闭");
+    ui->comboPersist->addItem ("短余辉");
+    ui->comboPersist->addItem ("长余辉");
+    ui->comboPersist->addItem ("无限余辉");
+    ui->comboPersist->setCurrentIndex (PERSIST_OFF);
+
+    /* 自动截图 */
+    ui->comboCapture->addItem ("关闭");
+    ui->comboCapture->addItem ("定时");
+    ui->comboCapture->addItem ("越过阈值");
+    ui->comboCapture->setCurrentIndex (CAPTURE_OFF);
+
+    /* 滤波后的通道替换原始数据，或者追加在原始数据后面 */
+    ui->comboFilterView->addItem ("只显示滤波");
+    ui->comboFilterView->addItem ("原始和滤波");
+    ui->comboFilterView->setCurrentIndex (FILTER_VIEW_FILTERED);
+
+    /* 触发方式 */
+    ui->comboTrigger->addItem ("关闭");
+    ui->comboTrigger->addItem ("上升沿");
+    ui->comboTrigger->addItem ("下降沿");
+    ui->comboTrigger->addItem ("双沿");
+    ui->comboTrigger->setCurrentIndex (TRIGGER_OFF);
+
+    /* 频谱的窗函数和FFT点数 */
+    ui->comboSpectrum->addItem ("关闭");
+    ui->comboSpectrum->addItem ("Hann");
+    ui->comboSpectrum->addItem ("Blackman");
+    ui->comboSpectrum->setCurrentIndex (SPECTRUM_OFF);
+    for (int size = 256; size <= 8192; size *= 2)
+    {
+        ui->comboFftSize->addItem (QString::number (size));
+    }
+    ui->comboFftSize->setCurrentText ("1024");
+
     if (QSerialPortInfo::availablePorts().size() == 0)//电脑上没有插入任何串口
     {
         enable_com_controls (false);
         ui->statusBar->showMessage ("没有串口.");
         ui->savePNGButton->setEnabled (false);
+        ui->savePDFButton->setEnabled (false);
+        ui->saveSVGButton->setEnabled (false);
         return;
     }
 
 
-    for (QSerialPortInfo port : QSerialPortInfo::availablePorts())//填充串口号
-    {
-        ui->comboPort->addItem (port.portName());
-    }
+    fillPortLists();//填充串口号
 
     /* 增加波特率 */
     ui->comboBaud->addItem ("1200");
@@ -164,34 +291,32 @@ void MainWindow::setupPlot()
 
     /* 设置为高性能模式 */
     ui->plot->setNotAntialiasedElements (QCP::aeAll);
+    ui->plot->setPlottingHint (QCP::phParallelPlottables, true);//曲线分成多个水平条带，多线程绘制
+    ui->plot->setPlottingHint (QCP::phDirtyLayers, true);//只重绘变化了的层，刻度不变时网格、坐标轴和图例直接使用上次的缓冲
+    ui->plot->setPlottingHint (QCP::phCacheLabels, true);//数字刻度标签由预先渲染的字形拼接，滚动时不再为每个新标签生成位图
     QFont font;
     font.setStyleStrategy (QFont::NoAntialias);
     ui->plot->legend->setFont (font);//设置绘图区字体
 
 
     /* 设置X轴风格 */
-    ui->plot->xAxis->grid()->setPen (QPen(gui_colors[2], 1, Qt::DotLine));
-    ui->plot->xAxis->grid()->setSubGridPen (QPen(gui_colors[1], 1, Qt::DotLine));
-    ui->plot->xAxis->grid()->setSubGridVisible (true);
-    ui->plot->xAxis->setBasePen (QPen (gui_colors[2]));
-    ui->plot->xAxis->setTickPen (QPen (gui_colors[2]));
-    ui->plot->xAxis->setSubTickPen (QPen (gui_colors[2]));
-    ui->plot->xAxis->setUpperEnding (QCPLineEnding::esSpikeArrow);
-    ui->plot->xAxis->setTickLabelColor (gui_colors[2]);
-    ui->plot->xAxis->setTickLabelFont (font);
+    styleAxis (ui->plot->xAxis);
+    /* 时间模式下X轴显示为 时:分:秒.毫秒，X-Y模式下X轴是通道的数值 */
+    if (xAxisMode == X_AXIS_SAMPLES || data_format == DATA_FORMAT_XY)
+    {
+        ui->plot->xAxis->setTicker (QSharedPointer<QCPAxisTicker> (new QCPAxisTicker));
+    }
+    else
+    {
+        QSharedPointer<QCPAxisTickerTime> timeTicker (new QCPAxisTickerTime);
+        timeTicker->setTimeFormat ("%h:%m:%s.%z");
+        ui->plot->xAxis->setTicker (timeTicker);
+    }
     /* 显示范围 */
-    ui->plot->xAxis->setRange (dataPointNumber - ui->spinPoints->value(), dataPointNumber);
+    updateXRange();
 
     /* 设置Y轴风格 */
-    ui->plot->yAxis->grid()->setPen (QPen(gui_colors[2], 1, Qt::DotLine));
-    ui->plot->yAxis->grid()->setSubGridPen (QPen(gui_colors[1], 1, Qt::DotLine));
-    ui->plot->yAxis->grid()->setSubGridVisible (true);
-    ui->plot->yAxis->setBasePen (QPen (gui_colors[2]));
-    ui->plot->yAxis->setTickPen (QPen (gui_colors[2]));
-    ui->plot->yAxis->setSubTickPen (QPen (gui_colors[2]));
-    ui->plot->yAxis->setUpperEnding (QCPLineEnding::esSpikeArrow);
-    ui->plot->yAxis->setTickLabelColor (gui_colors[2]);
-    ui->plot->yAxis->setTickLabelFont (font);
+    styleAxis (ui->plot->yAxis);
     /* Range */
     //ui->plot->yAxis->setRange (ui->spinAxesMin->value(), ui->spinAxesMax->value());
     /* User can change Y axis tick step with a spin box */
@@ -215,6 +340,196 @@ void MainWindow::setupPlot()
     ui->plot->legend->setBorderPen (gui_colors[2]);
     /* By default, the legend is in the inset layout of the main axis rect. So this is how we access it to change legend placement */
     ui->plot->axisRect()->insetLayout()->setInsetAlignment (0, Qt::AlignTop|Qt::AlignRight);
+
+    /* 分组显示 */
+    applyPlotLayout();
+
+    /* 余辉显示在曲线层的上面，被余辉代替的曲线放到不显示的 "persisted" 层 */
+    if (ui->plot->layer ("persistence") == nullptr)
+    {
+        ui->plot->addLayer ("persistence", ui->plot->layer ("main"), QCustomPlot::limAbove);
+    }
+    if (ui->plot->layer ("persisted") == nullptr)
+    {
+        ui->plot->addLayer ("persisted", ui->plot->layer ("main"), QCustomPlot::limBelow);
+        ui->plot->layer ("persisted")->setVisible (false);
+    }
+    /* 频谱显示在余辉的上面 */
+    if (ui->plot->layer ("spectrum") == nullptr)
+    {
+        ui->plot->addLayer ("spectrum", ui->plot->layer ("persistence"), QCustomPlot::limAbove);
+    }
+    /* 曲线层和坐标轴层单独缓冲，把背景+网格、坐标轴、图例分到不同的缓冲里 */
+    ui->plot->layer ("main")->setMode (QCPLayer::lmBuffered);
+    ui->plot->layer ("axes")->setMode (QCPLayer::lmBuffered);
+    applyPersistence();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 设置坐标轴风格
+ * @param axis 坐标轴
+ */
+void MainWindow::styleAxis (QCPAxis *axis)
+{
+    QFont font;
+    font.setStyleStrategy (QFont::NoAntialias);
+
+    axis->grid()->setPen (QPen(gui_colors[2], 1, Qt::DotLine));
+    axis->grid()->setSubGridPen (QPen(gui_colors[1], 1, Qt::DotLine));
+    axis->grid()->setSubGridVisible (true);
+    axis->setBasePen (QPen (gui_colors[2]));
+    axis->setTickPen (QPen (gui_colors[2]));
+    axis->setSubTickPen (QPen (gui_colors[2]));
+    axis->setUpperEnding (QCPLineEnding::esSpikeArrow);
+    axis->setTickLabelColor (gui_colors[2]);
+    axis->setTickLabelFont (font);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 按当前的分组方式把通道分组，每组是若干曲线的下标
+ */
+QVector<QVector<int> > MainWindow::channelGroups()
+{
+    QVector<QVector<int> > groups;
+
+    switch (plotLayoutMode)
+    {
+    case LAYOUT_PER_CHANNEL:
+        for (int i = 0; i < ui->plot->graphCount(); i++)
+        {
+            groups.append (QVector<int>() << i);
+        }
+        break;
+    case LAYOUT_PER_PORT:
+        for (const PortChannels &port : portChannels)
+        {
+            if (!port.graphs.isEmpty())
+                groups.append (port.graphs);
+        }
+        std::sort (groups.begin(), groups.end(),
+                   [](const QVector<int> &a, const QVector<int> &b) { return a.first() < b.first(); });
+        break;
+    default:
+        break;
+    }
+    return groups;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 按分组把曲线放到上下堆叠的坐标区域中
+ *
+ * 所有区域共用一个X轴刻度生成器并同步X轴范围，只有最下面的区域生成X轴刻度文字；
+ * 上面的区域只自动计算左右边距，所以多个区域的布局开销和一个区域差不多。
+ */
+void MainWindow::applyPlotLayout()
+{
+    QCPLayoutGrid *grid = ui->plot->plotLayout();
+    QCPAxisRect *mainRect = ui->plot->axisRect (0);
+    QVector<QVector<int> > groups = channelGroups();
+
+    /* 频谱区域先拿出来，分组后再放到最下面 */
+    if (spectrumRect != nullptr)
+    {
+        grid->take (spectrumRect);
+    }
+    if (waterfallRect != nullptr)
+    {
+        grid->take (waterfallRect);
+    }
+
+    /* 先把所有曲线放回主区域，再删除旧的区域 */
+    for (int i = 0; i < ui->plot->graphCount(); i++)
+    {
+        ui->plot->graph(i)->setKeyAxis (ui->plot->xAxis);
+        ui->plot->graph(i)->setValueAxis (ui->plot->yAxis);
+    }
+    for (QCPAxisRect *rect : stackedRects)
+    {
+        grid->remove (rect);
+    }
+    stackedRects.clear();
+    grid->simplify();
+
+    if (groups.size() <= 1)
+    {
+        mainRect->setMarginGroup (QCP::msLeft | QCP::msRight, nullptr);
+        mainRect->setAutoMargins (QCP::msAll);
+        ui->plot->xAxis->setTickLabels (true);
+        placeSpectrumRect();
+        applyPersistedGraphs();
+        return;
+    }
+
+    if (marginGroup == nullptr)
+    {
+        marginGroup = new QCPMarginGroup (ui->plot);
+    }
+    grid->setRowSpacing (0);
+
+    for (int g = 0; g < groups.size(); g++)
+    {
+        QCPAxisRect *rect = mainRect;
+        if (g > 0)
+        {
+            rect = new QCPAxisRect (ui->plot);
+            grid->addElement (g, 0, rect);
+            stackedRects.append (rect);
+
+            QCPAxis *keyAxis = rect->axis (QCPAxis::atBottom);
+            styleAxis (keyAxis);
+            styleAxis (rect->axis (QCPAxis::atLeft));
+            keyAxis->setTicker (ui->plot->xAxis->ticker());
+            keyAxis->setRange (ui->plot->xAxis->range());
+            rect->setRangeDrag (Qt::Horizontal);
+            rect->setRangeZoom (Qt::Horizontal);
+
+            /* 同步X轴范围 */
+            connect (ui->plot->xAxis, SIGNAL(rangeChanged(QCPRange)), keyAxis, SLOT(setRange(QCPRange)));
+            connect (keyAxis, SIGNAL(rangeChanged(QCPRange)), ui->plot->xAxis, SLOT(setRange(QCPRange)));
+        }
+
+        /* 左右边距对齐，上下边距固定，只有最下面的区域显示X轴刻度文字 */
+        bool last = g == groups.size() - 1;
+        QCP::MarginSides sides = QCP::msLeft | QCP::msRight;
+        if (g == 0)
+            sides |= QCP::msTop;
+        if (last)
+            sides |= QCP::msBottom;
+        rect->setMarginGroup (QCP::msLeft | QCP::msRight, marginGroup);
+        rect->setAutoMargins (sides);
+        rect->setMargins (QMargins (0, 4, 0, 4));
+        rect->axis (QCPAxis::atBottom)->setTickLabels (last);
+
+        for (int index : groups[g])
+        {
+            ui->plot->graph(index)->setKeyAxis (rect->axis (QCPAxis::atBottom));
+            ui->plot->graph(index)->setValueAxis (rect->axis (QCPAxis::atLeft));
+        }
+    }
+    placeSpectrumRect();
+    applyPersistedGraphs();//只有主区域的曲线由余辉代替
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 把频谱区域放到布局的最下面一行，瀑布图在它下面
+ */
+void MainWindow::placeSpectrumRect()
+{
+    if (spectrumRect == nullptr)
+        return;
+
+    QCPLayoutGrid *grid = ui->plot->plotLayout();
+    grid->take (spectrumRect);
+    if (waterfallRect != nullptr)
+        grid->take (waterfallRect);
+    grid->simplify();
+    grid->addElement (grid->rowCount(), 0, spectrumRect);
+    if (waterfallRect != nullptr)
+        grid->addElement (grid->rowCount(), 0, waterfallRect);
 }
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
@@ -227,7 +542,9 @@ void MainWindow::enable_com_controls (bool enable)
     /* 端口和波特率控件 */
     ui->comboBaud->setEnabled (enable);
     ui->comboPort->setEnabled (enable);
+    ui->listWidget_Ports->setEnabled (enable);
     ui->pushButton->setEnabled (enable);
+    ui->comboXAxis->setEnabled (enable);
 
     ui->actionConnect->setEnabled (enable);//开始按钮
     ui->actionPause_Plot->setEnabled (!enable);//暂停按钮
@@ -236,44 +553,80 @@ void MainWindow::enable_com_controls (bool enable)
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 /**
- * @brief 打开串口
+ * @brief 在独立线程中打开串口
  * @param portInfo 串口信息
  * @param baudRate 波特率
  * @param dataBits 数据位
  * @param parity 校验位
  * @param stopBits 停止位
+ * @return true 打开成功
  */
-void MainWindow::openPort (QSerialPortInfo portInfo, int baudRate, QSerialPort::DataBits dataBits, QSerialPort::Parity parity, QSerialPort::StopBits stopBits)
+bool MainWindow::openPort (QSerialPortInfo portInfo, int baudRate, QSerialPort::DataBits dataBits, QSerialPort::Parity parity, QSerialPort::StopBits stopBits)
 {
-    serialPort = new QSerialPort(portInfo, nullptr);//创建串口
+    OpenPort port;
+    port.name = portInfo.portName();
+    port.thread = new QThread (this);
+    port.worker = new SerialWorker (openPorts.size(), portSession, portInfo, baudRate, dataBits, parity, stopBits, timeOfFirstData);
+    port.worker->moveToThread (port.thread);
+    port.thread->start();
+
+    /* 串口必须在工作线程中创建和打开 */
+    bool ok = false;
+    QMetaObject::invokeMethod (port.worker, "open", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, ok));
+    if (!ok)
+    {
+        qDebug() << port.name << port.worker->errorString();
+        port.thread->quit();
+        port.thread->wait();
+        delete port.worker;
+        delete port.thread;
+        return false;
+    }
+
+    port.worker->setRawText (!filterDisplayedData);
+    port.worker->setRecordStream (ui->actionRecord_stream->isChecked());//连接期间保存按钮被锁定，不会改变
+    port.worker->setHexCapture (hexCaptureEnabled);
+    QMetaObject::invokeMethod (port.worker, "setTrigger", Qt::QueuedConnection, Q_ARG(TriggerSettings, triggerSettings));
+    QMetaObject::invokeMethod (port.worker, "setDerivedChannels", Qt::QueuedConnection, Q_ARG(DerivedChannels, derivedChannels));
+    QMetaObject::invokeMethod (port.worker, "setFilters", Qt::QueuedConnection, Q_ARG(FilterSettings, filterSettings));
 
-    /*串口打开成功槽函数*/
-    connect (this, SIGNAL(portOpenOK()), this, SLOT(portOpenedSuccess()));
-    /*串口打开失败槽函数*/
-    connect (this, SIGNAL(portOpenFail()), this, SLOT(portOpenedFail()));
-    /*串口关闭槽函数*/
-    connect (this, SIGNAL(portClosed()), this, SLOT(onPortClosed()));
     /*向绘图区增加新的数据槽函数*/
-    connect (this, SIGNAL(newData(QStringList)), this, SLOT(onNewDataArrived(QStringList)));
-    /*串口数据读取槽函数*/
-    connect (serialPort, SIGNAL(readyRead()), this, SLOT(readData()));
-    
+    connect (port.worker, SIGNAL(framesReady(SerialBatch)), this, SLOT(onNewDataArrived(SerialBatch)));
     /*保存绘图数据到csv文件*/
-    connect (this, SIGNAL(newData(QStringList)), this, SLOT(saveStream(QStringList)));
+    connect (port.worker, SIGNAL(framesReady(SerialBatch)), this, SLOT(saveStream(SerialBatch)));
+    /*频谱线程直接接收串口线程的数据*/
+    connect (port.worker, SIGNAL(framesReady(SerialBatch)), spectrumWorker, SLOT(addBatch(SerialBatch)));
 
-    if (serialPort->open (QIODevice::ReadWrite))
+    openPorts.append (port);
+    return true;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 关闭所有串口并结束它们的线程
+ */
+void MainWindow::closePorts()
+{
+    if (hexViewWindow != nullptr)
     {
-        serialPort->setBaudRate (baudRate);
-        serialPort->setParity (parity);
-        serialPort->setDataBits (dataBits);
-        serialPort->setStopBits (stopBits);
-        emit portOpenOK();
+        hexViewWindow->setSources (QStringList(), QVector<ByteRing*>());
     }
-    else
+
+    for (OpenPort &port : openPorts)
     {
-        emit portOpenedFail();
-        qDebug() << serialPort->errorString();
+        QMetaObject::invokeMethod (port.worker, "close", Qt::BlockingQueuedConnection);
+        port.thread->quit();
+        port.thread->wait();
+        delete port.worker;
+        delete port.thread;
     }
+    openPorts.clear();
+
+    /* 已经在队列中的数据属于关闭的串口，下次连接时串口的编号可能指向另一个串口 */
+    portSession++;
+
+    /* 下次连接时串口的编号可能不同 */
+    QMetaObject::invokeMethod (spectrumWorker, "clear", Qt::QueuedConnection);
 }
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
@@ -287,14 +640,6 @@ void MainWindow::onPortClosed()
     plotting = false;
     
     closeCsvFile();//关闭CSV文件
-    
-    disconnect (serialPort, SIGNAL(readyRead()), this, SLOT(readData()));
-    disconnect (this, SIGNAL(portOpenOK()), this, SLOT(portOpenedSuccess()));
-    disconnect (this, SIGNAL(portOpenFail()), this, SLOT(portOpenedFail()));
-    disconnect (this, SIGNAL(portClosed()), this, SLOT(onPortClosed()));
-    disconnect (this, SIGNAL(newData(QStringList)), this, SLOT(onNewDataArrived(QStringList)));
-
-    disconnect (this, SIGNAL(newData(QStringList)), this, SLOT(saveStream(QStringList)));
 }
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
@@ -324,6 +669,10 @@ void MainWindow::portOpenedSuccess()
     }
     ui->actionRecord_stream->setEnabled(false);//锁定保存数据的按钮，不能让用户操作了
 
+    /* 十六进制窗口可以选择任意一个打开的串口 */
+    updateHexSources();
+
+    portStatsTimer.start();
     updateTimer.start (20); //20ms重新绘制
     connected = true; //正在连接flg
     plotting = true;//正在绘图flg
@@ -345,81 +694,650 @@ void MainWindow::portOpenedFail()
 void MainWindow::replot()
 {
     /*刷新X轴坐标范围*/
-    ui->plot->xAxis->setRange (dataPointNumber - ui->spinPoints->value(), dataPointNumber);
+    updateXRange();
+
+    /*Y轴自动缩放，分组显示时每个区域的Y轴独立缩放*/
+    applyAutoY();
+    /*余辉只绘制新的采样*/
+    updatePersistence();
     ui->plot->replot();
+
+    /*自动截图保存刚刚显示的画面*/
+    if (capturePending)
+    {
+        takeCapture();
+    }
+
+    /*刷新吞吐量、帧间隔和抖动*/
+    if (portStatsTimer.isValid() && portStatsTimer.elapsed() >= PORT_STATS_MS)
+    {
+        updatePortStats();
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 一条曲线的数值范围，使用增量维护的最小/最大值，不扫描全部数据
+ * @param index 曲线下标
+ * @param mode AUTO_Y_ALL 全部数据，AUTO_Y_WINDOW 可见范围
+ * @param keyRange X轴可见范围
+ * @param range 输出，数值范围
+ * @return 是否有数据
+ */
+bool MainWindow::graphValueRange (int index, int mode, const QCPRange &keyRange, QCPRange *range)
+{
+    RangeTracker &tracker = valueTrackers[index];
+
+    if (mode == AUTO_Y_ALL)
+        return tracker.totalRange (range);
+
+    /* 可见范围跟随最新数据时使用单调队列 */
+    if (keyRange.upper >= tracker.lastKey())
+    {
+        if (tracker.canSlideTo (keyRange.lower))
+            tracker.slideTo (keyRange.lower);
+        else
+            tracker.rebuild (*ui->plot->graph(index)->data(), keyRange.lower);
+        return tracker.windowRange (range);
+    }
+
+    /* 暂停后拖动到历史数据时，只查找可见范围内的数据 */
+    bool found = false;
+    *range = ui->plot->graph(index)->getValueRange (found, QCP::sdBoth, keyRange);
+    return found;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 每帧自动设置Y轴范围
+ */
+void MainWindow::applyAutoY()
+{
+    QCPRange keyRange = ui->plot->xAxis->range();
+
+    /* 窗口跟随最新数据时丢掉窗口外的点，队列长度不超过可见点数 */
+    for (RangeTracker &tracker : valueTrackers)
+    {
+        if (keyRange.upper >= tracker.lastKey() && tracker.canSlideTo (keyRange.lower))
+            tracker.slideTo (keyRange.lower);
+    }
+
+    /* X-Y模式下曲线的点数不超过 spinPoints，直接取曲线的范围 */
+    if (data_format == DATA_FORMAT_XY)
+    {
+        QCPRange range;
+        if (autoYMode != AUTO_Y_OFF && curvesRange (false, &range))
+            ui->plot->yAxis->setRange (range);
+        return;
+    }
+
+    int mode = autoYMode;
+    if (mode == AUTO_Y_OFF)
+    {
+        if (stackedRects.isEmpty())
+            return;
+        mode = AUTO_Y_ALL;//分组显示时Y轴总是自动缩放
+    }
+
+    for (QCPAxisRect *rect : ui->plot->axisRects())
+    {
+        QCPAxis *valueAxis = rect->axis (QCPAxis::atLeft);
+        QCPRange range;
+        bool found = false;
+
+        for (int i = 0; i < ui->plot->graphCount() && i < valueTrackers.size(); i++)
+        {
+            QCPGraph *graph = ui->plot->graph(i);
+            QCPRange graphRange;
+            if (graph->valueAxis() != valueAxis || !graph->visible())
+                continue;
+            if (!graphValueRange (i, mode, keyRange, &graphRange))
+                continue;
+            if (found)
+                range.expand (graphRange);
+            else
+                range = graphRange;
+            found = true;
+        }
+
+        if (found)
+        {
+            double margin = (range.size() > 0 ? range.size() : qMax (qAbs (range.lower), 1.0)) * AUTO_Y_MARGIN;
+            valueAxis->setRange (range.lower - margin, range.upper + margin);
+        }
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 所有可见的X-Y曲线的范围，上下各留 AUTO_Y_MARGIN 的空白
+ * @param keys true X轴（通道对的第一个通道），false Y轴
+ * @param range 输出，坐标范围
+ * @return 是否有数据
+ */
+bool MainWindow::curvesRange (bool keys, QCPRange *range)
+{
+    bool found = false;
+
+    for (const PortChannels &port : portChannels)
+    {
+        for (QCPCurve *curve : port.curves)
+        {
+            bool curveFound = false;
+            QCPRange curveRange = keys ? curve->getKeyRange (curveFound) : curve->getValueRange (curveFound);
+            if (!curveFound || !curve->visible())
+                continue;
+            if (found)
+                range->expand (curveRange);
+            else
+                *range = curveRange;
+            found = true;
+        }
+    }
+
+    if (found)
+    {
+        double margin = (range->size() > 0 ? range->size() : qMax (qAbs (range->lower), 1.0)) * AUTO_Y_MARGIN;
+        *range = QCPRange (range->lower - margin, range->upper + margin);
+    }
+    return found;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 按余辉方式创建或删除色图
+ *
+ * 余辉打开时主区域的曲线改为累计到色图中显示，见 applyPersistedGraphs()。
+ */
+void MainWindow::applyPersistence()
+{
+    if (persistMode == PERSIST_OFF)
+    {
+        if (persistColorMap != nullptr)
+        {
+            persistence.setColorMap (nullptr);
+            ui->plot->removePlottable (persistColorMap);
+            persistColorMap = nullptr;
+        }
+        persistence.clear();
+        applyPersistedGraphs();
+        return;
+    }
+
+    if (persistColorMap == nullptr)
+    {
+        persistColorMap = new QCPColorMap (ui->plot->xAxis, ui->plot->yAxis);
+        persistColorMap->setLayer ("persistence");
+        persistColorMap->removeFromLegend();
+        persistColorMap->setSelectable (QCP::stNone);
+        persistColorMap->setInterpolate (false);
+        persistColorMap->setDataScaleType (QCPAxis::stLogarithmic);//命中次数相差很大，按对数显示
+
+        /* 没有命中的地方透明，可以看到网格 */
+        QCPColorGradient gradient;
+        gradient.clearColorStops();
+        gradient.setColorStopAt (0, QColor (0, 0, 0, 0));
+        gradient.setColorStopAt (0.05, line_colors[10]);
+        gradient.setColorStopAt (0.4, line_colors[5]);
+        gradient.setColorStopAt (0.75, line_colors[2]);
+        gradient.setColorStopAt (1, line_colors[0]);
+        persistColorMap->setGradient (gradient);
+
+        persistence.setColorMap (persistColorMap);
+    }
+
+    switch (persistMode)
+    {
+    case PERSIST_SHORT: persistence.setHalfLife (PERSIST_SHORT_S); break;
+    case PERSIST_LONG:  persistence.setHalfLife (PERSIST_LONG_S); break;
+    default:            persistence.setHalfLife (0); break;
+    }
+    applyPersistedGraphs();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 余辉打开时，主区域的曲线移到不显示的 "persisted" 层，由色图代替
+ *
+ * 只隐藏被色图代替的曲线，其它区域的曲线、X-Y曲线和 "main" 层的其它内容照常显示，
+ * 曲线自己的可见性（通道列表中的选择）不变。
+ */
+void MainWindow::applyPersistedGraphs()
+{
+    QCPLayer *mainLayer = ui->plot->layer ("main");
+    QCPLayer *persisted = ui->plot->layer ("persisted");
+    if (persisted == nullptr)
+        return;
+
+    for (int i = 0; i < ui->plot->graphCount(); i++)
+    {
+        QCPGraph *graph = ui->plot->graph(i);
+        bool replaced = persistColorMap != nullptr && graph->keyAxis() == ui->plot->xAxis;
+        graph->setLayer (replaced ? persisted : mainLayer);
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 每帧把新的采样累计到余辉中，一次扫描是X轴的可见范围
+ */
+void MainWindow::updatePersistence()
+{
+    if (persistColorMap == nullptr)
+        return;
+
+    /* 一个像素一行；列数不超过可见的点数，采样稀疏时也是连续的 */
+    QRect rect = ui->plot->axisRect()->rect();
+    int columns = qMin (rect.width(), ui->spinPoints->value());
+    persistence.update (ui->plot->xAxis->range(), ui->plot->yAxis->range(), columns, rect.height());
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 统计每个串口的吞吐量，和帧间隔、抖动一起显示在状态栏
+ */
+void MainWindow::updatePortStats()
+{
+    double seconds = portStatsTimer.restart() * 1e-3;
+    QStringList stats;
+
+    for (OpenPort &port : openPorts)
+    {
+        quint64 bytes = port.worker->bytesReceived();
+        quint64 frames = port.worker->framesReceived();
+        port.byteRate = (bytes - port.lastBytes) / seconds;
+        port.frameRate = (frames - port.lastFrames) / seconds;
+        port.lastBytes = bytes;
+        port.lastFrames = frames;
+
+        QString text = QString ("%1: %2 kB/s %3 帧/s")
+                       .arg (port.name)
+                       .arg (port.byteRate * 1e-3, 0, 'f', 1)
+                       .arg (port.frameRate, 0, 'f', 0);
+
+        const FrameTiming &timing = portChannels[port.name].timing;
+        if (xAxisMode != X_AXIS_SAMPLES && timing.frames > 1)
+        {
+            text += QString (" Δt %1 ms 抖动 %2 ms 峰值 %3 ms")
+                    .arg (timing.interval * 1e3, 0, 'f', 3)
+                    .arg (timing.jitter * 1e3, 0, 'f', 3)
+                    .arg (timing.jitterPeak * 1e3, 0, 'f', 3);
+        }
+        stats.append (text);
+    }
+    timingLabel->setText (stats.join ("  |  "));
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 让X轴跟随最新的数据
+ *
+ * 采样序号模式下显示最近 spinPoints 个点；时间模式下按平均帧间隔把点数换算成时间宽度；
+ * X-Y模式下X轴是通道的数值，缩放到曲线的范围
+ */
+void MainWindow::updateXRange()
+{
+    if (data_format == DATA_FORMAT_XY)
+    {
+        QCPRange range;
+        if (curvesRange (true, &range))
+            ui->plot->xAxis->setRange (range);
+    }
+    else if (triggerSettings.edge != TRIGGER_OFF)//触发模式下显示一次扫描，触发点在0
+    {
+        double dt = xAxisMode == X_AXIS_SAMPLES ? 1.0 : timeBetweenSamples;
+        if (dt <= 0)
+            dt = 1.0 / qMax (triggerSettings.preFrames + triggerSettings.postFrames, 1);
+        ui->plot->xAxis->setRange (-triggerSettings.preFrames * dt, triggerSettings.postFrames * dt);
+    }
+    else if (xAxisMode == X_AXIS_SAMPLES)
+    {
+        ui->plot->xAxis->setRange (dataPointNumber - ui->spinPoints->value(), dataPointNumber);
+    }
+    else
+    {
+        double span = ui->spinPoints->value() * timeBetweenSamples;
+        if (span <= 0)
+            span = 1.0;
+        ui->plot->xAxis->setRange (lastFrameKey - span, lastFrameKey);
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 计算一帧数据的X轴坐标
+ * @param frame 一帧数据
+ * @param port 这帧数据所属的串口
+ * @param firstChannel 输出，第一个通道在 frame.values 中的下标（设备时间模式下第一个字段是时间戳）
+ * @return X轴坐标
+ */
+double MainWindow::frameKey(const SerialFrame &frame, PortChannels &port, int *firstChannel)
+{
+    double key;
+
+    *firstChannel = 0;
+    switch (xAxisMode)
+    {
+    case X_AXIS_HOST_TIME:
+        key = frame.timestamp;
+        break;
+    case X_AXIS_DEVICE_MS:
+    case X_AXIS_DEVICE_US:
+        key = frame.values.value (0) * (xAxisMode == X_AXIS_DEVICE_MS ? 1e-3 : 1e-6);
+        *firstChannel = 1;
+        /* 每个设备的时钟起点不同，用第一帧把设备时间对齐到本机时间，多个串口才能在X轴上对齐 */
+        if (!port.haveDeviceOffset)
+        {
+            port.deviceOffset = frame.timestamp - key;
+            port.haveDeviceOffset = true;
+        }
+        key += port.deviceOffset;
+        break;
+    default:
+        return port.samples;
+    }
+
+    port.timing.update (key);
+    return key;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 清空时间统计，下一次连接时重新开始计时
+ */
+void MainWindow::resetFrameTiming()
+{
+    if (!connected)//串口线程还在使用这个时间起点
+        timeOfFirstData.invalidate();
+    timeBetweenSamples = 0;
+    lastFrameKey = 0;
+    timingLabel->clear();
 }
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 /**
  * @brief 向绘图区增加新的数据
- * @param newData 串口数据，这是解包后的数据，真正用于绘图的数据
+ * @param batch 串口线程一次读取解析出来的数据，这是解包后的数据，真正用于绘图的数据
  */
-void MainWindow::onNewDataArrived(QStringList newData)
+void MainWindow::onNewDataArrived(SerialBatch batch)
 {
-    static int data_members = 0;
-    static int channel = 0;
-    static int i = 0;
-    volatile bool you_shall_NOT_PASS = false;
+    if (batch.session != portSession || batch.port >= openPorts.size())//串口已经关闭
+        return;
 
-    /* When a fast baud rate is set (921kbps was the first to starts to bug),
-       this method is called multiple times (2x in the 921k tests), so a flag
-       is used to throttle
-       TO-DO: Separate processes, buffer data (1) and process data (2) */
-    while (you_shall_NOT_PASS) {}
-    you_shall_NOT_PASS = true;
+    const QString portName = openPorts[batch.port].name;
 
-    if (plotting)//正在绘图
+    /* 显示到文本框，多个串口时加上串口名 */
+    QString prefix = openPorts.size() > 1 ? QString ("[%1] ").arg (portName) : QString();
+    for (const QString &line : batch.text)
     {
-        data_members = newData.size();//获取数据的长度
+        ui->textEdit_UartWindow->append (prefix + line);
+    }
 
-        for (i = 0; i < data_members; i++)//遍历数据，解析数据
+    if (!plotting)//没有在绘图
+        return;
+
+    PortChannels &port = portChannels[portName];
+    int graphCount = ui->plot->graphCount();
+
+    /* 触发模式下是一次完整的扫描 */
+    if (batch.triggered)
+    {
+        if (!batch.frames.isEmpty())
+            plotSweep (batch, port, portName);
+    }
+    else//滚动显示
+    {
+        for (const SerialFrame &frame : batch.frames)
         {
-            /* 第一次进入，添加所有通道 */
-            while (ui->plot->plottableCount() <= channel)//新的数据，通道是否比之前的多
+            int first_member = 0;
+            double key = frameKey (frame, port, &first_member);//这一帧的X轴坐标
+
+            /* X-Y模式下两个通道组成一个点，整帧解析完后再添加，不需要每个通道的曲线 */
+            for (int i = first_member; data_format != DATA_FORMAT_XY && i < frame.values.size(); i++)//遍历数据，解析数据
             {
-                /* 添加新的通道数据 */
-                ui->plot->addGraph();
-                ui->plot->graph()->setPen (line_colors[channels % CUSTOM_LINE_COLORS]);
-                ui->plot->graph()->setName (QString("Channel %1").arg(channels));
-                if(ui->plot->legend->item(channels))
+                int channel = i - first_member;
+
+                /* 新的数据，通道是否比之前的多，添加新的通道 */
+                while (port.graphs.size() <= channel)
                 {
-                    ui->plot->legend->item (channels)->setTextColor (line_colors[channels % CUSTOM_LINE_COLORS]);
+                    addChannel (port, portName, channelLabel (frame.values.size() - first_member, port.graphs.size()));
                 }
-                ui->listWidget_Channels->addItem(ui->plot->graph()->name());
-                ui->listWidget_Channels->item(channel)->setForeground(QBrush(line_colors[channels % CUSTOM_LINE_COLORS]));
-                channels++;
+
+                /* Rolling (v1.0.0 compatible) */
+                ui->plot->graph(port.graphs[channel])->addData (key, frame.values[i]);
+                valueTrackers[port.graphs[channel]].add (key, frame.values[i]);
+                if (captureMode == CAPTURE_LEVEL && port.graphs[channel] == captureChannel)
+                    checkCaptureLevel (frame.values[i]);
+                if (persistColorMap != nullptr && ui->plot->graph(port.graphs[channel])->visible() &&
+                    ui->plot->graph(port.graphs[channel])->keyAxis() == ui->plot->xAxis)
+                    persistence.addSample (port.graphs[channel], key, frame.values[i]);
             }
 
-            /* [TODO] Method selection and plotting */
+            /* Post-parsing */
             /* X-Y */
-            if (0)
+            if (data_format == DATA_FORMAT_XY)
             {
-
+                /* t 是串口的帧序号，每条曲线只保留最近的 spinPoints 个点，绘制的代价不随时间增长 */
+                for (int pair = 0; first_member + 2 * pair + 1 < frame.values.size(); pair++)
+                {
+                    while (port.curves.size() <= pair)
+                    {
+                        addCurve (port, portName);
+                    }
+                    QSharedPointer<QCPCurveDataContainer> data = port.curves[pair]->data();
+                    data->add (QCPCurveData (port.samples, frame.values[first_member + 2 * pair], frame.values[first_member + 2 * pair + 1]));
+                    data->removeBefore (port.samples - ui->spinPoints->value() + 1);
+                    if (captureMode == CAPTURE_LEVEL && port.curves[pair] == xyCurves.value (captureChannel))
+                        checkCaptureLevel (frame.values[first_member + 2 * pair + 1]);
+                }
+                port.samples++;
+                dataPointNumber = qMax (dataPointNumber, port.samples);
             }
             /* Rolling (v1.0.0 compatible) */
             else
             {
-                /* Add data to Graph 0 */
-                ui->plot->graph(channel)->addData (dataPointNumber, newData[channel].toDouble());
-                /* Increment data number and channel */
-                channel++;
+                port.samples++;
+                dataPointNumber = qMax (dataPointNumber, port.samples);
+                if (xAxisMode != X_AXIS_SAMPLES && key > lastFrameKey)
+                {
+                    lastFrameKey = key;
+                    timeBetweenSamples = port.timing.interval;
+                }
             }
         }
+    }
 
-        /* Post-parsing */
-        /* X-Y */
-        if (0)
-        {
+    /* 有新的通道，重新分组 */
+    if (ui->plot->graphCount() != graphCount && plotLayoutMode != LAYOUT_OVERLAY)
+    {
+        applyPlotLayout();
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+/**
+ * @brief 为串口增加一个通道，也就是一条新的曲线
+ * @param port 串口的通道
+ * @param portName 串口名，多个串口时用于曲线名
+ * @param label 派生通道的表达式，用作曲线名，普通通道为空
+ */
+void MainWindow::addChannel (PortChannels &port, const QString &portName, const QString &label)
+{
+    ui->plot->addGraph();
+    ui->plot->graph()->setPen (line_colors[channels % CUSTOM_LINE_COLORS]);
+    if (!label.isEmpty())
+        ui->plot->graph()->setName (openPorts.size() > 1 ? QString("%1 %2").arg(portName).arg(label) : label);
+    else if (openPorts.size() > 1)
+        ui->plot->graph()->setName (QString("%1 Channel %2").arg(portName).arg(port.graphs.size()));
+    else
+        ui->plot->graph()->setName (QString("Channel %1").arg(channels));
+    if(ui->plot->legend->itemWithPlottable (ui->plot->graph()))
+    {
+        ui->plot->legend->itemWithPlottable (ui->plot->graph())->setTextColor (line_colors[channels % CUSTOM_LINE_COLORS]);
+    }
+    ui->listWidget_Channels->addItem(ui->plot->graph()->name());
+    ui->listWidget_Channels->item(channels)->setForeground(QBrush(line_colors[channels % CUSTOM_LINE_COLORS]));
+    port.graphs.append (ui->plot->graphCount() - 1);
+    valueTrackers.append (RangeTracker());
+    channels++;
+    applyPersistedGraphs();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 按通道下标找到派生通道和滤波拷贝的名字
+ *
+ * 一帧的通道依次是消息中的字段、滤波后的拷贝（原始和滤波同时显示时）、派生通道
+ *
+ * @param channelCount 这一帧的通道数，包括滤波拷贝和派生通道
+ * @param channel 通道下标
+ * @return 派生通道的表达式或滤波拷贝的名字，普通通道返回空字符串
+ */
+QString MainWindow::channelLabel (int channelCount, int channel) const
+{
+    int fields = channelCount - derivedChannels.count();
+    if (channel >= fields)
+        return derivedChannels.expressions[channel - fields].text();
+    if (filterSettings.enabled() && filterSettings.view == FILTER_VIEW_BOTH && channel >= fields / 2)
+        return QString ("Channel %1 滤波").arg (channel - fields / 2);
+    return QString();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 为串口的下一对通道增加一条X-Y曲线
+ *
+ * X-Y模式下没有每个通道的曲线，通道列表中的每一项是一条X-Y曲线。
+ * @param port 串口的通道
+ * @param portName 串口名，多个串口时用于曲线名
+ */
+void MainWindow::addCurve (PortChannels &port, const QString &portName)
+{
+    int pair = port.curves.size();
+    QColor color = line_colors[channels % CUSTOM_LINE_COLORS];
+
+    QCPCurve *curve = new QCPCurve (ui->plot->xAxis, ui->plot->yAxis);
+    curve->setPen (color);
+    curve->setAdaptiveSampling (true);//不到一个像素的点不画，点很密时也只画看得到的线段
+    if (openPorts.size() > 1)
+        curve->setName (QString("%1 Channel %2/%3").arg(portName).arg(2 * pair).arg(2 * pair + 1));
+    else
+        curve->setName (QString("Channel %1/%2").arg(2 * pair).arg(2 * pair + 1));
+    if (ui->plot->legend->itemWithPlottable (curve))
+    {
+        ui->plot->legend->itemWithPlottable (curve)->setTextColor (color);
+    }
+    ui->listWidget_Channels->addItem (curve->name());
+    ui->listWidget_Channels->item (channels)->setForeground (QBrush (color));
+    port.curves.append (curve);
+    xyCurves.append (curve);
+    channels++;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 通道列表中的一行对应的曲线
+ * @param row 通道列表的行
+ * @return X-Y模式下是X-Y曲线，其他模式下是通道的曲线
+ */
+QCPAbstractPlottable *MainWindow::listPlottable (int row) const
+{
+    if (data_format == DATA_FORMAT_XY)
+        return xyCurves.value (row);
+    return ui->plot->graph (row);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 用一次触发扫描替换串口所有通道的数据
+ *
+ * X轴坐标相对于触发帧：采样序号模式下是帧的序号差，时间模式下是时间差。
+ * @param batch 串口线程发送的一次完整扫描
+ * @param port 这次扫描所属的串口
+ * @param portName 串口名
+ */
+void MainWindow::plotSweep (const SerialBatch &batch, PortChannels &port, const QString &portName)
+{
+    const int count = batch.frames.size();
+    QVector<double> keys (count);
+    int first_member = 0;
+    int channelCount = 0;
+
+    port.timing.gap = true;//两次扫描之间的帧没有发送过来，不算帧间隔
+    for (int f = 0; f < count; f++)
+    {
+        keys[f] = frameKey (batch.frames[f], port, &first_member);
+        channelCount = qMax (channelCount, batch.frames[f].values.size() - first_member);
+    }
+    double triggerKey = keys[batch.triggerIndex];
+    for (int f = 0; f < count; f++)
+    {
+        keys[f] = xAxisMode == X_AXIS_SAMPLES ? f - batch.triggerIndex : keys[f] - triggerKey;
+    }
+
+    while (data_format != DATA_FORMAT_XY && port.graphs.size() < channelCount)
+    {
+        addChannel (port, portName, channelLabel (channelCount, port.graphs.size()));
+    }
+
+    if (data_format == DATA_FORMAT_XY)//X-Y模式下每对通道是一条曲线，t 是扫描中的帧序号
+    {
+        for (int pair = 0; 2 * pair + 1 < channelCount; pair++)
+        {
+            while (port.curves.size() <= pair)
+            {
+                addCurve (port, portName);
+            }
+            QSharedPointer<QCPCurveDataContainer> data = port.curves[pair]->data();
+            bool capture = captureMode == CAPTURE_LEVEL && port.curves[pair] == xyCurves.value (captureChannel);
+            data->clear();
+            for (int f = 0; f < count; f++)
+            {
+                const QVector<double> &values = batch.frames[f].values;
+                if (first_member + 2 * pair + 1 >= values.size())
+                    continue;
+                data->add (QCPCurveData (f, values[first_member + 2 * pair], values[first_member + 2 * pair + 1]));
+                if (capture)
+                    checkCaptureLevel (values[first_member + 2 * pair + 1]);
+            }
         }
-        /* Rolling (v1.0.0 compatible) */
-        else
+    }
+    else
+    {
+        QVector<double> channelKeys, channelValues;
+        channelKeys.reserve (count);
+        channelValues.reserve (count);
+        for (int channel = 0; channel < port.graphs.size(); channel++)
         {
-            dataPointNumber++;
-            channel = 0;
+            int index = port.graphs[channel];
+            QCPGraph *graph = ui->plot->graph (index);
+            bool persist = persistColorMap != nullptr && graph->visible() && graph->keyAxis() == ui->plot->xAxis;
+            bool capture = captureMode == CAPTURE_LEVEL && index == captureChannel;
+            channelKeys.resize (0);
+            channelValues.resize (0);
+            valueTrackers[index].clear();
+            for (int f = 0; f < count; f++)
+            {
+                const QVector<double> &values = batch.frames[f].values;
+                if (first_member + channel >= values.size())
+                    continue;
+                double value = values[first_member + channel];
+                channelKeys.append (keys[f]);
+                channelValues.append (value);
+                valueTrackers[index].add (keys[f], value);
+                if (capture)
+                    checkCaptureLevel (value);
+                if (persist)
+                    persistence.addSample (index, keys[f], value);
+            }
+            graph->setData (channelKeys, channelValues, xAxisMode == X_AXIS_SAMPLES);
         }
     }
-    you_shall_NOT_PASS = false;
+
+    port.samples += count;
+    dataPointNumber = qMax (dataPointNumber, port.samples);
+    if (xAxisMode != X_AXIS_SAMPLES)
+        timeBetweenSamples = port.timing.interval;
 }
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
@@ -446,71 +1364,166 @@ void MainWindow::on_spinAxesMax_valueChanged(int arg1)
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 /**
- * @brief 从串口中读取数据
+ * @brief 当Y轴单元格长度变化，也就是spinYStep控件发生变化
+ * @param arg1
  */
-void MainWindow::readData()
+void MainWindow::on_spinYStep_valueChanged(int arg1)
 {
-    if(serialPort->bytesAvailable()) {//串口中是否有数据
-        QByteArray data = serialPort->readAll(); //读取所有数据
+    ui->plot->yAxis->ticker()->setTickCount(arg1);
+    ui->plot->replot();
+    ui->spinYStep->setValue(ui->plot->yAxis->ticker()->tickCount());
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-        if(!data.isEmpty()) {//得到的数据是否为空
-            char *temp = data.data();//获取以 '\0' 结尾的 char* 到数据
+/**
+ * @brief 保存png图片到exe的运行目录
+ */
+void MainWindow::on_savePNGButton_clicked()
+{
+    exportPlot (QString::number(dataPointNumber) + ".png", EXPORT_PNG);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-            if (!filterDisplayedData){//是否要显示过滤后的数据
-                ui->textEdit_UartWindow->append(data);
-            }
-            for(int i = 0; temp[i] != '\0'; i++) {//遍历数组
-                switch(STATE) {
-                case WAIT_START://等待帧头状态
-                    if(temp[i] == START_MSG) {//接收到帧头
-                        STATE = IN_MESSAGE;
-                        receivedData.clear(); //清空数据
-                        break;
-                    }
-                    break;
-                case IN_MESSAGE://接收到帧头
-                    if(temp[i] == END_MSG) {//接收到帧尾
-                        STATE = WAIT_START;
-                        QStringList incomingData = receivedData.split(' '); //使用空格将它们分割
-                        if(filterDisplayedData){
-                            ui->textEdit_UartWindow->append(receivedData);
-                        }
-                        emit newData(incomingData); //发送信号，解析到数据用于显示到绘图区
-                        break;
-                    }
-                    else if (isdigit (temp[i]) || isspace (temp[i]) || temp[i] =='-' || temp[i] =='.')//检查字符是否为数字，空格，'-'，'.'
-                    {
-                        receivedData.append(temp[i]);
-                    }
-                    break;
-                default: break;
-                }
-            }
-        }
+/**
+ * @brief 保存pdf文件到exe的运行目录
+ */
+void MainWindow::on_savePDFButton_clicked()
+{
+    exportPlot (QString::number(dataPointNumber) + ".pdf", EXPORT_PDF);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 保存svg文件到exe的运行目录
+ */
+void MainWindow::on_saveSVGButton_clicked()
+{
+    exportPlot (QString::number(dataPointNumber) + ".svg", EXPORT_SVG);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 记录当前显示的绘图区，交给导出线程绘制和保存
+ *
+ * GUI线程只记录绘图命令，不做光栅化和编码，串口数据和重绘不会被阻塞。
+ */
+void MainWindow::exportPlot (const QString &fileName, int format)
+{
+    ExportJob job = ExportWorker::record (ui->plot, fileName, format, 1920, 1080, format == EXPORT_PNG ? 2 : 1);
+    QMetaObject::invokeMethod (exportWorker, "exportPlot", Qt::QueuedConnection, Q_ARG(ExportJob, job));
+
+    pendingExports++;
+    exportProgressBar->setValue (0);
+    exportProgressBar->setVisible (true);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 自动截图方式改变
+ * @param index CAPTURE_*
+ */
+void MainWindow::on_comboCapture_currentIndexChanged(int index)
+{
+    captureMode = index;
+    applyCapture();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 读取自动截图的参数，重新开始计时和检测
+ */
+void MainWindow::applyCapture()
+{
+    captureChannel = ui->spinCaptureChannel->value();
+    captureLevel = ui->spinCaptureLevel->value();
+    captureArmed = false;//阈值改变后要先回到阈值以下
+    capturePending = false;
+    lastCapture.invalidate();
+
+    ui->spinCaptureInterval->setEnabled (captureMode != CAPTURE_OFF);
+    ui->spinCaptureChannel->setEnabled (captureMode == CAPTURE_LEVEL);
+    ui->spinCaptureLevel->setEnabled (captureMode == CAPTURE_LEVEL);
+
+    if (captureMode == CAPTURE_TIMER)
+        captureTimer.start (ui->spinCaptureInterval->value() * 1000);
+    else
+        captureTimer.stop();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 定时截图，绘图时在下一次重绘后截图，暂停时立即截图
+ */
+void MainWindow::onCaptureTimer()
+{
+    capturePending = true;
+    if (!updateTimer.isActive())
+        takeCapture();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 通道的新数据从下向上越过阈值时请求截图
+ *
+ * 滚动显示、触发扫描和X-Y模式都按采样的顺序调用，X-Y模式下检测的是曲线的Y值。
+ * 两次截图之间至少间隔 spinCaptureInterval 秒，信号在阈值附近抖动时不会连续截图。
+ */
+void MainWindow::checkCaptureLevel (double value)
+{
+    if (value < captureLevel)
+    {
+        captureArmed = true;
+        return;
+    }
+    if (!captureArmed)
+        return;
+    captureArmed = false;
+
+    if (lastCapture.isValid() && lastCapture.elapsed() < ui->spinCaptureInterval->value() * 1000)
+        return;
+    lastCapture.start();
+    capturePending = true;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 保存带时间戳的PNG，导出队列已满时丢掉这次截图
+ *
+ * 队列有上限，短时间内大量触发时GUI线程最多记录 CAPTURE_QUEUE_MAX 次绘图，
+ * 不会积压内存，也不会拖慢数据的接收。
+ */
+void MainWindow::takeCapture()
+{
+    capturePending = false;
+    if (pendingExports >= CAPTURE_QUEUE_MAX)
+    {
+        droppedCaptures++;
+        ui->statusBar->showMessage (QString ("导出队列已满，跳过 %1 次截图").arg (droppedCaptures));
+        return;
     }
+    exportPlot (QDateTime::currentDateTime().toString ("yyyyMMdd_HHmmss_zzz") + ".png", EXPORT_PNG);
 }
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
-
 /**
- * @brief 当Y轴单元格长度变化，也就是spinYStep控件发生变化
- * @param arg1
+ * @brief 导出线程正在处理的文件和进度
  */
-void MainWindow::on_spinYStep_valueChanged(int arg1)
+void MainWindow::onExportProgress (QString fileName, int percent)
 {
-    ui->plot->yAxis->ticker()->setTickCount(arg1);
-    ui->plot->replot();
-    ui->spinYStep->setValue(ui->plot->yAxis->ticker()->tickCount());
+    exportProgressBar->setFormat (QFileInfo (fileName).fileName() + QString (" %p% (%1)").arg (pendingExports));
+    exportProgressBar->setValue (percent);
 }
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 /**
- * @brief 保存png图片到exe的运行目录
+ * @brief 一个导出任务完成，全部完成后隐藏进度条
  */
-void MainWindow::on_savePNGButton_clicked()
+void MainWindow::onExportFinished (QString fileName, bool success)
 {
-    ui->plot->savePng (QString::number(dataPointNumber) + ".png", 1920, 1080, 2, 50);
+    pendingExports = qMax (pendingExports - 1, 0);
+    ui->statusBar->showMessage ((success ? "已保存 " : "保存失败 ") + fileName);
+    if (pendingExports == 0)
+        exportProgressBar->setVisible (false);
 }
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
@@ -520,10 +1533,16 @@ void MainWindow::on_savePNGButton_clicked()
  */
 void MainWindow::onMouseMoveInPlot(QMouseEvent *event)
 {
-    int xx = int(ui->plot->xAxis->pixelToCoord(event->x()));
-    int yy = int(ui->plot->yAxis->pixelToCoord(event->y()));
+    /* 分组显示时使用鼠标所在区域的Y轴 */
+    QCPAxisRect *rect = ui->plot->axisRectAt (event->pos());
+    QCPAxis *valueAxis = rect ? rect->axis (QCPAxis::atLeft) : ui->plot->yAxis;
+    double xx = ui->plot->xAxis->pixelToCoord(event->x());
+    int yy = int(valueAxis->pixelToCoord(event->y()));
     QString coordinates("X: %1 Y: %2");
-    coordinates = coordinates.arg(xx).arg(yy);
+    if (xAxisMode == X_AXIS_SAMPLES)
+        coordinates = coordinates.arg(int(xx)).arg(yy);
+    else
+        coordinates = coordinates.arg(xx, 0, 'f', 3).arg(yy);
     ui->statusBar->showMessage(coordinates);
 }
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -554,9 +1573,10 @@ void MainWindow::channel_selection (void)
         QCPGraph *graph = ui->plot->graph(i);
         QCPPlottableLegendItem *item = ui->plot->legend->itemWithPlottable(graph);
 
-        if (item->selected() || graph->selected())
+        if ((item && item->selected()) || graph->selected())//X-Y模式下通道不在图例中
         {
-            item->setSelected(true);
+            if (item)
+                item->setSelected(true);
 
             QPen pen;
             pen.setWidth(3);
@@ -586,9 +1606,9 @@ void MainWindow::legend_double_click(QCPLegend *legend, QCPAbstractLegendItem *i
         if (ok)
         {
             plItem->plottable()->setName(newName);
-            for(int i=0; i<ui->plot->graphCount(); i++)
+            for(int i=0; i<ui->listWidget_Channels->count(); i++)
             {
-                ui->listWidget_Channels->item(i)->setText(ui->plot->graph(i)->name());
+                ui->listWidget_Channels->item(i)->setText(listPlottable(i)->name());
             }
             ui->plot->replot();
         }
@@ -603,7 +1623,9 @@ void MainWindow::legend_double_click(QCPLegend *legend, QCPAbstractLegendItem *i
 void MainWindow::on_spinPoints_valueChanged (int arg1)
 {
     Q_UNUSED(arg1)
-    ui->plot->xAxis->setRange (dataPointNumber - ui->spinPoints->value(), dataPointNumber);
+    if (triggerSettings.edge != TRIGGER_OFF)//预触发和触发后的帧数按点数计算
+        applyTrigger();
+    updateXRange();
     ui->plot->replot();
 }
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -638,8 +1660,16 @@ void MainWindow::on_actionConnect_triggered()
     }
     else
     {
-        /* 打开串口 */
-        QSerialPortInfo portInfo (ui->comboPort->currentText());
+        /* 勾选的串口全部打开，没有勾选时只打开端口下拉框中的串口 */
+        QStringList portNames;
+        for (int i = 0; i < ui->listWidget_Ports->count(); i++)
+        {
+            if (ui->listWidget_Ports->item(i)->checkState() == Qt::Checked)
+                portNames.append (ui->listWidget_Ports->item(i)->text());
+        }
+        if (portNames.isEmpty())
+            portNames.append (ui->comboPort->currentText());
+
         int baudRate = ui->comboBaud->currentText().toInt();
         QSerialPort::DataBits dataBits;
         QSerialPort::Parity parity;
@@ -649,11 +1679,21 @@ void MainWindow::on_actionConnect_triggered()
         parity = QSerialPort::NoParity;
         stopBits = QSerialPort::OneStop;
 
-        /* 实例化串口 */
-        serialPort = new QSerialPort (portInfo, nullptr);
+        /* 所有串口共用一个时间起点 */
+        if (!timeOfFirstData.isValid())
+            timeOfFirstData.start();
 
-        /* 打开串口 */
-        openPort (portInfo, baudRate, dataBits, parity, stopBits);
+        /* 打开串口，每个串口一个线程 */
+        for (const QString &name : portNames)
+        {
+            if (!openPort (QSerialPortInfo (name), baudRate, dataBits, parity, stopBits))
+            {
+                closePorts();
+                emit portOpenFail();
+                return;
+            }
+        }
+        emit portOpenOK();
     }
 }
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -690,6 +1730,65 @@ void MainWindow::on_actionRecord_stream_triggered()
 }
 /** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+/**
+ * @brief 十六进制查看按钮触发，显示/隐藏原始数据窗口
+ */
+void MainWindow::on_actionHex_view_triggered()
+{
+    if (hexViewWindow == nullptr)
+    {
+        hexViewWindow = new HexViewWindow (this);
+        hexViewWindow->setWindowTitle ("原始数据 (HEX)");
+        hexViewWindow->setFrameMarkers (START_MSG, END_MSG);
+        updateHexSources();
+        connect (hexViewWindow, SIGNAL(captureEnabled(bool)), this, SLOT(onHexCaptureEnabled(bool)));
+    }
+
+    if (ui->actionHex_view->isChecked())
+    {
+        hexViewWindow->show();
+    }
+    else
+    {
+        hexViewWindow->hide();
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 十六进制窗口显示或隐藏
+ * @param enable true 开始保存原始数据，false 停止
+ */
+void MainWindow::onHexCaptureEnabled (bool enable)
+{
+    hexCaptureEnabled = enable;
+    for (OpenPort &port : openPorts)
+    {
+        port.worker->setHexCapture (enable);
+    }
+    ui->actionHex_view->setChecked (enable);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 把打开的串口交给十六进制窗口选择，默认显示第一个串口
+ */
+void MainWindow::updateHexSources()
+{
+    if (hexViewWindow == nullptr)
+        return;
+
+    QStringList names;
+    QVector<ByteRing*> rings;
+    for (OpenPort &port : openPorts)
+    {
+        names.append (port.name);
+        rings.append (port.worker->hexRing());
+    }
+    hexViewWindow->setSources (names, rings);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 /**
  * @brief 关闭串口按钮触发
  */
@@ -697,10 +1796,8 @@ void MainWindow::on_actionDisconnect_triggered()
 {
     if (connected)
     {
-        serialPort->close();
+        closePorts();
         emit portClosed();
-        delete serialPort;
-        serialPort = nullptr;
 
         ui->statusBar->showMessage ("关闭串口!");
 
@@ -711,9 +1808,10 @@ void MainWindow::on_actionDisconnect_triggered()
         ui->actionPause_Plot->setEnabled (false);
         ui->actionDisconnect->setEnabled (false);
         ui->actionRecord_stream->setEnabled(true);
-        receivedData.clear();
 
         ui->savePNGButton->setEnabled (false);
+        ui->savePDFButton->setEnabled (false);
+        ui->saveSVGButton->setEnabled (false);
         enable_com_controls (true);
     }
 }
@@ -724,10 +1822,20 @@ void MainWindow::on_actionDisconnect_triggered()
  */
 void MainWindow::on_actionClear_triggered()
 {
+    persistence.setColorMap (nullptr);
+    persistence.clear();
+    persistColorMap = nullptr;//clearPlottables() 会删除色图
+    spectrumCurves.clear();
+    xyCurves.clear();
+    waterfallMap = nullptr;
     ui->plot->clearPlottables();
+    QMetaObject::invokeMethod (spectrumWorker, "clear", Qt::QueuedConnection);
     ui->listWidget_Channels->clear();
     channels = 0;
+    valueTrackers.clear();
     dataPointNumber = 0;
+    portChannels.clear();
+    resetFrameTiming();
     emit setupPlot();
     ui->plot->replot();
 }
@@ -765,17 +1873,29 @@ void MainWindow::closeCsvFile(void)
  * @brief 保存接收到数据
  *
  */
-void MainWindow::saveStream(QStringList newData)
+void MainWindow::saveStream(SerialBatch batch)
 {
     if(!m_csvFile)
         return;
-    if(ui->actionRecord_stream->isChecked())
+    if(ui->actionRecord_stream->isChecked() && batch.session == portSession && batch.port < openPorts.size())
     {
         QTextStream out(m_csvFile);
-        foreach (const QString &str, newData) {
-            out << str << ",";
+        /* 触发时保存所有的帧，不只是触发的扫描 */
+        const QVector<SerialFrame> &frames = batch.triggered ? batch.stream : batch.frames;
+        foreach (const SerialFrame &frame, frames) {
+            if (openPorts.size() > 1)//多个串口时第一列保存串口名
+            {
+                out << openPorts[batch.port].name << ",";
+            }
+            if (xAxisMode == X_AXIS_HOST_TIME)//接收时间模式下保存本机时间
+            {
+                out << QString::number (frame.timestamp, 'f', 6) << ",";
+            }
+            foreach (double value, frame.values) {
+                out << value << ",";
+            }
+            out << "\n";
         }
-        out << "\n";
     }
 }
 
@@ -811,13 +1931,36 @@ void MainWindow::on_pushButton_ShowallData_clicked()
         filterDisplayedData = true;
         ui->pushButton_ShowallData->setText("显示所有数据");
     }
+    for (OpenPort &port : openPorts)
+    {
+        port.worker->setRawText (!filterDisplayedData);
+    }
 }
 /**
  * @brief Y轴自动缩放到合适比例
  */
 void MainWindow::on_pushButton_AutoScale_clicked()
 {
-    ui->plot->yAxis->rescale(true);
+    /* 使用增量维护的最小/最大值，不需要扫描全部数据 */
+    QCPRange range;
+    bool found = false;
+    for (int i = 0; i < ui->plot->graphCount() && i < valueTrackers.size(); i++)
+    {
+        QCPRange graphRange;
+        if (ui->plot->graph(i)->valueAxis() != ui->plot->yAxis || !ui->plot->graph(i)->visible())
+            continue;
+        if (!valueTrackers[i].totalRange (&graphRange))
+            continue;
+        if (found)
+            range.expand (graphRange);
+        else
+            range = graphRange;
+        found = true;
+    }
+    if (!found)
+        return;
+
+    ui->plot->yAxis->setRange (range);
     ui->spinAxesMax->setValue(int(ui->plot->yAxis->range().upper) + int(ui->plot->yAxis->range().upper*0.1));
     ui->spinAxesMin->setValue(int(ui->plot->yAxis->range().lower) + int(ui->plot->yAxis->range().lower*0.1));
 }
@@ -826,9 +1969,9 @@ void MainWindow::on_pushButton_AutoScale_clicked()
  */
 void MainWindow::on_pushButton_ResetVisible_clicked()
 {
-    for(int i=0; i<ui->plot->graphCount(); i++)
+    for(int i=0; i<ui->listWidget_Channels->count(); i++)
     {
-        ui->plot->graph(i)->setVisible(true);
+        listPlottable(i)->setVisible(true);
         ui->listWidget_Channels->item(i)->setBackground(Qt::NoBrush);
     }
 }
@@ -838,16 +1981,16 @@ void MainWindow::on_pushButton_ResetVisible_clicked()
  */
 void MainWindow::on_listWidget_Channels_itemDoubleClicked(QListWidgetItem *item)
 {
-    int graphIdx = ui->listWidget_Channels->currentRow();
+    QCPAbstractPlottable *plottable = listPlottable(ui->listWidget_Channels->currentRow());
 
-    if(ui->plot->graph(graphIdx)->visible())
+    if(plottable->visible())
     {
-        ui->plot->graph(graphIdx)->setVisible(false);
+        plottable->setVisible(false);
         item->setBackgroundColor(Qt::black);
     }
     else
     {
-        ui->plot->graph(graphIdx)->setVisible(true);
+        plottable->setVisible(true);
         item->setBackground(Qt::NoBrush);
     }
     ui->plot->replot();
@@ -856,10 +1999,482 @@ void MainWindow::on_listWidget_Channels_itemDoubleClicked(QListWidgetItem *item)
  * @brief 扫描串口
  */
 void MainWindow::on_pushButton_clicked()
+{
+    fillPortLists();
+}
+/**
+ * @brief 把电脑上的串口填充到端口下拉框和多串口列表
+ */
+void MainWindow::fillPortLists()
 {
     ui->comboPort->clear();
+    ui->listWidget_Ports->clear();
     for (QSerialPortInfo port : QSerialPortInfo::availablePorts())
     {
         ui->comboPort->addItem (port.portName());
+
+        QListWidgetItem *item = new QListWidgetItem (port.portName(), ui->listWidget_Ports);
+        item->setFlags (item->flags() | Qt::ItemIsUserCheckable);
+        item->setCheckState (Qt::Unchecked);
+        item->setToolTip (port.description());
+    }
+}
+/**
+ * @brief 选择X轴数据来源
+ * @param index X_AXIS_*
+ */
+void MainWindow::on_comboXAxis_currentIndexChanged(int index)
+{
+    if (index < 0 || index == xAxisMode)
+        return;
+
+    /* 不同来源的X轴坐标不能混在一起，切换后清空数据 */
+    xAxisMode = index;
+    applyTrigger();//设备时间模式下触发通道的字段下标不同
+    applyDerived();//设备时间模式下 ch0 是第二个字段
+    applyFilters();
+    applySpectrum();//设备时间模式下第一个字段不是通道，频率单位也不同
+    on_actionClear_triggered();
+}
+/**
+ * @brief 选择通道的分组显示方式
+ * @param index LAYOUT_*
+ */
+void MainWindow::on_comboLayout_currentIndexChanged(int index)
+{
+    if (index < 0 || index == plotLayoutMode)
+        return;
+
+    plotLayoutMode = index;
+    applyPlotLayout();
+
+    /* 余辉只支持叠加显示 */
+    ui->comboPersist->setEnabled (plotLayoutMode == LAYOUT_OVERLAY);
+    if (plotLayoutMode != LAYOUT_OVERLAY)
+        ui->comboPersist->setCurrentIndex (PERSIST_OFF);
+    ui->plot->replot();
+}
+/**
+ * @brief 选择滚动显示或X-Y显示
+ * @param index DATA_FORMAT_*
+ */
+void MainWindow::on_comboFormat_currentIndexChanged(int index)
+{
+    if (index < 0 || index == data_format)
+        return;
+
+    data_format = index;
+
+    /* X-Y模式只支持叠加显示，没有余辉 */
+    bool xy = data_format == DATA_FORMAT_XY;
+    if (xy)
+    {
+        ui->comboLayout->setCurrentIndex (LAYOUT_OVERLAY);
+        ui->comboPersist->setCurrentIndex (PERSIST_OFF);
+    }
+    ui->comboLayout->setEnabled (!xy);
+    ui->comboPersist->setEnabled (!xy && plotLayoutMode == LAYOUT_OVERLAY);
+
+    /* 两种方式的X轴不同，切换后清空数据 */
+    on_actionClear_triggered();
+}
+/**
+ * @brief 选择Y轴自动缩放方式
+ * @param index AUTO_Y_*
+ */
+void MainWindow::on_comboAutoY_currentIndexChanged(int index)
+{
+    if (index < 0 || index == autoYMode)
+        return;
+
+    autoYMode = index;
+    if (autoYMode == AUTO_Y_OFF)//恢复手动设置的范围
+    {
+        ui->plot->yAxis->setRange (ui->spinAxesMin->value(), ui->spinAxesMax->value());
+    }
+    ui->spinAxesMin->setEnabled (autoYMode == AUTO_Y_OFF);
+    ui->spinAxesMax->setEnabled (autoYMode == AUTO_Y_OFF);
+    ui->pushButton_AutoScale->setEnabled (autoYMode == AUTO_Y_OFF);
+    replot();
+}
+/**
+ * @brief 选择余辉显示方式
+ * @param index PERSIST_*
+ */
+void MainWindow::on_comboPersist_currentIndexChanged(int index)
+{
+    if (index < 0 || index == persistMode)
+        return;
+
+    persistMode = index;
+    applyPersistence();
+    ui->plot->replot();
+}
+/**
+ * @brief 选择触发方式
+ * @param index TRIGGER_*
+ */
+void MainWindow::on_comboTrigger_currentIndexChanged(int index)
+{
+    if (index < 0 || index == triggerSettings.edge)
+        return;
+
+    /* 滚动显示和触发扫描的X轴坐标不同，切换后清空数据 */
+    bool wasTriggered = triggerSettings.edge != TRIGGER_OFF;
+    applyTrigger();
+    if (wasTriggered != (index != TRIGGER_OFF))
+        on_actionClear_triggered();
+}
+/**
+ * @brief 按触发控件设置触发条件，发送给所有串口线程
+ *
+ * 一次扫描共 spinPoints 帧，其中 spinTriggerPre% 在触发帧之前
+ */
+void MainWindow::applyTrigger()
+{
+    int points = qMax (ui->spinPoints->value(), 1);
+
+    triggerSettings.edge = ui->comboTrigger->currentIndex();
+    triggerSettings.field = ui->spinTriggerChannel->value();
+    if (xAxisMode == X_AXIS_DEVICE_MS || xAxisMode == X_AXIS_DEVICE_US)//设备时间模式下第一个字段是时间戳
+        triggerSettings.field++;
+    triggerSettings.level = ui->spinTriggerLevel->value();
+    triggerSettings.hysteresis = ui->spinTriggerHyst->value();
+    triggerSettings.preFrames = points * ui->spinTriggerPre->value() / 100;
+    triggerSettings.postFrames = qMax (points - triggerSettings.preFrames - 1, 0);
+    triggerSettings.holdoffFrames = ui->spinTriggerHoldoff->value();
+
+    for (OpenPort &port : openPorts)
+    {
+        QMetaObject::invokeMethod (port.worker, "setTrigger", Qt::QueuedConnection, Q_ARG(TriggerSettings, triggerSettings));
+    }
+}
+/**
+ * @brief 编译派生通道的表达式，多个表达式用 ';' 分隔
+ *
+ * 有错误时在状态栏显示，继续使用之前的表达式。表达式改变后通道的名字和个数都变了，清空数据
+ */
+void MainWindow::on_lineDerived_editingFinished()
+{
+    DerivedChannels derived;
+    const QStringList texts = ui->lineDerived->text().split (DERIVED_SEPARATOR);
+    for (const QString &text : texts)
+    {
+        if (text.trimmed().isEmpty())
+            continue;
+
+        ChannelExpression expression;
+        QString error;
+        if (!expression.compile (text, &error))
+        {
+            ui->statusBar->showMessage (QString ("派生通道 \"%1\" 错误，%2").arg (text.trimmed()).arg (error));
+            return;
+        }
+        derived.expressions.append (expression);
+    }
+
+    bool changed = derived.count() != derivedChannels.count();
+    for (int i = 0; !changed && i < derived.count(); i++)
+    {
+        changed = derived.expressions[i].text() != derivedChannels.expressions[i].text();
+    }
+
+    derivedChannels = derived;
+    applyDerived();
+    if (changed)
+        on_actionClear_triggered();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 解析滤波器链，多个滤波器用 ';' 分隔
+ *
+ * 有错误时在状态栏显示，继续使用之前的滤波器链
+ */
+void MainWindow::on_lineFilter_editingFinished()
+{
+    FilterSettings settings = filterSettings;
+    QString error;
+    if (!settings.setChain (ui->lineFilter->text(), &error))
+    {
+        ui->statusBar->showMessage (QString ("滤波器错误，%1").arg (error));
+        return;
+    }
+
+    /* 原始和滤波同时显示时，打开或关闭滤波改变了通道数，清空数据 */
+    bool relayout = settings.view == FILTER_VIEW_BOTH && settings.enabled() != filterSettings.enabled();
+    filterSettings = settings;
+    applyFilters();
+    if (relayout)
+        on_actionClear_triggered();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @param index FILTER_VIEW_*
+ */
+void MainWindow::on_comboFilterView_currentIndexChanged(int index)
+{
+    if (index < 0 || index == filterSettings.view)
+        return;
+
+    filterSettings.view = index;
+    applyFilters();
+    if (filterSettings.enabled())//通道数改变了，清空数据
+        on_actionClear_triggered();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 把滤波器链发送给所有串口线程，每个串口的滤波器状态重新开始
+ */
+void MainWindow::applyFilters()
+{
+    filterSettings.firstField = (xAxisMode == X_AXIS_DEVICE_MS || xAxisMode == X_AXIS_DEVICE_US) ? 1 : 0;
+
+    for (OpenPort &port : openPorts)
+    {
+        QMetaObject::invokeMethod (port.worker, "setFilters", Qt::QueuedConnection, Q_ARG(FilterSettings, filterSettings));
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 把派生通道发送给所有串口线程，新的派生通道在下一帧出现
+ */
+void MainWindow::applyDerived()
+{
+    derivedChannels.firstField = (xAxisMode == X_AXIS_DEVICE_MS || xAxisMode == X_AXIS_DEVICE_US) ? 1 : 0;
+
+    for (OpenPort &port : openPorts)
+    {
+        QMetaObject::invokeMethod (port.worker, "setDerivedChannels", Qt::QueuedConnection, Q_ARG(DerivedChannels, derivedChannels));
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 选择频谱的窗函数，关闭时不显示频谱
+ * @param index SPECTRUM_*
+ */
+void MainWindow::on_comboSpectrum_currentIndexChanged(int index)
+{
+    if (index < 0 || index == spectrumSettings.window)
+        return;
+
+    applySpectrum();
+}
+/**
+ * @brief 按FFT控件设置频谱参数发送给频谱线程，创建或删除频谱区域
+ *
+ * 频谱区域在最下面，X轴是对数频率：采样序号模式下单位是 周期/采样，时间模式下按平均帧间隔换算成 Hz
+ */
+void MainWindow::applySpectrum()
+{
+    spectrumSettings.window = ui->comboSpectrum->currentIndex();
+    spectrumSettings.size = ui->comboFftSize->currentText().toInt();
+    spectrumSettings.overlap = ui->spinFftOverlap->value();
+    spectrumSettings.averages = ui->spinFftAverage->value();
+    spectrumSettings.firstField = (xAxisMode == X_AXIS_DEVICE_MS || xAxisMode == X_AXIS_DEVICE_US) ? 1 : 0;
+    QMetaObject::invokeMethod (spectrumWorker, "setSettings", Qt::QueuedConnection, Q_ARG(SpectrumSettings, spectrumSettings));
+
+    if (spectrumSettings.window == SPECTRUM_OFF)
+    {
+        if (spectrumRect != nullptr)
+        {
+            /* 先删除曲线，它们使用频谱区域的坐标轴 */
+            for (QCPCurve *curve : spectrumCurves)
+            {
+                if (curve != nullptr)
+                    ui->plot->removePlottable (curve);
+            }
+            spectrumCurves.clear();
+            ui->plot->plotLayout()->remove (spectrumRect);
+            ui->plot->plotLayout()->simplify();
+            spectrumRect = nullptr;
+        }
+        applyWaterfall();
+        ui->plot->replot();
+        return;
+    }
+
+    if (spectrumRect == nullptr)
+    {
+        spectrumRect = new QCPAxisRect (ui->plot);
+        QCPAxis *freqAxis = spectrumRect->axis (QCPAxis::atBottom);
+        QCPAxis *dbAxis = spectrumRect->axis (QCPAxis::atLeft);
+        styleAxis (freqAxis);
+        styleAxis (dbAxis);
+        freqAxis->setScaleType (QCPAxis::stLogarithmic);
+        freqAxis->setTicker (QSharedPointer<QCPAxisTicker> (new QCPAxisTickerLog));
+        freqAxis->setLabelColor (gui_colors[2]);
+        dbAxis->setLabelColor (gui_colors[2]);
+        dbAxis->setLabel ("dB");
+        dbAxis->setRange (SPECTRUM_FLOOR_DB, 0);
+        placeSpectrumRect();
+    }
+    spectrumRect->axis (QCPAxis::atBottom)->setLabel (xAxisMode == X_AXIS_SAMPLES ? "周期/采样" : "Hz");
+    applyWaterfall();
+    ui->plot->replot();
+}
+/**
+ * @brief 显示频谱线程计算的频谱，点数不变时直接改写曲线的数据
+ * @param batch 一个串口的若干通道的平均频谱
+ */
+void MainWindow::onSpectrumReady(SpectrumBatch batch)
+{
+    if (spectrumRect == nullptr || !plotting || batch.port >= openPorts.size())
+        return;
+
+    PortChannels &port = portChannels[openPorts[batch.port].name];
+
+    /* 直流分量在对数轴上没有位置，从第1个频点开始 */
+    double dt = (xAxisMode == X_AXIS_SAMPLES || timeBetweenSamples <= 0) ? 1.0 : timeBetweenSamples;
+    double binWidth = 1.0 / (batch.size * dt);
+    int bins = batch.size / 2;
+
+    for (int s = 0; s < batch.channels.size(); s++)
+    {
+        int channel = batch.channels[s];
+        if (channel >= port.graphs.size())//通道的曲线还没有创建
+            continue;
+        int index = port.graphs[channel];
+
+        if (spectrumCurves.size() <= index)
+            spectrumCurves.resize (index + 1);
+        QCPCurve *curve = spectrumCurves[index];
+        if (curve == nullptr)
+        {
+            curve = new QCPCurve (spectrumRect->axis (QCPAxis::atBottom), spectrumRect->axis (QCPAxis::atLeft));
+            curve->setPen (ui->plot->graph(index)->pen().color());
+            curve->setLayer ("spectrum");
+            curve->removeFromLegend();
+            curve->setSelectable (QCP::stNone);
+            curve->setAdaptiveSampling (true);//高频端很多频点在同一个像素上
+            spectrumCurves[index] = curve;
+        }
+        curve->setVisible (ui->plot->graph(index)->visible());
+
+        const QVector<double> &db = batch.spectra[s];
+
+        /* 瀑布图：新的频谱放到最上面一行，只有这一行需要重新着色 */
+        if (waterfallRect != nullptr && index == ui->spinWaterfall->value())
+        {
+            if (waterfallMap == nullptr)
+            {
+                waterfallMap = new QCPColorMap (waterfallRect->axis (QCPAxis::atBottom), waterfallRect->axis (QCPAxis::atLeft));
+                waterfallMap->setLayer ("spectrum");
+                waterfallMap->removeFromLegend();
+                waterfallMap->setSelectable (QCP::stNone);
+                waterfallMap->setInterpolate (false);
+                waterfallMap->setGradient (QCPColorGradient::gpThermal);
+            }
+            QCPColorMapData *map = waterfallMap->data();
+            if (map->keySize() != db.size())
+            {
+                map->setSize (db.size(), WATERFALL_ROWS);
+                map->fill (SPECTRUM_FLOOR_DB);
+            }
+            map->setRange (QCPRange (0, bins * binWidth), QCPRange (1 - WATERFALL_ROWS, 0));
+            map->pushValueRow (db.constData());
+            waterfallRect->axis (QCPAxis::atBottom)->setRange (0, bins * binWidth);
+        }
+        QSharedPointer<QCPCurveDataContainer> data = curve->data();
+        if (data->size() != bins)
+        {
+            data->clear();
+            for (int k = 1; k <= bins; k++)
+            {
+                data->add (QCPCurveData (k, k * binWidth, db[k]));
+            }
+        }
+        else
+        {
+            int k = 1;
+            for (QCPCurveDataContainer::iterator it = data->begin(); it != data->end(); ++it, ++k)
+            {
+                it->key = k * binWidth;
+                it->value = db[k];
+            }
+        }
+    }
+
+    /* Y轴显示最高的谱峰以下 SPECTRUM_RANGE_DB */
+    bool found = false;
+    double peak = SPECTRUM_FLOOR_DB;
+    for (QCPCurve *curve : spectrumCurves)
+    {
+        bool curveFound = false;
+        if (curve == nullptr || !curve->visible())
+            continue;
+        QCPRange range = curve->getValueRange (curveFound);
+        if (curveFound)
+        {
+            peak = found ? qMax (peak, range.upper) : range.upper;
+            found = true;
+        }
+    }
+    spectrumRect->axis (QCPAxis::atBottom)->setRange (binWidth, bins * binWidth);
+    if (found)
+        spectrumRect->axis (QCPAxis::atLeft)->setRange (peak + SPECTRUM_MARGIN_DB - SPECTRUM_RANGE_DB, peak + SPECTRUM_MARGIN_DB);
+
+    /* 颜色范围按 WATERFALL_STEP_DB 跳变，不变时旧的行不用重新着色 */
+    if (waterfallMap != nullptr && found)
+    {
+        double top = qCeil ((peak + SPECTRUM_MARGIN_DB) / WATERFALL_STEP_DB) * WATERFALL_STEP_DB;
+        waterfallMap->setDataRange (QCPRange (top - SPECTRUM_RANGE_DB, top));
+    }
+}
+/**
+ * @brief 选择显示瀑布图的通道
+ * @param arg1 曲线序号，-1 不显示
+ */
+void MainWindow::on_spinWaterfall_valueChanged(int arg1)
+{
+    Q_UNUSED(arg1)
+    applyWaterfall();
+    ui->plot->replot();
+}
+/**
+ * @brief 按 spinWaterfall 创建或删除瀑布图区域，只在显示频谱时才有瀑布图
+ *
+ * 色图在下一次收到这个通道的频谱时创建，所以换通道时历史数据从头开始。
+ * X轴是线性的频率，QCPColorMap 的格子在对数轴上不是等宽的。
+ */
+void MainWindow::applyWaterfall()
+{
+    if (waterfallMap != nullptr)
+    {
+        ui->plot->removePlottable (waterfallMap);
+        waterfallMap = nullptr;
+    }
+
+    bool show = spectrumRect != nullptr && ui->spinWaterfall->value() >= 0;
+    if (!show)
+    {
+        if (waterfallRect != nullptr)
+        {
+            ui->plot->plotLayout()->remove (waterfallRect);
+            ui->plot->plotLayout()->simplify();
+            waterfallRect = nullptr;
+        }
+        return;
+    }
+
+    if (waterfallRect == nullptr)
+    {
+        waterfallRect = new QCPAxisRect (ui->plot);
+        QCPAxis *freqAxis = waterfallRect->axis (QCPAxis::atBottom);
+        QCPAxis *rowAxis = waterfallRect->axis (QCPAxis::atLeft);
+        styleAxis (freqAxis);
+        styleAxis (rowAxis);
+        freqAxis->setLabelColor (gui_colors[2]);
+        rowAxis->setLabelColor (gui_colors[2]);
+        rowAxis->setLabel ("频谱");
+        rowAxis->setRange (0.5 - WATERFALL_ROWS, 0.5);
+        waterfallRect->setRangeDrag (Qt::Vertical);
+        waterfallRect->setRangeZoom (Qt::Vertical);
+        placeSpectrumRect();
     }
+    waterfallRect->axis (QCPAxis::atBottom)->setLabel (spectrumRect->axis (QCPAxis::atBottom)->label());
 }
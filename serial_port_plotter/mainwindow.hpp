@@ -30,15 +30,62 @@
 #include <QMainWindow>
 #include <QtSerialPort/QtSerialPort>
 #include <QSerialPortInfo>
+#include <QElapsedTimer>
+#include <QLabel>
+#include <QProgressBar>
+#include <QThread>
 #include "helpwindow.hpp"
+#include "hexviewwindow.hpp"
+#include "serialworker.hpp"
+#include "rangetracker.hpp"
+#include "persistencemap.hpp"
+#include "spectrumworker.hpp"
+#include "exportworker.hpp"
 #include "qcustomplot/qcustomplot.h"
 
-#define START_MSG       '@'
-#define END_MSG         '*'
+/* X axis source (index of comboXAxis) */
+#define X_AXIS_SAMPLES      0                                                             // Sample number (v1.0.0 compatible)
+#define X_AXIS_HOST_TIME    1                                                             // Monotonic host clock at read time
+#define X_AXIS_DEVICE_MS    2                                                             // First field of the frame, milliseconds
+#define X_AXIS_DEVICE_US    3                                                             // First field of the frame, microseconds
 
-#define WAIT_START      1
-#define IN_MESSAGE      2
-#define UNDEFINED       3
+/* Plot mode (index of comboFormat) */
+#define DATA_FORMAT_ROLLING 0                                                             // Channels over the X axis (v1.0.0 compatible)
+#define DATA_FORMAT_XY      1                                                             // Channel pairs (0,1), (2,3)... as X-Y curves
+
+/* Channel grouping (index of comboLayout) */
+#define LAYOUT_OVERLAY      0                                                             // All channels in one axis rect
+#define LAYOUT_PER_PORT     1                                                             // One stacked axis rect per serial port
+#define LAYOUT_PER_CHANNEL  2                                                             // One stacked axis rect per channel
+
+/* Continuous Y auto range (index of comboAutoY) */
+#define AUTO_Y_OFF          0                                                             // Y range from spinAxesMin / spinAxesMax
+#define AUTO_Y_ALL          1                                                             // Range of all received data
+#define AUTO_Y_WINDOW       2                                                             // Range of the data inside the visible X range
+#define AUTO_Y_MARGIN       0.05                                                          // Empty space above / below the data
+
+/* Persistence display (index of comboPersist) */
+#define PERSIST_OFF         0                                                             // Plain lines
+#define PERSIST_SHORT       1                                                             // Hits fade with a PERSIST_SHORT_S half life
+#define PERSIST_LONG        2                                                             // Hits fade with a PERSIST_LONG_S half life
+#define PERSIST_INFINITE    3                                                             // Hits never fade
+#define PERSIST_SHORT_S     0.2
+#define PERSIST_LONG_S      2.0
+
+/* Spectrum view (comboSpectrum selects the window, see SPECTRUM_*) */
+#define SPECTRUM_RANGE_DB   120.0                                                         // Shown below the highest peak
+#define SPECTRUM_MARGIN_DB  10.0                                                          // Shown above the highest peak
+#define WATERFALL_ROWS      2000                                                          // Spectra kept in the waterfall
+#define WATERFALL_STEP_DB   10.0                                                          // Color range moves in steps, each move recolors the whole map
+
+/* Automatic screenshots (index of comboCapture) */
+#define CAPTURE_OFF         0                                                             // Only the save buttons
+#define CAPTURE_TIMER       1                                                             // Every spinCaptureInterval seconds
+#define CAPTURE_LEVEL       2                                                             // Graph spinCaptureChannel rises through spinCaptureLevel
+#define CAPTURE_QUEUE_MAX   4                                                             // Pending exports, further automatic screenshots are dropped
+
+#define TIMING_EMA_ALPHA    0.05                                                          // Smoothing of the frame interval / jitter
+#define PORT_STATS_MS       1000                                                          // Throughput counters refresh period
 
 #define CUSTOM_LINE_COLORS   15
 #define GCP_CUSTOM_LINE_COLORS 4
@@ -47,6 +94,61 @@ namespace Ui {
     class MainWindow;
 }
 
+/* Frame interval / jitter statistics of one port */
+struct FrameTiming
+{
+    double interval = 0;                                                                  // Smoothed interval between frames (seconds)
+    double jitter = 0;                                                                    // Smoothed |interval - mean interval| (seconds)
+    double jitterPeak = 0;                                                                // Largest interval deviation seen (seconds)
+    double lastKey = 0;                                                                   // X value of the newest frame
+    int frames = 0;                                                                       // Frames that went into the statistics
+    bool gap = false;                                                                     // Frames before the next one were dropped (triggered sweeps)
+
+    void update (double key)
+    {
+        if (gap)
+        {
+            gap = false;
+        }
+        else if (frames == 1)
+        {
+            interval = key - lastKey;
+        }
+        else if (frames > 1)
+        {
+            double deviation = qAbs (key - lastKey - interval);
+            jitter += (deviation - jitter) * TIMING_EMA_ALPHA;
+            jitterPeak = qMax (jitterPeak, deviation);
+            interval += (key - lastKey - interval) * TIMING_EMA_ALPHA;
+        }
+        lastKey = key;
+        frames++;
+    }
+};
+
+/* Graphs of one serial port, kept across reconnects until the plot is cleared */
+struct PortChannels
+{
+    QVector<int> graphs;                                                                  // Graph index of each channel of the port
+    QVector<QCPCurve*> curves;                                                            // X-Y curve of each channel pair (DATA_FORMAT_XY)
+    int samples = 0;                                                                      // Frames plotted (X value in sample mode)
+    bool haveDeviceOffset = false;
+    double deviceOffset = 0;                                                              // Device clock -> shared host clock
+    FrameTiming timing;
+};
+
+/* An open serial port and its acquisition thread */
+struct OpenPort
+{
+    QString name;
+    QThread *thread = nullptr;
+    SerialWorker *worker = nullptr;
+    quint64 lastBytes = 0;
+    quint64 lastFrames = 0;
+    double byteRate = 0;                                                                  // Bytes per second
+    double frameRate = 0;                                                                 // Frames per second
+};
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -61,13 +163,16 @@ private slots:
     void portOpenedFail();                                                                // Called when port fails to open
     void onPortClosed();                                                                  // Called when closing the port
     void replot();                                                                        // Slot for repainting the plot
-    void onNewDataArrived(QStringList newData);                                           // Slot for new data from serial port
-    void saveStream(QStringList newData);                                                 // Save the received data to the opened file
+    void onNewDataArrived(SerialBatch batch);                                             // Slot for new data from serial ports
+    void saveStream(SerialBatch batch);                                                   // Save the received data to the opened file
     void on_spinAxesMin_valueChanged(int arg1);                                           // Changing lower limit for the plot
     void on_spinAxesMax_valueChanged(int arg1);                                           // Changing upper limit for the plot
-    void readData();                                                                      // Slot for inside serial port
     void on_spinYStep_valueChanged(int arg1);                                             // Spin box for changing Y axis tick step
-    void on_savePNGButton_clicked();                                                      // Button for saving JPG
+    void on_savePNGButton_clicked();                                                      // Button for saving PNG
+    void on_savePDFButton_clicked();                                                      // Button for saving PDF
+    void on_saveSVGButton_clicked();                                                      // Button for saving SVG
+    void onExportProgress(QString fileName, int percent);                                 // Progress of the export in exportThread
+    void onExportFinished(QString fileName, bool success);                                // Export written (or failed)
     void onMouseMoveInPlot (QMouseEvent *event);                                          // Displays coordinates of mouse pointer when clicked in plot in status bar
     void on_spinPoints_valueChanged (int arg1);                                           // Spin box controls how many data points are collected and displayed
     void on_mouse_wheel_in_plot (QWheelEvent *event);                                     // Makes wheel mouse works while plotting
@@ -82,6 +187,8 @@ private slots:
     void on_actionPause_Plot_triggered();
     void on_actionClear_triggered();
     void on_actionRecord_stream_triggered();
+    void on_actionHex_view_triggered();
+    void onHexCaptureEnabled (bool enable);                                               // Hex view shown / hidden
 
     void on_pushButton_TextEditHide_clicked();
 
@@ -95,11 +202,31 @@ private slots:
 
     void on_pushButton_clicked();
 
+    void on_comboXAxis_currentIndexChanged(int index);
+
+    void on_comboLayout_currentIndexChanged(int index);
+
+    void on_comboFormat_currentIndexChanged(int index);
+
+    void on_comboAutoY_currentIndexChanged(int index);
+    void on_comboPersist_currentIndexChanged(int index);
+    void on_comboTrigger_currentIndexChanged(int index);
+    void applyTrigger();                                                                  // Send the trigger controls to every SerialWorker
+    void on_lineDerived_editingFinished();                                                // Compile the derived channel expressions
+    void on_lineFilter_editingFinished();                                                 // Parse the filter chain
+    void on_comboFilterView_currentIndexChanged(int index);                               // Filtered channels only, or raw and filtered
+    void on_comboSpectrum_currentIndexChanged(int index);
+    void applySpectrum();                                                                 // Send the FFT controls to the SpectrumWorker
+    void onSpectrumReady(SpectrumBatch batch);                                            // Slot for new spectra from the SpectrumWorker
+    void on_spinWaterfall_valueChanged(int arg1);
+    void on_comboCapture_currentIndexChanged(int index);
+    void applyCapture();                                                                  // Read the automatic screenshot controls
+    void onCaptureTimer();                                                                // CAPTURE_TIMER period elapsed
+
 signals:
     void portOpenFail();                                                                  // Emitted when cannot open port
     void portOpenOK();                                                                    // Emitted when port is open
     void portClosed();                                                                    // Emitted when port is closed
-    void newData(QStringList data);                                                       // Emitted when new data has arrived
 
 private:
     Ui::MainWindow *ui;
@@ -116,7 +243,7 @@ private:
     int channels;
 
     /* Data format */
-    int data_format;   
+    int data_format;                                                                      // DATA_FORMAT_*
 
     /* Textbox Related */
     bool filterDisplayedData = true;
@@ -131,18 +258,105 @@ private:
     void closeCsvFile(void);
 
     QTimer updateTimer;                                                                   // Timer used for replotting the plot
-    QTime timeOfFirstData;                                                                // Record the time of the first data point
-    double timeBetweenSamples;                                                            // Store time between samples
-    QSerialPort *serialPort;                                                              // Serial port; runs in this thread
-    QString receivedData;                                                                 // Used for reading from the port
-    int STATE;                                                                            // State of recieiving message from port
+    QElapsedTimer timeOfFirstData;                                                        // Monotonic clock shared by all ports, started at the first connect
+    double timeBetweenSamples;                                                            // Frame interval used to size the time window (seconds)
+    double lastFrameKey;                                                                  // X value of the newest frame of all ports
+    int xAxisMode;                                                                        // X_AXIS_*
+    QLabel *timingLabel;                                                                  // Throughput / interval / jitter in the status bar
+    QElapsedTimer portStatsTimer;                                                         // Period of the throughput counters
     HelpWindow *helpWindow;
 
+    /* Serial ports, each one read and parsed in its own thread */
+    QVector<OpenPort> openPorts;
+    int portSession = 0;                                                                  // Incremented by closePorts(), batches of older sessions are dropped
+    QHash<QString, PortChannels> portChannels;
+    QVector<QCPCurve*> xyCurves;                                                          // X-Y curves of all ports, same index as listWidget_Channels
+
+    /* Stacked axis rects, one per channel group, below ui->plot->axisRect(0) */
+    int plotLayoutMode = LAYOUT_OVERLAY;                                                  // LAYOUT_*
+    QVector<QCPAxisRect*> stackedRects;
+    QCPMarginGroup *marginGroup = nullptr;                                                // Aligns the left/right margins of the stacked rects
+
+    /* Incremental min/max of every graph, same index as ui->plot->graph() */
+    int autoYMode = AUTO_Y_OFF;                                                           // AUTO_Y_*
+    QVector<RangeTracker> valueTrackers;
+
+    /* Persistence display of the graphs in the main axis rect (overlay layout only) */
+    int persistMode = PERSIST_OFF;                                                        // PERSIST_*
+    QCPColorMap *persistColorMap = nullptr;                                               // Shown on layer "persistence", replaces layer "main"
+    PersistenceMap persistence;
+
+    /* Triggered sweeps, detected in the SerialWorker threads */
+    TriggerSettings triggerSettings;
+
+    /* Derived channels, evaluated in the SerialWorker threads and appended after the fields of every frame */
+    DerivedChannels derivedChannels;
+
+    /* Filter chain, runs in the SerialWorker threads before the derived channels */
+    FilterSettings filterSettings;
+
+    /* Spectrum view, the FFTs run in spectrumThread */
+    QThread *spectrumThread = nullptr;
+    SpectrumWorker *spectrumWorker = nullptr;
+    SpectrumSettings spectrumSettings;
+    QCPAxisRect *spectrumRect = nullptr;                                                  // Bottom row of the plot layout while the spectrum is shown
+    QVector<QCPCurve*> spectrumCurves;                                                    // Same index as ui->plot->graph(), nullptr before the first spectrum
+    QCPAxisRect *waterfallRect = nullptr;                                                 // Below spectrumRect while spinWaterfall selects a channel
+    QCPColorMap *waterfallMap = nullptr;                                                  // Value rows are a ring buffer, newest spectrum on top
+
+    /* PNG / PDF export, rendered and encoded in exportThread */
+    QThread *exportThread = nullptr;
+    ExportWorker *exportWorker = nullptr;
+    QProgressBar *exportProgressBar = nullptr;                                            // Status bar, visible while exports are pending
+    int pendingExports = 0;                                                               // Jobs sent to exportWorker and not finished yet
+
+    /* Automatic screenshots, taken after the replot that shows the event */
+    int captureMode = CAPTURE_OFF;                                                        // CAPTURE_*
+    int captureChannel = 0;                                                               // Row of listWidget_Channels watched by CAPTURE_LEVEL (Y of a curve in X-Y mode)
+    double captureLevel = 0;
+    bool captureArmed = false;                                                            // CAPTURE_LEVEL: the value was below the level
+    bool capturePending = false;                                                          // Take a screenshot after the next replot
+    int droppedCaptures = 0;                                                              // Screenshots skipped because the export queue was full
+    QTimer captureTimer;
+    QElapsedTimer lastCapture;                                                            // Hold off between CAPTURE_LEVEL screenshots
+
+    /* Raw byte inspector */
+    HexViewWindow *hexViewWindow = nullptr;
+    bool hexCaptureEnabled = false;                                                       // Workers copy into their hex ring only while the view is visible
+
     void createUI();                                                                      // Populate the controls
     void enable_com_controls (bool enable);                                               // Enable/disable controls
     void setupPlot();                                                                     // Setup the QCustomPlot
-                                                                                          // Open the inside serial port with these parameters
-    void openPort(QSerialPortInfo portInfo, int baudRate, QSerialPort::DataBits dataBits, QSerialPort::Parity parity, QSerialPort::StopBits stopBits);
+    void styleAxis(QCPAxis *axis);                                                        // Colors / pens / font of an axis
+    QVector<QVector<int> > channelGroups();                                               // Graph indexes of each group for plotLayoutMode
+    void applyPlotLayout();                                                               // Move the graphs into stacked axis rects
+    void placeSpectrumRect();                                                             // Move spectrumRect and waterfallRect below the other axis rects
+    void applyWaterfall();                                                                // Create / remove waterfallRect for spectrumRect and spinWaterfall
+    void updateXRange();                                                                  // Follow the newest data on the X axis
+    bool graphValueRange(int index, int mode, const QCPRange &keyRange, QCPRange *range); // Value range of a graph from its RangeTracker
+    void applyAutoY();                                                                    // Continuous Y auto range, every replot
+    bool curvesRange(bool keys, QCPRange *range);                                         // Key or value range of the X-Y curves, with margin
+    void applyPersistence();                                                              // Create / remove the persistence color map for persistMode
+    void updatePersistence();                                                             // Rasterize the new samples, every replot
+    double frameKey(const SerialFrame &frame, PortChannels &port, int *firstChannel);    // X value of a frame for the current X axis mode
+    void applyPersistedGraphs();                                                          // Graphs replaced by the persistence map go to the hidden "persisted" layer
+    void addChannel(PortChannels &port, const QString &portName, const QString &label = QString()); // New graph for the next channel of a port
+    QString channelLabel(int channelCount, int channel) const;                            // Name of a derived or filtered channel, empty for message fields
+    void applyDerived();                                                                  // Send the derived channels to every SerialWorker
+    void applyFilters();                                                                  // Send the filter chain to every SerialWorker
+    void exportPlot(const QString &fileName, int format);                                 // Record the plot and queue it for exportWorker
+    void checkCaptureLevel(double value);                                                 // CAPTURE_LEVEL crossing test for a new sample of captureChannel
+    void takeCapture();                                                                   // Timestamped PNG, unless the export queue is full
+    void addCurve(PortChannels &port, const QString &portName);                           // New X-Y curve for the next channel pair of a port
+    QCPAbstractPlottable *listPlottable(int row) const;                                   // Graph or X-Y curve shown by a row of listWidget_Channels
+    void plotSweep(const SerialBatch &batch, PortChannels &port, const QString &portName);// Replace the graphs of a port with a triggered sweep
+    void resetFrameTiming();
+    void updatePortStats();                                                               // Throughput counters in the status bar
+    void updateHexSources();                                                              // Open ports selectable in the hex view
+    void fillPortLists();                                                                 // Available ports into comboPort / listWidget_Ports
+                                                                                          // Open a serial port with these parameters in its own thread
+    bool openPort(QSerialPortInfo portInfo, int baudRate, QSerialPort::DataBits dataBits, QSerialPort::Parity parity, QSerialPort::StopBits stopBits);
+    void closePorts();                                                                    // Stop all acquisition threads
 };
 
 
@@ -0,0 +1,318 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#include "persistencemap.hpp"
+#include <cmath>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief 把一批采样换算成扫描列号和行号
+ *
+ * 先限制在 [-1, 上限] 内再加 1 截断，这样截断等于向下取整，超出范围的值也不会溢出 int。
+ * 行号 -1 和 rows 表示超出了显示范围。
+ */
+static void mapToCells (const double *keys, const double *values, int n, double keyOrigin, double keyScale,
+                        double valueOrigin, double valueScale, int rows, int *phases, int *rowIndexes)
+{
+    const double maxPhase = double(1 << 30);
+    int i = 0;
+#ifdef __SSE2__
+    const __m128d lower = _mm_set1_pd (-1.0);
+    const __m128d one = _mm_set1_pd (1.0);
+    const __m128d kOrigin = _mm_set1_pd (keyOrigin);
+    const __m128d kScale = _mm_set1_pd (keyScale);
+    const __m128d kUpper = _mm_set1_pd (maxPhase);
+    const __m128d vOrigin = _mm_set1_pd (valueOrigin);
+    const __m128d vScale = _mm_set1_pd (valueScale);
+    const __m128d vUpper = _mm_set1_pd (rows);
+    const __m128i ones = _mm_set1_epi32 (1);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128d k0 = _mm_mul_pd (_mm_sub_pd (_mm_loadu_pd (keys + i), kOrigin), kScale);
+        __m128d k1 = _mm_mul_pd (_mm_sub_pd (_mm_loadu_pd (keys + i + 2), kOrigin), kScale);
+        k0 = _mm_add_pd (_mm_min_pd (_mm_max_pd (k0, lower), kUpper), one);
+        k1 = _mm_add_pd (_mm_min_pd (_mm_max_pd (k1, lower), kUpper), one);
+        __m128i p = _mm_unpacklo_epi64 (_mm_cvttpd_epi32 (k0), _mm_cvttpd_epi32 (k1));
+        _mm_storeu_si128 (reinterpret_cast<__m128i*>(phases + i), _mm_sub_epi32 (p, ones));
+
+        __m128d v0 = _mm_mul_pd (_mm_sub_pd (_mm_loadu_pd (values + i), vOrigin), vScale);
+        __m128d v1 = _mm_mul_pd (_mm_sub_pd (_mm_loadu_pd (values + i + 2), vOrigin), vScale);
+        v0 = _mm_add_pd (_mm_min_pd (_mm_max_pd (v0, lower), vUpper), one);
+        v1 = _mm_add_pd (_mm_min_pd (_mm_max_pd (v1, lower), vUpper), one);
+        __m128i r = _mm_unpacklo_epi64 (_mm_cvttpd_epi32 (v0), _mm_cvttpd_epi32 (v1));
+        _mm_storeu_si128 (reinterpret_cast<__m128i*>(rowIndexes + i), _mm_sub_epi32 (r, ones));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        phases[i] = int(qBound (-1.0, (keys[i] - keyOrigin) * keyScale, maxPhase) + 1.0) - 1;
+        rowIndexes[i] = int(qBound (-1.0, (values[i] - valueOrigin) * valueScale, double(rows)) + 1.0) - 1;
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 所有单元格乘以衰减系数，不低于 PERSIST_FLOOR
+ * @return 衰减后最大的单元格
+ */
+static double decayCells (double *cells, int count, double factor)
+{
+    double maxHits = 0;
+    int i = 0;
+#ifdef __SSE2__
+    const __m128d f = _mm_set1_pd (factor);
+    const __m128d floor = _mm_set1_pd (PERSIST_FLOOR);
+    __m128d max0 = _mm_setzero_pd();
+    __m128d max1 = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128d c0 = _mm_max_pd (_mm_mul_pd (_mm_loadu_pd (cells + i), f), floor);
+        __m128d c1 = _mm_max_pd (_mm_mul_pd (_mm_loadu_pd (cells + i + 2), f), floor);
+        _mm_storeu_pd (cells + i, c0);
+        _mm_storeu_pd (cells + i + 2, c1);
+        max0 = _mm_max_pd (max0, c0);
+        max1 = _mm_max_pd (max1, c1);
+    }
+    max0 = _mm_max_pd (max0, max1);
+    max0 = _mm_max_sd (max0, _mm_unpackhi_pd (max0, max0));
+    maxHits = _mm_cvtsd_f64 (max0);
+#endif
+    for (; i < count; i++)
+    {
+        double c = qMax (cells[i] * factor, PERSIST_FLOOR);
+        cells[i] = c;
+        if (c > maxHits)
+            maxHits = c;
+    }
+    return maxHits;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Constructor
+ */
+PersistenceMap::PersistenceMap()
+{
+    m_decayTimer.start();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 设置显示用的色图，下一次 update() 时重新开始累计
+ * @param map 色图，nullptr 表示不再显示
+ */
+void PersistenceMap::setColorMap (QCPColorMap *map)
+{
+    m_map = map;
+    m_columns = 0;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 设置余辉的半衰期
+ * @param seconds 秒，<= 0 时不衰减
+ */
+void PersistenceMap::setHalfLife (double seconds)
+{
+    m_halfLife = seconds;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 丢掉累计的结果和还没有绘制的采样
+ */
+void PersistenceMap::clear()
+{
+    m_channels.clear();
+    m_columns = 0;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 网格大小改变，或者坐标范围变化超过 PERSIST_RESET_RATIO 时，以前的累计结果不再有意义
+ */
+bool PersistenceMap::needsReset (const QCPRange &keyRange, const QCPRange &valueRange, int columns, int rows) const
+{
+    if (columns != m_columns || rows != m_rows)
+        return true;
+    if (qAbs (keyRange.size() - m_sweepSpan) > m_sweepSpan * PERSIST_RESET_RATIO)
+        return true;
+    double tolerance = m_valueRange.size() * PERSIST_RESET_RATIO;
+    return qAbs (valueRange.lower - m_valueRange.lower) > tolerance || qAbs (valueRange.upper - m_valueRange.upper) > tolerance;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 按新的网格和坐标范围重新开始累计
+ */
+void PersistenceMap::reset (const QCPRange &keyRange, const QCPRange &valueRange, int columns, int rows)
+{
+    m_columns = columns;
+    m_rows = rows;
+    m_sweepOrigin = keyRange.lower;
+    m_sweepSpan = keyRange.size();
+    m_valueRange = valueRange;
+    m_maxHits = 0;
+    m_decayTimer.restart();
+
+    m_map->data()->setSize (columns, rows);
+    m_map->data()->fill (PERSIST_FLOOR);
+
+    for (Channel &channel : m_channels)
+    {
+        channel.phase = -1;
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 每次刷新绘图区前调用：衰减，绘制新的采样，更新色图的位置和颜色范围
+ * @param keyRange X轴可见范围，一次扫描的宽度
+ * @param valueRange Y轴可见范围
+ * @param columns 一次扫描的列数
+ * @param rows 行数
+ */
+void PersistenceMap::update (const QCPRange &keyRange, const QCPRange &valueRange, int columns, int rows)
+{
+    if (m_map == nullptr || columns < 2 || rows < 2 || keyRange.size() <= 0 || valueRange.size() <= 0)
+    {
+        for (Channel &channel : m_channels)//不能显示时也不要积攒采样
+        {
+            channel.keys.resize (0);
+            channel.values.resize (0);
+            channel.phase = -1;
+        }
+        return;
+    }
+
+    if (needsReset (keyRange, valueRange, columns, rows))
+        reset (keyRange, valueRange, columns, rows);
+
+    /* 折叠的起点按整列跟着X轴的左边界移动，色图的范围使用同一个起点，直方图和X轴对齐 */
+    double *cells = m_map->data()->cellData();
+    double columnWidth = m_sweepSpan / m_columns;
+    double shift = std::floor ((keyRange.lower - m_sweepOrigin) / columnWidth);
+    if (shift != 0)
+    {
+        m_sweepOrigin += shift * columnWidth;
+        rotateColumns (cells, int(std::fmod (std::fmod (shift, m_columns) + m_columns, m_columns)));
+        for (Channel &channel : m_channels)
+        {
+            double phase = channel.phase - shift;
+            channel.phase = channel.phase >= 0 && phase >= 0 ? int(phase) : -1;
+        }
+    }
+
+    double elapsed = m_decayTimer.nsecsElapsed() * 1e-9;
+    m_decayTimer.restart();
+    if (m_halfLife > 0 && elapsed > 0)
+        m_maxHits = decayCells (cells, m_columns * m_rows, std::pow (0.5, elapsed / m_halfLife));
+
+    for (Channel &channel : m_channels)
+    {
+        rasterize (channel, cells);
+    }
+
+    /* 单元格的中心对齐到坐标，一次扫描铺满X轴的可见范围 */
+    double halfColumn = 0.5 * columnWidth;
+    double halfRow = 0.5 * m_valueRange.size() / m_rows;
+    m_map->data()->setRange (QCPRange (m_sweepOrigin + halfColumn, m_sweepOrigin + m_sweepSpan - halfColumn),
+                             QCPRange (m_valueRange.lower + halfRow, m_valueRange.upper - halfRow));
+    m_map->setDataRange (QCPRange (PERSIST_MIN_HITS, qMax (m_maxHits, 2 * PERSIST_MIN_HITS)));
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 折叠起点向右移动 shift 列后，每一行的单元格向左循环移动 shift 列
+ */
+void PersistenceMap::rotateColumns (double *cells, int shift)
+{
+    if (shift == 0)
+        return;
+    for (int row = 0; row < m_rows; row++)
+    {
+        double *line = cells + row * m_columns;
+        std::rotate (line, line + shift, line + m_columns);
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 把一个通道新的采样累加到直方图中
+ *
+ * 同一列或相邻两列的连续采样之间连一条竖线，和示波器的矢量显示一样，
+ * 快速变化的信号也是连续的。
+ */
+void PersistenceMap::rasterize (Channel &channel, double *cells)
+{
+    const int n = channel.keys.size();
+    if (n == 0)
+        return;
+
+    m_phaseScratch.resize (n);
+    m_rowScratch.resize (n);
+    mapToCells (channel.keys.constData(), channel.values.constData(), n, m_sweepOrigin, m_columns / m_sweepSpan,
+                m_valueRange.lower, m_rows / m_valueRange.size(), m_rows, m_phaseScratch.data(), m_rowScratch.data());
+    channel.keys.resize (0);
+    channel.values.resize (0);
+
+    const int *phases = m_phaseScratch.constData();
+    const int *rowIndexes = m_rowScratch.constData();
+    for (int i = 0; i < n; i++)
+    {
+        int phase = phases[i];
+        int row = rowIndexes[i];
+        if (phase < 0)//在扫描起点之前，已经不在屏幕上
+        {
+            channel.phase = -1;
+            continue;
+        }
+
+        int from = row;
+        int step = phase - channel.phase;
+        if (channel.phase >= 0 && (step == 0 || step == 1) && channel.row != row)
+        {
+            from = channel.row;
+            if (step == 0)//同一列中上一个采样的单元格已经累加过了
+                from += row > from ? 1 : -1;
+        }
+        channel.phase = phase;
+        channel.row = row;
+
+        int low = qMax (qMin (from, row), 0);
+        int high = qMin (qMax (from, row), m_rows - 1);
+        double *cell = cells + low * m_columns + phase % m_columns;
+        for (int r = low; r <= high; r++, cell += m_columns)
+        {
+            *cell += 1.0;
+            if (*cell > m_maxHits)
+                m_maxHits = *cell;
+        }
+    }
+}
@@ -0,0 +1,98 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#ifndef PERSISTENCEMAP_HPP
+#define PERSISTENCEMAP_HPP
+
+#include <QVector>
+#include <QElapsedTimer>
+#include "qcustomplot/qcustomplot.h"
+
+#define PERSIST_FLOOR       1e-3                                                          // Empty cells, keeps the logarithmic color scale finite
+#define PERSIST_MIN_HITS    0.5                                                           // Hit count at the transparent end of the gradient
+#define PERSIST_RESET_RATIO 0.1                                                           // Axis range change that starts a new histogram
+
+/**
+ * Oscilloscope style persistence display. Samples are folded into sweeps of
+ * one screen width and accumulated as hit counts per cell, the counts decay
+ * with a half life and are shown with a QCPColorMap. The fold starts at the
+ * left edge of the X axis (in whole columns), so a rolling view shifts the
+ * cells instead of the map.
+ *
+ * Only the samples queued since the last update() are rasterized, so the
+ * cost per frame is the number of new samples plus one pass over the cells.
+ */
+class PersistenceMap
+{
+public:
+    PersistenceMap();
+
+    void setColorMap (QCPColorMap *map);                                                  // Color map that shows the histogram, nullptr to detach
+    void setHalfLife (double seconds);                                                    // Decay half life, <= 0 keeps the hits forever
+    void clear();                                                                         // Drop the histogram and the queued samples
+
+    void addSample (int channel, double key, double value)                                // Queue a sample for the next update(), non-finite samples are dropped
+    {
+        if (!qIsFinite (key) || !qIsFinite (value))//NaN 在 SSE2 和标量换算中得到的行号不同，在换算前丢掉
+            return;
+        if (channel >= m_channels.size())
+            m_channels.resize (channel + 1);
+        m_channels[channel].keys.append (key);
+        m_channels[channel].values.append (value);
+    }
+                                                                                          // Decay, rasterize the queued samples and update the color map
+    void update (const QCPRange &keyRange, const QCPRange &valueRange, int columns, int rows);
+
+private:
+    struct Channel
+    {
+        QVector<double> keys;                                                             // Samples queued since the last update
+        QVector<double> values;
+        int phase = -1;                                                                   // Sweep column of the last rasterized sample, -1 before the first one
+        int row = 0;                                                                      // Row of the last rasterized sample
+    };
+
+    QCPColorMap *m_map = nullptr;
+    QVector<Channel> m_channels;
+    QVector<int> m_phaseScratch;
+    QVector<int> m_rowScratch;
+    double m_halfLife = 0;
+    QElapsedTimer m_decayTimer;
+
+    int m_columns = 0;
+    int m_rows = 0;
+    double m_sweepOrigin = 0;                                                             // Key of column 0, follows the X axis in whole columns
+    double m_sweepSpan = 0;                                                               // Keys per sweep
+    QCPRange m_valueRange;                                                                // Values covered by the rows
+    double m_maxHits = 0;
+
+    bool needsReset (const QCPRange &keyRange, const QCPRange &valueRange, int columns, int rows) const;
+    void reset (const QCPRange &keyRange, const QCPRange &valueRange, int columns, int rows);
+    void rotateColumns (double *cells, int shift);
+    void rasterize (Channel &channel, double *cells);
+};
+
+#endif // PERSISTENCEMAP_HPP
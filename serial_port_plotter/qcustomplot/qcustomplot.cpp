@@ -24,6 +24,10 @@
 ****************************************************************************/
 
 #include "qcustomplot.h"
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
 
 
 /* including file 'src/vector2d.cpp', size 7340                              */
@@ -474,6 +478,233 @@ void QCPPainter::makeNonCosmetic()
     QPainter::setPen(p);
   }
 }
+
+/*!
+  Draws the polyline through \a points with the current pen by writing the pixels directly into
+  the QImage this painter is painting on, instead of going through QPainter::drawPolyline. NaN
+  and infinite points create gaps in the line, like in \ref
+  QCPAbstractPlottable1D::drawPolyline.
+
+  This is only possible for what the raster engine would draw as a one pixel wide aliased line:
+  no antialiasing, no export modes, an opaque solid pen with width of at most one pixel, at most
+  a translating transformation, source-over composition, full opacity and a rectangular clip
+  region, on a 32 bit QImage with device pixel ratio one. If any of these conditions isn't met,
+  nothing is drawn and false is returned, so the caller can fall back to regular QPainter drawing.
+
+  The line segments are drawn as horizontal or vertical pixel spans (see \ref rasterLine). Points
+  are rounded like \ref drawLine does when antialiasing is disabled. The pixels of a line don't
+  depend on the clip rect, so drawing the same lines in horizontal strips with different clip
+  rects gives exactly the same result (see \ref QCPLayer::drawParallel).
+*/
+bool QCPPainter::drawPolylineRaster(const QVector<QPointF> &points)
+{
+  if (antialiasing() || mModes.testFlag(pmVectorized) || mModes.testFlag(pmNoCaching))
+    return false;
+  QPaintDevice *dev = device();
+  if (!dev || dev->devType() != QInternal::Image)
+    return false;
+  QImage *image = static_cast<QImage*>(dev);
+  if (image->format() != QImage::Format_ARGB32_Premultiplied && image->format() != QImage::Format_ARGB32 && image->format() != QImage::Format_RGB32)
+    return false;
+  if (!image->isDetached()) // bits() would detach, and the paint engine would keep drawing into the old data
+    return false;
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+  if (!qFuzzyCompare(image->devicePixelRatio(), 1.0))
+    return false;
+#endif
+  const QPen &p = pen();
+  if (p.style() != Qt::SolidLine || p.brush().style() != Qt::SolidPattern || p.color().alpha() != 255 || p.widthF() > 1.0)
+    return false;
+  if (transform().type() > QTransform::TxTranslate || compositionMode() != QPainter::CompositionMode_SourceOver || opacity() < 1.0)
+    return false;
+  
+  const int dx = qRound(transform().dx());
+  const int dy = qRound(transform().dy());
+  if (transform().dx() != dx || transform().dy() != dy) // only whole pixel translations keep the rounding of the points
+    return false;
+  
+  // clip rect in device pixels:
+  QRect clip = image->rect();
+  if (hasClipping())
+  {
+    const QRegion region = clipRegion();
+    if (region.rectCount() > 1)
+      return false;
+    clip &= region.boundingRect().translated(dx, dy);
+  }
+  if (clip.isEmpty())
+    return true;
+  
+  const QRgb color = p.color().rgba(); // opaque, so premultiplied and not premultiplied are the same
+  uchar *bits = image->bits();
+  const int bytesPerLine = image->bytesPerLine();
+  const double maxCoord = 1<<20; // lines are clipped to this fixed range only to prevent integer overflows, rasterLine skips what's outside of clip
+  const QRectF coordRange(-maxCoord, -maxCoord, 2*maxCoord, 2*maxCoord);
+  
+  int i = 0;
+  bool lastIsInvalid = true;
+  const int pointCount = points.size();
+  for (; i < pointCount; ++i)
+  {
+    const QPointF &point = points.at(i);
+    if (qIsNaN(point.x()) || qIsNaN(point.y()) || qIsInf(point.x()) || qIsInf(point.y())) // NaNs create a gap in the line
+    {
+      lastIsInvalid = true;
+      continue;
+    }
+    if (!lastIsInvalid)
+    {
+      QPointF p1 = points.at(i-1);
+      QPointF p2 = point;
+      if (clipRasterLine(p1, p2, coordRange))
+        rasterLine(bits, bytesPerLine, clip, color, qRound(p1.x())+dx, qRound(p1.y())+dy, qRound(p2.x())+dx, qRound(p2.y())+dy);
+    }
+    lastIsInvalid = false;
+  }
+  return true;
+}
+
+/*! \internal
+
+  Clips the line from \a p1 to \a p2 to \a rect (Liang-Barsky). Returns false if no part of the
+  line is inside \a rect. Otherwise \a p1 and \a p2 are moved onto the border of \a rect where
+  necessary.
+*/
+bool QCPPainter::clipRasterLine(QPointF &p1, QPointF &p2, const QRectF &rect)
+{
+  const double dx = p2.x()-p1.x();
+  const double dy = p2.y()-p1.y();
+  const double p[4] = {-dx, dx, -dy, dy};
+  const double q[4] = {p1.x()-rect.left(), rect.right()-p1.x(), p1.y()-rect.top(), rect.bottom()-p1.y()};
+  double t1 = 0;
+  double t2 = 1;
+  for (int i=0; i<4; ++i)
+  {
+    if (p[i] == 0)
+    {
+      if (q[i] < 0)
+        return false;
+    } else
+    {
+      const double t = q[i]/p[i];
+      if (p[i] < 0)
+      {
+        if (t > t2) return false;
+        if (t > t1) t1 = t;
+      } else
+      {
+        if (t < t1) return false;
+        if (t < t2) t2 = t;
+      }
+    }
+  }
+  const QPointF start = p1;
+  if (t2 < 1)
+    p2 = QPointF(start.x()+t2*dx, start.y()+t2*dy);
+  if (t1 > 0)
+    p1 = QPointF(start.x()+t1*dx, start.y()+t1*dy);
+  return true;
+}
+
+/*! \internal
+
+  Draws a one pixel wide line from (\a x1, \a y1) to (\a x2, \a y2) with Bresenham's algorithm
+  into the 32 bit image memory at \a bits. Pixels outside of \a clip are skipped.
+
+  Instead of setting single pixels, the pixels of a mostly horizontal line are grouped into
+  horizontal runs per scan line, and those of a mostly vertical line into vertical runs per pixel
+  column. Dense data (many steep segments in few pixel columns, typical for signal plots) thus
+  reduces to a few vertical min/max spans per column.
+
+  The Bresenham state at the first pixel inside \a clip is calculated directly, so the cost only
+  depends on the part of the line inside \a clip, and the pixels are the same as if the whole line
+  was drawn and then clipped.
+*/
+void QCPPainter::rasterLine(uchar *bits, int bytesPerLine, const QRect &clip, QRgb color, int x1, int y1, int x2, int y2)
+{
+  const int clipLeft = clip.left(), clipRight = clip.right(), clipTop = clip.top(), clipBottom = clip.bottom();
+  if (qAbs(x2-x1) >= qAbs(y2-y1)) // mostly horizontal, draw runs of pixels on the same scan line
+  {
+    if (x1 > x2)
+    {
+      qSwap(x1, x2);
+      qSwap(y1, y2);
+    }
+    const int xBegin = qMax(x1, clipLeft);
+    const int xEnd = qMin(x2, clipRight);
+    if (xBegin > xEnd)
+      return;
+    const int dx = x2-x1;
+    const int dy = qAbs(y2-y1);
+    const int stepY = y2 >= y1 ? 1 : -1;
+    // skip to xBegin: the error stays in [0, dx), so the number of y steps taken so far follows directly
+    const qint64 skipped = qint64(xBegin-x1)*dy-dx/2;
+    const qint64 ySteps = skipped > 0 ? (skipped+dx-1)/dx : 0;
+    int error = int(dx/2-qint64(xBegin-x1)*dy+ySteps*dx);
+    int y = y1+int(ySteps)*stepY;
+    int runStart = xBegin;
+    for (int x=xBegin; x<=xEnd; ++x)
+    {
+      error -= dy;
+      const bool stepNow = error < 0;
+      if (stepNow || x == xEnd) // run ends here
+      {
+        if (y >= clipTop && y <= clipBottom)
+        {
+          QRgb *line = reinterpret_cast<QRgb*>(bits+y*bytesPerLine);
+          for (int runX=runStart; runX<=x; ++runX)
+            line[runX] = color;
+        }
+        runStart = x+1;
+      }
+      if (stepNow)
+      {
+        y += stepY;
+        error += dx;
+      }
+    }
+  } else // mostly vertical, draw runs of pixels in the same pixel column
+  {
+    if (y1 > y2)
+    {
+      qSwap(x1, x2);
+      qSwap(y1, y2);
+    }
+    const int yBegin = qMax(y1, clipTop);
+    const int yEnd = qMin(y2, clipBottom);
+    if (yBegin > yEnd)
+      return;
+    const int dx = qAbs(x2-x1);
+    const int dy = y2-y1;
+    const int stepX = x2 >= x1 ? 1 : -1;
+    // skip to yBegin: the error stays in [0, dy), so the number of x steps taken so far follows directly
+    const qint64 skipped = qint64(yBegin-y1)*dx-dy/2;
+    const qint64 xSteps = skipped > 0 ? (skipped+dy-1)/dy : 0;
+    int error = int(dy/2-qint64(yBegin-y1)*dx+xSteps*dy);
+    int x = x1+int(xSteps)*stepX;
+    int runStart = yBegin;
+    for (int y=yBegin; y<=yEnd; ++y)
+    {
+      error -= dx;
+      const bool stepNow = error < 0;
+      if (stepNow || y == yEnd) // run ends here
+      {
+        if (x >= clipLeft && x <= clipRight)
+        {
+          uchar *pixel = bits+runStart*bytesPerLine+x*int(sizeof(QRgb));
+          for (int runY=runStart; runY<=y; ++runY, pixel+=bytesPerLine)
+            *reinterpret_cast<QRgb*>(pixel) = color;
+        }
+        runStart = y+1;
+      }
+      if (stepNow)
+      {
+        x += stepX;
+        error += dy;
+      }
+    }
+  }
+}
 /* end of 'src/painter.cpp' */
 
 
@@ -592,6 +823,7 @@ void QCPAbstractPaintBuffer::setSize(const QSize &size)
   {
     mSize = size;
     reallocateBuffer();
+    setInvalidated(); // contents are gone, buffered layers must not be replotted individually
   }
 }
 
@@ -631,6 +863,7 @@ void QCPAbstractPaintBuffer::setDevicePixelRatio(double ratio)
 #ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
     mDevicePixelRatio = ratio;
     reallocateBuffer();
+    setInvalidated();
 #else
     qDebug() << Q_FUNC_INFO << "Device pixel ratios not supported for Qt versions before 5.4";
     mDevicePixelRatio = 1.0;
@@ -643,10 +876,14 @@ void QCPAbstractPaintBuffer::setDevicePixelRatio(double ratio)
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 /*! \class QCPPaintBufferPixmap
-  \brief A paint buffer based on QPixmap, using software raster rendering
+  \brief A paint buffer based on QImage, using software raster rendering
 
-  This paint buffer is the default and fall-back paint buffer which uses software rendering and
-  QPixmap as internal buffer. It is used if \ref QCustomPlot::setOpenGl is false.
+  This paint buffer is the default and fall-back paint buffer which uses software rendering. It is
+  used if \ref QCustomPlot::setOpenGl is false.
+
+  The internal buffer is a QImage in premultiplied ARGB32 format rather than a QPixmap. With the
+  raster paint engine a QPixmap is backed by such an image anyway, but only a QImage gives access
+  to its pixels, which \ref QCPPainter::drawPolylineRaster uses to draw graph lines directly.
 */
 
 /*!
@@ -675,7 +912,7 @@ QCPPainter *QCPPaintBufferPixmap::startPainting()
 void QCPPaintBufferPixmap::draw(QCPPainter *painter) const
 {
   if (painter && painter->isActive())
-    painter->drawPixmap(0, 0, mBuffer);
+    painter->drawImage(0, 0, mBuffer);
   else
     qDebug() << Q_FUNC_INFO << "invalid or inactive painter passed";
 }
@@ -693,16 +930,16 @@ void QCPPaintBufferPixmap::reallocateBuffer()
   if (!qFuzzyCompare(1.0, mDevicePixelRatio))
   {
 #ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
-    mBuffer = QPixmap(mSize*mDevicePixelRatio);
+    mBuffer = QImage(mSize*mDevicePixelRatio, QImage::Format_ARGB32_Premultiplied);
     mBuffer.setDevicePixelRatio(mDevicePixelRatio);
 #else
     qDebug() << Q_FUNC_INFO << "Device pixel ratios not supported for Qt versions before 5.4";
     mDevicePixelRatio = 1.0;
-    mBuffer = QPixmap(mSize);
+    mBuffer = QImage(mSize, QImage::Format_ARGB32_Premultiplied);
 #endif
   } else
   {
-    mBuffer = QPixmap(mSize);
+    mBuffer = QImage(mSize, QImage::Format_ARGB32_Premultiplied);
   }
 }
 
@@ -1011,6 +1248,16 @@ void QCPPaintBufferGlFbo::reallocateBuffer()
   compared with a full replot of all layers. Upon creation of a new layer, the layer mode is
   initialized to \ref lmLogical. The only layer that is set to \ref lmBuffered in a new \ref
   QCustomPlot instance is the "overlay" layer, containing the selection rect.
+
+  \section qcplayer-dirty Redrawing only changed layers
+
+  If the plotting hint \ref QCP::phDirtyLayers is set, \ref QCustomPlot::replot only clears and
+  redraws the paint buffers that hold a dirty layer (see \ref markDirty), the other paint buffers
+  keep their contents from the previous replot. A layer is dirty if one of its layerables changed
+  since the last replot. Axes, grids, axis rects, legends and text elements mark their layer dirty
+  in their setters and when their geometry or tick positions change. Plottables and items don't
+  notice changes of their data or positions, so layers that contain visible plottables or items are
+  always redrawn.
 */
 
 /* start documentation of inline functions */
@@ -1029,6 +1276,23 @@ void QCPPaintBufferGlFbo::reallocateBuffer()
   Layers with higher indices will be drawn above layers with lower indices.
 */
 
+/*! \fn void QCPLayer::markDirty()
+  
+  Marks this layer to be redrawn at the next \ref QCustomPlot::replot, if the plotting hint \ref
+  QCP::phDirtyLayers is set. Layerables call this via \ref QCPLayerable::markLayerDirty when they
+  change in a way the layer can't notice by itself.
+  
+  \see dirty
+*/
+
+/*! \fn bool QCPLayer::dirty() const
+  
+  Returns whether this layer was marked dirty since it was last drawn. Layers that contain
+  plottables or items are redrawn on every replot, even if this returns false.
+  
+  \see markDirty
+*/
+
 /* end documentation of inline functions */
 
 /*!
@@ -1045,7 +1309,8 @@ QCPLayer::QCPLayer(QCustomPlot *parentPlot, const QString &layerName) :
   mName(layerName),
   mIndex(-1), // will be set to a proper value by the QCustomPlot layer creation function
   mVisible(true),
-  mMode(lmLogical)
+  mMode(lmLogical),
+  mDirty(true)
 {
   // Note: no need to make sure layerName is unique, because layer
   // management is done with QCustomPlot functions.
@@ -1075,7 +1340,11 @@ QCPLayer::~QCPLayer()
 */
 void QCPLayer::setVisible(bool visible)
 {
-  mVisible = visible;
+  if (mVisible != visible)
+  {
+    mVisible = visible;
+    mParentPlot->invalidatePaintBuffers(); // layerables on other layers may have their parent layerable on this one
+  }
 }
 
 /*!
@@ -1104,11 +1373,30 @@ void QCPLayer::setMode(QCPLayer::LayerMode mode)
   if (mMode != mode)
   {
     mMode = mode;
+    mDirty = true;
     if (!mPaintBuffer.isNull())
       mPaintBuffer.data()->setInvalidated();
   }
 }
 
+/*! \internal
+
+  Returns whether this layer has visible children that don't mark the layer dirty when they change,
+  like plottables and items. Such layers are redrawn on every replot, even if the plotting hint \ref
+  QCP::phDirtyLayers is set.
+
+  \see QCPLayerable::markLayerDirty
+*/
+bool QCPLayer::hasUntrackedChildren() const
+{
+  foreach (QCPLayerable *child, mChildren)
+  {
+    if (!child->mMarksLayerDirty && child->realVisibility())
+      return true;
+  }
+  return false;
+}
+
 /*! \internal
 
   Draws the contents of this layer with the provided \a painter.
@@ -1116,6 +1404,18 @@ void QCPLayer::setMode(QCPLayer::LayerMode mode)
   \see replot, drawToPaintBuffer
 */
 void QCPLayer::draw(QCPPainter *painter)
+{
+  if (mParentPlot->plottingHints().testFlag(QCP::phParallelPlottables) && drawParallel(painter))
+    return;
+  drawChildren(painter);
+}
+
+/*! \internal
+
+  Draws the visible children of this layer with \a painter, in their order on this layer. Used by
+  \ref draw and, for one horizontal strip of the paint buffer each, by \ref drawParallel.
+*/
+void QCPLayer::drawChildren(QCPPainter *painter)
 {
   foreach (QCPLayerable *child, mChildren)
   {
@@ -1130,6 +1430,134 @@ void QCPLayer::draw(QCPPainter *painter)
   }
 }
 
+/*! \internal
+
+  Draws the children of a layer into one horizontal strip of the paint buffer image, see \ref
+  QCPLayer::drawParallel. The strip is a QImage on the memory of the paint buffer rows, so the
+  strips don't need to be composited afterwards, and strips on different threads never write to
+  the same pixels.
+*/
+class QCPLayerStripTask : public QRunnable
+{
+public:
+  QCPLayerStripTask(QCPLayer *layer, uchar *bits, int width, int bytesPerLine, QImage::Format format, int top, int height,
+                    QPainter::RenderHints hints, QCPPainter::PainterModes modes, QSemaphore *done) :
+    mLayer(layer), mBits(bits), mWidth(width), mBytesPerLine(bytesPerLine), mFormat(format), mTop(top), mHeight(height),
+    mHints(hints), mModes(modes), mDone(done)
+  {
+  }
+  
+  virtual void run() Q_DECL_OVERRIDE
+  {
+    {
+      QImage strip(mBits+mTop*mBytesPerLine, mWidth, mHeight, mBytesPerLine, mFormat);
+      QCPPainter painter(&strip);
+      painter.setRenderHints(mHints);
+      painter.setModes(mModes);
+      painter.translate(0, -mTop); // children draw in paint buffer coordinates, whole pixel translation keeps rasterization identical
+      mLayer->drawChildren(&painter);
+    }
+    if (mDone)
+      mDone->release();
+  }
+  
+private:
+  QCPLayer *mLayer;
+  uchar *mBits;
+  int mWidth, mBytesPerLine;
+  QImage::Format mFormat;
+  int mTop, mHeight;
+  QPainter::RenderHints mHints;
+  QCPPainter::PainterModes mModes;
+  QSemaphore *mDone;
+};
+
+/*! \internal
+
+  Draws the children of this layer in horizontal strips of the paint buffer, on the threads of a
+  private QThreadPool of the parent plot and the calling thread. Used by \ref draw if the plotting
+  hint \ref QCP::phParallelPlottables is set. The pool is not shared with the application, so other
+  users of the global pool can't stall the replot; if a strip can't be started on a pool thread
+  anyway, it is drawn in the calling thread.
+
+  This is only done if all visible children are graphs (\ref QCPGraph), whose \ref QCPGraph::draw
+  doesn't modify any shared state once their pixel geometry is up to date, and if \a painter
+  paints untransformed and unclipped on the QImage of the software paint buffer. Otherwise, false
+  is returned and nothing is drawn.
+
+  Each strip draws all children in their usual order, clipped to the strip. Since aliased
+  rasterization (including \ref QCPPainter::drawPolylineRaster) doesn't depend on the clip rect,
+  the result is the same as drawing serially.
+*/
+bool QCPLayer::drawParallel(QCPPainter *painter)
+{
+  const int minStripHeight = 32; // below this, thread overhead outweighs the gain
+  QPaintDevice *device = painter->device();
+  if (!device || device->devType() != QInternal::Image)
+    return false;
+  QImage *buffer = static_cast<QImage*>(device);
+  if (buffer->format() != QImage::Format_ARGB32_Premultiplied || !buffer->isDetached())
+    return false;
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+  if (!qFuzzyCompare(buffer->devicePixelRatio(), 1.0))
+    return false;
+#endif
+  if (painter->transform().type() != QTransform::TxNone || painter->hasClipping() ||
+      painter->modes().testFlag(QCPPainter::pmVectorized) || painter->modes().testFlag(QCPPainter::pmNoCaching))
+    return false;
+  if (QThread::idealThreadCount() < 2 || buffer->height()/minStripHeight < 2)
+    return false;
+  if (!mParentPlot->mStripThreadPool)
+  {
+    mParentPlot->mStripThreadPool = new QThreadPool(mParentPlot);
+    mParentPlot->mStripThreadPool->setMaxThreadCount(QThread::idealThreadCount()-1); // the calling thread draws one strip itself
+  }
+  QThreadPool *pool = mParentPlot->mStripThreadPool;
+  const int stripCount = qMin(pool->maxThreadCount()+1, buffer->height()/minStripHeight);
+  
+  QList<QCPGraph*> graphs;
+  foreach (QCPLayerable *child, mChildren)
+  {
+    if (!child->realVisibility())
+      continue;
+    QCPGraph *graph = qobject_cast<QCPGraph*>(child);
+    if (!graph)
+      return false;
+    // QPixmap may only be used in the GUI thread:
+    if (graph->scatterStyle().shape() == QCPScatterStyle::ssPixmap ||
+        (graph->selectionDecorator() && graph->selectionDecorator()->scatterStyle().shape() == QCPScatterStyle::ssPixmap))
+      return false;
+    graphs.append(graph);
+  }
+  if (graphs.isEmpty())
+    return false;
+  
+  // the strips only read the geometry caches, so bring them up to date here:
+  foreach (QCPGraph *graph, graphs)
+  {
+    if (graph->keyAxis() && graph->valueAxis() && !graph->data()->isEmpty())
+      graph->updateGeometryCache();
+  }
+  
+  uchar *bits = buffer->bits();
+  QSemaphore done;
+  for (int i=0; i<stripCount; ++i)
+  {
+    const int top = buffer->height()*i/stripCount;
+    const int bottom = buffer->height()*(i+1)/stripCount;
+    const bool isLast = i == stripCount-1;
+    QCPLayerStripTask *task = new QCPLayerStripTask(this, bits, buffer->width(), buffer->bytesPerLine(), buffer->format(), top, bottom-top,
+                                                    painter->renderHints(), painter->modes(), isLast ? 0 : &done);
+    if (isLast || !pool->tryStart(task)) // last strip, and strips no pool thread is free for, are drawn in this thread
+    {
+      task->run();
+      delete task;
+    }
+  }
+  done.acquire(stripCount-1);
+  return true;
+}
+
 /*! \internal
 
   Draws the contents of this layer into the paint buffer which is associated with this layer. The
@@ -1178,6 +1606,7 @@ void QCPLayer::replot()
       mPaintBuffer.data()->clear(Qt::transparent);
       drawToPaintBuffer();
       mPaintBuffer.data()->setInvalidated(false);
+      mDirty = false;
       mParentPlot->update();
     } else
       qDebug() << Q_FUNC_INFO << "no valid paint buffer associated with this layer";
@@ -1203,6 +1632,7 @@ void QCPLayer::addChild(QCPLayerable *layerable, bool prepend)
       mChildren.prepend(layerable);
     else
       mChildren.append(layerable);
+    mDirty = true;
     if (!mPaintBuffer.isNull())
       mPaintBuffer.data()->setInvalidated();
   } else
@@ -1222,6 +1652,7 @@ void QCPLayer::removeChild(QCPLayerable *layerable)
 {
   if (mChildren.removeOne(layerable))
   {
+    mDirty = true;
     if (!mPaintBuffer.isNull())
       mPaintBuffer.data()->setInvalidated();
   } else
@@ -1260,6 +1691,16 @@ void QCPLayer::removeChild(QCPLayerable *layerable)
   set manually by the user.
 */
 
+/*! \fn void QCPLayerable::markLayerDirty()
+ 
+  Marks the layer of this layerable dirty, so it is redrawn at the next \ref QCustomPlot::replot
+  when the plotting hint \ref QCP::phDirtyLayers is set (see \ref QCPLayer::markDirty).
+  
+  Layerables that track their own changes, like axes and legends, call this in their setters.
+  Layerables that don't (e.g. plottables, whose data may change without notice) keep their layer
+  redrawn on every replot anyway, so there is no need to call this after changing their data.
+*/
+
 /* end documentation of inline functions */
 /* start documentation of pure virtual functions */
 
@@ -1342,7 +1783,8 @@ QCPLayerable::QCPLayerable(QCustomPlot *plot, QString targetLayer, QCPLayerable
   mParentPlot(plot),
   mParentLayerable(parentLayerable),
   mLayer(0),
-  mAntialiased(true)
+  mAntialiased(true),
+  mMarksLayerDirty(false)
 {
   if (mParentPlot)
   {
@@ -1369,7 +1811,12 @@ QCPLayerable::~QCPLayerable()
 */
 void QCPLayerable::setVisible(bool on)
 {
-  mVisible = on;
+  if (mVisible != on)
+  {
+    mVisible = on;
+    if (mParentPlot)
+      mParentPlot->invalidatePaintBuffers(); // child layerables on other layers change their visibility, too
+  }
 }
 
 /*!
@@ -1417,6 +1864,7 @@ bool QCPLayerable::setLayer(const QString &layerName)
 void QCPLayerable::setAntialiased(bool enabled)
 {
   mAntialiased = enabled;
+  markLayerDirty();
 }
 
 /*!
@@ -3190,6 +3638,7 @@ QCPLayoutElement::QCPLayoutElement(QCustomPlot *parentPlot) :
   mMinimumMargins(0, 0, 0, 0),
   mAutoMargins(QCP::msAll)
 {
+  mMarksLayerDirty = true;
 }
 
 QCPLayoutElement::~QCPLayoutElement()
@@ -3217,6 +3666,7 @@ void QCPLayoutElement::setOuterRect(const QRect &rect)
   {
     mOuterRect = rect;
     mRect = mOuterRect.adjusted(mMargins.left(), mMargins.top(), -mMargins.right(), -mMargins.bottom());
+    markLayerDirty();
   }
 }
 
@@ -3237,6 +3687,7 @@ void QCPLayoutElement::setMargins(const QMargins &margins)
   {
     mMargins = margins;
     mRect = mOuterRect.adjusted(mMargins.left(), mMargins.top(), -mMargins.right(), -mMargins.bottom());
+    markLayerDirty();
   }
 }
 
@@ -5496,7 +5947,11 @@ void QCPLineEnding::draw(QCPPainter *painter, const QCPVector2D &pos, double ang
 QCPAxisTicker::QCPAxisTicker() :
   mTickStepStrategy(tssReadability),
   mTickCount(5),
-  mTickOrigin(0)
+  mTickOrigin(0),
+  mLabelCacheEnabled(true),
+  mCachedTickStep(0),
+  mCachedPrecision(0),
+  mCachedSubTickCount(0)
 {
 }
 
@@ -5555,11 +6010,24 @@ void QCPAxisTicker::setTickOrigin(double origin)
   The output parameters \a subTicks and \a tickLabels are optional (set them to 0 if not needed)
   and are respectively filled with sub tick coordinates, and tick label strings belonging to \a
   ticks by index.
+  
+  The ticker keeps the sub ticks and tick labels of the last call. As long as the tick step, \a
+  locale, \a formatChar and \a precision stay the same, e.g. while a range is dragged or scrolled
+  by less than one tick step, sub ticks are only regenerated if the major ticks changed, and labels
+  are only created for ticks that weren't labeled in the last call.
 */
 void QCPAxisTicker::generate(const QCPRange &range, const QLocale &locale, QChar formatChar, int precision, QVector<double> &ticks, QVector<double> *subTicks, QVector<QString> *tickLabels)
 {
   // generate (major) ticks:
   double tickStep = getTickStep(range);
+  if (tickStep != mCachedTickStep || formatChar != mCachedFormatChar || precision != mCachedPrecision || locale != mCachedLocale)
+  {
+    clearCache();
+    mCachedTickStep = tickStep;
+    mCachedLocale = locale;
+    mCachedFormatChar = formatChar;
+    mCachedPrecision = precision;
+  }
   ticks = createTickVector(tickStep, range);
   trimTicks(range, ticks, true); // trim ticks to visible range plus one outer tick on each side (incase a subclass createTickVector creates more)
   
@@ -5568,7 +6036,14 @@ void QCPAxisTicker::generate(const QCPRange &range, const QLocale &locale, QChar
   {
     if (ticks.size() > 0)
     {
-      *subTicks = createSubTickVector(getSubTickCount(tickStep), ticks);
+      const int subTickCount = getSubTickCount(tickStep);
+      if (subTickCount != mCachedSubTickCount || ticks != mCachedTicks)
+      {
+        mCachedSubTicks = createSubTickVector(subTickCount, ticks);
+        mCachedSubTickCount = subTickCount;
+        mCachedTicks = ticks;
+      }
+      *subTicks = mCachedSubTicks;
       trimTicks(range, *subTicks, false);
     } else
       *subTicks = QVector<double>();
@@ -5734,16 +6209,49 @@ QVector<double> QCPAxisTicker::createTickVector(double tickStep, const QCPRange
   
   It is possible but uncommon for QCPAxisTicker subclasses to reimplement this method, as
   reimplementing \ref getTickLabel often achieves the intended result easier.
+  
+  Labels of ticks that were already labeled in the last call are taken from the cache (see \ref
+  generate), so \ref getTickLabel is only called for ticks that newly scrolled into the range.
+  Both \a ticks and the cached ticks are sorted ascending, so they are matched in a single pass.
 */
 QVector<QString> QCPAxisTicker::createLabelVector(const QVector<double> &ticks, const QLocale &locale, QChar formatChar, int precision)
 {
   QVector<QString> result;
   result.reserve(ticks.size());
+  int cached = 0;
   for (int i=0; i<ticks.size(); ++i)
-    result.append(getTickLabel(ticks.at(i), locale, formatChar, precision));
+  {
+    const double tick = ticks.at(i);
+    while (cached < mCachedLabelTicks.size() && mCachedLabelTicks.at(cached) < tick)
+      ++cached;
+    if (cached < mCachedLabelTicks.size() && mCachedLabelTicks.at(cached) == tick) // ticks of the same step are bitwise equal, see createTickVector
+      result.append(mCachedLabels.at(cached));
+    else
+      result.append(getTickLabel(tick, locale, formatChar, precision));
+  }
+  if (mLabelCacheEnabled)
+  {
+    mCachedLabelTicks = ticks;
+    mCachedLabels = result;
+  }
   return result;
 }
 
+/*! \internal
+  
+  Discards the sub ticks and tick labels kept from the last call of \ref generate. Subclasses must
+  call this whenever a property changes that influences the sub ticks or labels generated for a
+  given tick step, e.g. the format of the labels.
+*/
+void QCPAxisTicker::clearCache()
+{
+  mCachedTicks.clear();
+  mCachedSubTicks.clear();
+  mCachedSubTickCount = 0;
+  mCachedLabelTicks.clear();
+  mCachedLabels.clear();
+}
+
 /*! \internal
   
   Removes tick coordinates from \a ticks which lie outside the specified \a range. If \a
@@ -5915,6 +6423,7 @@ QCPAxisTickerDateTime::QCPAxisTickerDateTime() :
 void QCPAxisTickerDateTime::setDateTimeFormat(const QString &format)
 {
   mDateTimeFormat = format;
+  clearCache();
 }
 
 /*!
@@ -5930,6 +6439,7 @@ void QCPAxisTickerDateTime::setDateTimeFormat(const QString &format)
 void QCPAxisTickerDateTime::setDateTimeSpec(Qt::TimeSpec spec)
 {
   mDateTimeSpec = spec;
+  clearCache();
 }
 
 /*!
@@ -6233,6 +6743,7 @@ QCPAxisTickerTime::QCPAxisTickerTime() :
 void QCPAxisTickerTime::setTimeFormat(const QString &format)
 {
   mTimeFormat = format;
+  clearCache();
   
   // determine smallest and biggest unit in format, to optimize unit replacement and allow biggest
   // unit to consume remaining time of a tick value and grow beyond its modulo (e.g. min > 59)
@@ -6264,6 +6775,7 @@ void QCPAxisTickerTime::setTimeFormat(const QString &format)
 void QCPAxisTickerTime::setFieldWidth(QCPAxisTickerTime::TimeUnit unit, int width)
 {
   mFieldWidth[unit] = qMax(width, 1);
+  clearCache();
 }
 
 /*! \internal
@@ -6544,6 +7056,7 @@ double QCPAxisTickerFixed::getTickStep(const QCPRange &range)
 QCPAxisTickerText::QCPAxisTickerText() :
   mSubTickCount(0)
 {
+  mLabelCacheEnabled = false; // labels can be changed through the non-const ticks() accessor
 }
 
 /*! \overload
@@ -6757,6 +7270,7 @@ QCPAxisTickerPi::QCPAxisTickerPi() :
 void QCPAxisTickerPi::setPiSymbol(QString symbol)
 {
   mPiSymbol = symbol;
+  clearCache();
 }
 
 /*!
@@ -6768,6 +7282,7 @@ void QCPAxisTickerPi::setPiSymbol(QString symbol)
 void QCPAxisTickerPi::setPiValue(double pi)
 {
   mPiValue = pi;
+  clearCache();
 }
 
 /*!
@@ -6781,6 +7296,7 @@ void QCPAxisTickerPi::setPiValue(double pi)
 void QCPAxisTickerPi::setPeriodicity(int multiplesOfPi)
 {
   mPeriodicity = qAbs(multiplesOfPi);
+  clearCache();
 }
 
 /*!
@@ -6790,6 +7306,7 @@ void QCPAxisTickerPi::setPeriodicity(int multiplesOfPi)
 void QCPAxisTickerPi::setFractionStyle(QCPAxisTickerPi::FractionStyle style)
 {
   mFractionStyle = style;
+  clearCache();
 }
 
 /*! \internal
@@ -7171,6 +7688,7 @@ QCPGrid::QCPGrid(QCPAxis *parentAxis) :
 {
   // warning: this is called in QCPAxis constructor, so parentAxis members should not be accessed/called
   setParent(parentAxis);
+  mMarksLayerDirty = true;
   setPen(QPen(QColor(200,200,200), 0, Qt::DotLine));
   setSubGridPen(QPen(QColor(220,220,220), 0, Qt::DotLine));
   setZeroLinePen(QPen(QColor(200,200,200), 0, Qt::SolidLine));
@@ -7187,6 +7705,7 @@ QCPGrid::QCPGrid(QCPAxis *parentAxis) :
 */
 void QCPGrid::setSubGridVisible(bool visible)
 {
+  markLayerDirty();
   mSubGridVisible = visible;
 }
 
@@ -7195,6 +7714,7 @@ void QCPGrid::setSubGridVisible(bool visible)
 */
 void QCPGrid::setAntialiasedSubGrid(bool enabled)
 {
+  markLayerDirty();
   mAntialiasedSubGrid = enabled;
 }
 
@@ -7203,6 +7723,7 @@ void QCPGrid::setAntialiasedSubGrid(bool enabled)
 */
 void QCPGrid::setAntialiasedZeroLine(bool enabled)
 {
+  markLayerDirty();
   mAntialiasedZeroLine = enabled;
 }
 
@@ -7211,6 +7732,7 @@ void QCPGrid::setAntialiasedZeroLine(bool enabled)
 */
 void QCPGrid::setPen(const QPen &pen)
 {
+  markLayerDirty();
   mPen = pen;
 }
 
@@ -7219,6 +7741,7 @@ void QCPGrid::setPen(const QPen &pen)
 */
 void QCPGrid::setSubGridPen(const QPen &pen)
 {
+  markLayerDirty();
   mSubGridPen = pen;
 }
 
@@ -7230,6 +7753,7 @@ void QCPGrid::setSubGridPen(const QPen &pen)
 */
 void QCPGrid::setZeroLinePen(const QPen &pen)
 {
+  markLayerDirty();
   mZeroLinePen = pen;
 }
 
@@ -7548,6 +8072,7 @@ QCPAxis::QCPAxis(QCPAxisRect *parent, AxisType type) :
   mCachedMargin(0)
 {
   setParent(parent);
+  mMarksLayerDirty = true;
   mGrid->setVisible(false);
   setAntialiased(false);
   setLayer(mParentPlot->currentLayer()); // it's actually on that layer already, but we want it in front of the grid, so we place it on there again
@@ -7673,6 +8198,8 @@ QCPLineEnding QCPAxis::upperEnding() const
 */
 void QCPAxis::setScaleType(QCPAxis::ScaleType type)
 {
+  markLayerDirty();
+  mGrid->markLayerDirty(); // grid lines move even if the ticks stay the same
   if (mScaleType != type)
   {
     mScaleType = type;
@@ -7745,6 +8272,7 @@ void QCPAxis::setSelectableParts(const SelectableParts &selectable)
 */
 void QCPAxis::setSelectedParts(const SelectableParts &selected)
 {
+  markLayerDirty();
   if (mSelectedParts != selected)
   {
     mSelectedParts = selected;
@@ -7857,6 +8385,8 @@ void QCPAxis::setRangeUpper(double upper)
 */
 void QCPAxis::setRangeReversed(bool reversed)
 {
+  markLayerDirty();
+  mGrid->markLayerDirty(); // grid lines move even if the ticks stay the same
   mRangeReversed = reversed;
 }
 
@@ -7875,6 +8405,7 @@ void QCPAxis::setRangeReversed(bool reversed)
 */
 void QCPAxis::setTicker(QSharedPointer<QCPAxisTicker> ticker)
 {
+  markLayerDirty();
   if (ticker)
     mTicker = ticker;
   else
@@ -7892,6 +8423,7 @@ void QCPAxis::setTicker(QSharedPointer<QCPAxisTicker> ticker)
 */
 void QCPAxis::setTicks(bool show)
 {
+  markLayerDirty();
   if (mTicks != show)
   {
     mTicks = show;
@@ -7904,6 +8436,7 @@ void QCPAxis::setTicks(bool show)
 */
 void QCPAxis::setTickLabels(bool show)
 {
+  markLayerDirty();
   if (mTickLabels != show)
   {
     mTickLabels = show;
@@ -7919,6 +8452,7 @@ void QCPAxis::setTickLabels(bool show)
 */
 void QCPAxis::setTickLabelPadding(int padding)
 {
+  markLayerDirty();
   if (mAxisPainter->tickLabelPadding != padding)
   {
     mAxisPainter->tickLabelPadding = padding;
@@ -7933,6 +8467,7 @@ void QCPAxis::setTickLabelPadding(int padding)
 */
 void QCPAxis::setTickLabelFont(const QFont &font)
 {
+  markLayerDirty();
   if (font != mTickLabelFont)
   {
     mTickLabelFont = font;
@@ -7947,6 +8482,7 @@ void QCPAxis::setTickLabelFont(const QFont &font)
 */
 void QCPAxis::setTickLabelColor(const QColor &color)
 {
+  markLayerDirty();
   mTickLabelColor = color;
 }
 
@@ -7961,6 +8497,7 @@ void QCPAxis::setTickLabelColor(const QColor &color)
 */
 void QCPAxis::setTickLabelRotation(double degrees)
 {
+  markLayerDirty();
   if (!qFuzzyIsNull(degrees-mAxisPainter->tickLabelRotation))
   {
     mAxisPainter->tickLabelRotation = qBound(-90.0, degrees, 90.0);
@@ -7977,6 +8514,7 @@ void QCPAxis::setTickLabelRotation(double degrees)
 */
 void QCPAxis::setTickLabelSide(LabelSide side)
 {
+  markLayerDirty();
   mAxisPainter->tickLabelSide = side;
   mCachedMarginValid = false;
 }
@@ -8013,6 +8551,7 @@ void QCPAxis::setTickLabelSide(LabelSide side)
 */
 void QCPAxis::setNumberFormat(const QString &formatCode)
 {
+  markLayerDirty();
   if (formatCode.isEmpty())
   {
     qDebug() << Q_FUNC_INFO << "Passed formatCode is empty";
@@ -8073,6 +8612,7 @@ void QCPAxis::setNumberFormat(const QString &formatCode)
 */
 void QCPAxis::setNumberPrecision(int precision)
 {
+  markLayerDirty();
   if (mNumberPrecision != precision)
   {
     mNumberPrecision = precision;
@@ -8090,6 +8630,7 @@ void QCPAxis::setNumberPrecision(int precision)
 */
 void QCPAxis::setTickLength(int inside, int outside)
 {
+  markLayerDirty();
   setTickLengthIn(inside);
   setTickLengthOut(outside);
 }
@@ -8102,6 +8643,7 @@ void QCPAxis::setTickLength(int inside, int outside)
 */
 void QCPAxis::setTickLengthIn(int inside)
 {
+  markLayerDirty();
   if (mAxisPainter->tickLengthIn != inside)
   {
     mAxisPainter->tickLengthIn = inside;
@@ -8117,6 +8659,7 @@ void QCPAxis::setTickLengthIn(int inside)
 */
 void QCPAxis::setTickLengthOut(int outside)
 {
+  markLayerDirty();
   if (mAxisPainter->tickLengthOut != outside)
   {
     mAxisPainter->tickLengthOut = outside;
@@ -8133,6 +8676,7 @@ void QCPAxis::setTickLengthOut(int outside)
 */
 void QCPAxis::setSubTicks(bool show)
 {
+  markLayerDirty();
   if (mSubTicks != show)
   {
     mSubTicks = show;
@@ -8150,6 +8694,7 @@ void QCPAxis::setSubTicks(bool show)
 */
 void QCPAxis::setSubTickLength(int inside, int outside)
 {
+  markLayerDirty();
   setSubTickLengthIn(inside);
   setSubTickLengthOut(outside);
 }
@@ -8162,6 +8707,7 @@ void QCPAxis::setSubTickLength(int inside, int outside)
 */
 void QCPAxis::setSubTickLengthIn(int inside)
 {
+  markLayerDirty();
   if (mAxisPainter->subTickLengthIn != inside)
   {
     mAxisPainter->subTickLengthIn = inside;
@@ -8177,6 +8723,7 @@ void QCPAxis::setSubTickLengthIn(int inside)
 */
 void QCPAxis::setSubTickLengthOut(int outside)
 {
+  markLayerDirty();
   if (mAxisPainter->subTickLengthOut != outside)
   {
     mAxisPainter->subTickLengthOut = outside;
@@ -8191,6 +8738,7 @@ void QCPAxis::setSubTickLengthOut(int outside)
 */
 void QCPAxis::setBasePen(const QPen &pen)
 {
+  markLayerDirty();
   mBasePen = pen;
 }
 
@@ -8201,6 +8749,7 @@ void QCPAxis::setBasePen(const QPen &pen)
 */
 void QCPAxis::setTickPen(const QPen &pen)
 {
+  markLayerDirty();
   mTickPen = pen;
 }
 
@@ -8211,6 +8760,7 @@ void QCPAxis::setTickPen(const QPen &pen)
 */
 void QCPAxis::setSubTickPen(const QPen &pen)
 {
+  markLayerDirty();
   mSubTickPen = pen;
 }
 
@@ -8221,6 +8771,7 @@ void QCPAxis::setSubTickPen(const QPen &pen)
 */
 void QCPAxis::setLabelFont(const QFont &font)
 {
+  markLayerDirty();
   if (mLabelFont != font)
   {
     mLabelFont = font;
@@ -8235,6 +8786,7 @@ void QCPAxis::setLabelFont(const QFont &font)
 */
 void QCPAxis::setLabelColor(const QColor &color)
 {
+  markLayerDirty();
   mLabelColor = color;
 }
 
@@ -8244,6 +8796,7 @@ void QCPAxis::setLabelColor(const QColor &color)
 */
 void QCPAxis::setLabel(const QString &str)
 {
+  markLayerDirty();
   if (mLabel != str)
   {
     mLabel = str;
@@ -8258,6 +8811,7 @@ void QCPAxis::setLabel(const QString &str)
 */
 void QCPAxis::setLabelPadding(int padding)
 {
+  markLayerDirty();
   if (mAxisPainter->labelPadding != padding)
   {
     mAxisPainter->labelPadding = padding;
@@ -8277,6 +8831,7 @@ void QCPAxis::setLabelPadding(int padding)
 */
 void QCPAxis::setPadding(int padding)
 {
+  markLayerDirty();
   if (mPadding != padding)
   {
     mPadding = padding;
@@ -8294,7 +8849,11 @@ void QCPAxis::setPadding(int padding)
 */
 void QCPAxis::setOffset(int offset)
 {
-  mAxisPainter->offset = offset;
+  if (mAxisPainter->offset != offset)
+  {
+    mAxisPainter->offset = offset;
+    markLayerDirty();
+  }
 }
 
 /*!
@@ -8304,6 +8863,7 @@ void QCPAxis::setOffset(int offset)
 */
 void QCPAxis::setSelectedTickLabelFont(const QFont &font)
 {
+  markLayerDirty();
   if (font != mSelectedTickLabelFont)
   {
     mSelectedTickLabelFont = font;
@@ -8318,6 +8878,7 @@ void QCPAxis::setSelectedTickLabelFont(const QFont &font)
 */
 void QCPAxis::setSelectedLabelFont(const QFont &font)
 {
+  markLayerDirty();
   mSelectedLabelFont = font;
   // don't set mCachedMarginValid to false here because margin calculation is always done with non-selected fonts
 }
@@ -8329,6 +8890,7 @@ void QCPAxis::setSelectedLabelFont(const QFont &font)
 */
 void QCPAxis::setSelectedTickLabelColor(const QColor &color)
 {
+  markLayerDirty();
   if (color != mSelectedTickLabelColor)
   {
     mSelectedTickLabelColor = color;
@@ -8342,6 +8904,7 @@ void QCPAxis::setSelectedTickLabelColor(const QColor &color)
 */
 void QCPAxis::setSelectedLabelColor(const QColor &color)
 {
+  markLayerDirty();
   mSelectedLabelColor = color;
 }
 
@@ -8352,6 +8915,7 @@ void QCPAxis::setSelectedLabelColor(const QColor &color)
 */
 void QCPAxis::setSelectedBasePen(const QPen &pen)
 {
+  markLayerDirty();
   mSelectedBasePen = pen;
 }
 
@@ -8362,6 +8926,7 @@ void QCPAxis::setSelectedBasePen(const QPen &pen)
 */
 void QCPAxis::setSelectedTickPen(const QPen &pen)
 {
+  markLayerDirty();
   mSelectedTickPen = pen;
 }
 
@@ -8372,6 +8937,7 @@ void QCPAxis::setSelectedTickPen(const QPen &pen)
 */
 void QCPAxis::setSelectedSubTickPen(const QPen &pen)
 {
+  markLayerDirty();
   mSelectedSubTickPen = pen;
 }
 
@@ -8387,6 +8953,7 @@ void QCPAxis::setSelectedSubTickPen(const QPen &pen)
 */
 void QCPAxis::setLowerEnding(const QCPLineEnding &ending)
 {
+  markLayerDirty();
   mAxisPainter->lowerEnding = ending;
 }
 
@@ -8402,6 +8969,7 @@ void QCPAxis::setLowerEnding(const QCPLineEnding &ending)
 */
 void QCPAxis::setUpperEnding(const QCPLineEnding &ending)
 {
+  markLayerDirty();
   mAxisPainter->upperEnding = ending;
 }
 
@@ -9030,6 +9598,26 @@ void QCPAxis::setupTickVectors()
   mCachedMarginValid &= mTickVectorLabels == oldLabels; // if labels have changed, margin might have changed, too
 }
 
+/*! \internal
+  
+  Returns whether the range, the axis rect or the ticks of this axis changed since the last call,
+  i.e. whether the axis and its grid are drawn differently than during the last replot. Called by
+  \ref QCustomPlot::markChangedLayers after the layout was updated, if the plotting hint \ref
+  QCP::phDirtyLayers is set.
+*/
+bool QCPAxis::ticksChanged()
+{
+  if (mRange == mDrawnRange && mAxisRect->rect() == mDrawnAxisRect && mTickVector == mDrawnTickVector &&
+      mSubTickVector == mDrawnSubTickVector && mTickVectorLabels == mDrawnTickVectorLabels)
+    return false;
+  mDrawnRange = mRange;
+  mDrawnAxisRect = mAxisRect->rect();
+  mDrawnTickVector = mTickVector;
+  mDrawnSubTickVector = mSubTickVector;
+  mDrawnTickVectorLabels = mTickVectorLabels;
+  return true;
+}
+
 /*! \internal
   
   Returns the pen that is used to draw the axis base line. Depending on the selection state, this
@@ -9205,7 +9793,8 @@ QCPAxisPainterPrivate::QCPAxisPainterPrivate(QCustomPlot *parentPlot) :
   abbreviateDecimalPowers(false),
   reversedEndings(false),
   mParentPlot(parentPlot),
-  mLabelCache(16) // cache at most 16 (tick) labels
+  mLabelCache(16), // cache at most 16 (tick) labels
+  mGlyphHeight(0)
 {
 }
 
@@ -9228,6 +9817,16 @@ void QCPAxisPainterPrivate::draw(QCPPainter *painter)
     mLabelCache.clear();
     mLabelParameterHash = newHash;
   }
+  if (mParentPlot->plottingHints().testFlag(QCP::phCacheLabels))
+  {
+    // the glyph atlas only depends on font, color and pixel ratio, so it survives e.g. changes of rotation or label side:
+    QByteArray newAtlasHash = generateGlyphAtlasHash();
+    if (newAtlasHash != mGlyphAtlasHash)
+    {
+      setupGlyphAtlas();
+      mGlyphAtlasHash = newAtlasHash;
+    }
+  }
   
   QPoint origin;
   switch (type)
@@ -9455,6 +10054,7 @@ int QCPAxisPainterPrivate::size() const
 void QCPAxisPainterPrivate::clearCache()
 {
   mLabelCache.clear();
+  mGlyphAtlasHash.clear();
 }
 
 /*! \internal
@@ -9477,6 +10077,144 @@ QByteArray QCPAxisPainterPrivate::generateLabelParameterHash() const
   return result;
 }
 
+/*! \internal
+  
+  Returns a hash of the parameters the glyph atlas is rendered with (\ref setupGlyphAtlas). In
+  contrast to \ref generateLabelParameterHash, it doesn't contain parameters like the rotation or
+  the exponent formatting, which only affect how labels are composed from the glyphs.
+*/
+QByteArray QCPAxisPainterPrivate::generateGlyphAtlasHash() const
+{
+  QByteArray result;
+  result.append(QByteArray::number(mParentPlot->bufferDevicePixelRatio()));
+  result.append(tickLabelColor.name().toLatin1()+QByteArray::number(tickLabelColor.alpha(), 16));
+  result.append(tickLabelFont.toString().toLatin1());
+  return result;
+}
+
+static const char qcpGlyphAtlasCharacters[] = "0123456789.,-+e "; // characters of numeric tick labels, in atlas order
+
+/*! \internal
+  
+  Returns the index of the character \a c in the glyph atlas, or -1 if the atlas doesn't contain
+  it. The atlas holds the characters that numeric tick labels consist of.
+*/
+int QCPAxisPainterPrivate::glyphIndex(QChar c)
+{
+  const char latin = c.toLatin1();
+  if (latin == 0)
+    return -1;
+  for (int i=0; qcpGlyphAtlasCharacters[i]; ++i)
+  {
+    if (qcpGlyphAtlasCharacters[i] == latin)
+      return i;
+  }
+  return -1;
+}
+
+/*! \internal
+  
+  Renders the characters of numeric tick labels (see \ref glyphIndex) with the tick label font and
+  color into one pixmap. Each glyph sits in a cell that is one pixel wider than its advance on both
+  sides, so glyphs that slightly overhang their advance aren't cut off when labels are composed.
+  
+  Numeric labels that change with every replot, as on a scrolling axis, are then drawn from this
+  atlas by \ref drawGlyphLabel, instead of rasterizing a new pixmap for every label text.
+*/
+void QCPAxisPainterPrivate::setupGlyphAtlas()
+{
+  mGlyphAtlasFont = tickLabelFont;
+  QFont font = tickLabelFont;
+  if (font.pointSizeF() > 0) // same correction as in getTickLabelData
+    font.setPointSizeF(font.pointSizeF()+0.05);
+  QFontMetrics fontMetrics(font);
+  
+  const QString glyphs = QLatin1String(qcpGlyphAtlasCharacters);
+  mGlyphOffsets.resize(glyphs.size());
+  mGlyphAdvances.resize(glyphs.size());
+  int atlasWidth = 0;
+  for (int i=0; i<glyphs.size(); ++i)
+  {
+    mGlyphOffsets[i] = atlasWidth;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    mGlyphAdvances[i] = fontMetrics.horizontalAdvance(glyphs.at(i));
+#else
+    mGlyphAdvances[i] = fontMetrics.width(glyphs.at(i));
+#endif
+    atlasWidth += mGlyphAdvances.at(i)+2;
+  }
+  mGlyphHeight = fontMetrics.height();
+  
+  const double pixelRatio = mParentPlot->bufferDevicePixelRatio();
+  mGlyphAtlas = QPixmap(QSize(atlasWidth, mGlyphHeight)*pixelRatio);
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+  mGlyphAtlas.setDevicePixelRatio(pixelRatio);
+#endif
+  mGlyphAtlas.fill(Qt::transparent);
+  QCPPainter atlasPainter(&mGlyphAtlas);
+  atlasPainter.setFont(font);
+  atlasPainter.setPen(QPen(tickLabelColor));
+  for (int i=0; i<glyphs.size(); ++i)
+    atlasPainter.drawText(mGlyphOffsets.at(i)+1, fontMetrics.ascent(), QString(glyphs.at(i)));
+}
+
+/*! \internal
+  
+  Returns whether the tick label \a text can be composed from the glyph atlas, and if so, sets \a
+  size to the size of the composed label. Labels are composed only if they aren't rotated, consist
+  of atlas characters only, and don't need the beautiful decimal powers of \ref getTickLabelData.
+  
+  For the \a font the atlas was rendered with, the stored advances are used, otherwise the same
+  advances are determined via QFontMetrics. This way \ref getMaxTickLabelSize returns the same size
+  as \ref placeTickLabel, even before the atlas was set up for a new font.
+*/
+bool QCPAxisPainterPrivate::getGlyphLabelSize(const QFont &font, const QString &text, QSize *size) const
+{
+  if (!qFuzzyIsNull(tickLabelRotation) || (substituteExponent && text.contains(QLatin1Char('e'))))
+    return false;
+  const bool atlasFont = !mGlyphAdvances.isEmpty() && font == mGlyphAtlasFont;
+  QFont metricsFont = font;
+  if (!atlasFont && metricsFont.pointSizeF() > 0) // same correction as in setupGlyphAtlas
+    metricsFont.setPointSizeF(metricsFont.pointSizeF()+0.05);
+  QFontMetrics fontMetrics(metricsFont);
+  int width = 0;
+  for (int i=0; i<text.size(); ++i)
+  {
+    const int index = glyphIndex(text.at(i));
+    if (index < 0)
+      return false;
+    if (atlasFont)
+      width += mGlyphAdvances.at(index);
+    else
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+      width += fontMetrics.horizontalAdvance(text.at(i));
+#else
+      width += fontMetrics.width(text.at(i));
+#endif
+  }
+  *size = QSize(width, atlasFont ? mGlyphHeight : fontMetrics.height());
+  return true;
+}
+
+/*! \internal
+  
+  Draws the tick label \a text glyph by glyph from the glyph atlas, with the top left corner of the
+  label at \a pos. The caller must have checked with \ref getGlyphLabelSize that \a text can be
+  composed.
+*/
+void QCPAxisPainterPrivate::drawGlyphLabel(QCPPainter *painter, const QPointF &pos, const QString &text) const
+{
+  const double pixelRatio = mParentPlot->bufferDevicePixelRatio();
+  double x = pos.x();
+  for (int i=0; i<text.size(); ++i)
+  {
+    const int index = glyphIndex(text.at(i));
+    const QRectF source(mGlyphOffsets.at(index)*pixelRatio, 0, (mGlyphAdvances.at(index)+2)*pixelRatio, mGlyphHeight*pixelRatio);
+    painter->drawPixmap(QPointF(x-1, pos.y()), mGlyphAtlas, source);
+    x += mGlyphAdvances.at(index);
+  }
+}
+
 /*! \internal
   
   Draws a single tick label with the provided \a painter, utilizing the internal label cache to
@@ -9509,7 +10247,29 @@ void QCPAxisPainterPrivate::placeTickLabel(QCPPainter *painter, double position,
     case QCPAxis::atTop:    labelAnchor = QPointF(position, axisRect.top()-distanceToAxis-offset); break;
     case QCPAxis::atBottom: labelAnchor = QPointF(position, axisRect.bottom()+distanceToAxis+offset); break;
   }
-  if (mParentPlot->plottingHints().testFlag(QCP::phCacheLabels) && !painter->modes().testFlag(QCPPainter::pmNoCaching)) // label caching enabled
+  QSize glyphLabelSize;
+  if (mParentPlot->plottingHints().testFlag(QCP::phCacheLabels) && !painter->modes().testFlag(QCPPainter::pmNoCaching) &&
+      !mGlyphAdvances.isEmpty() && getGlyphLabelSize(painter->font(), text, &glyphLabelSize)) // numeric label, compose it from the glyph atlas
+  {
+    TickLabelData labelData;
+    labelData.totalBounds = QRect(QPoint(0, 0), glyphLabelSize);
+    labelData.rotatedTotalBounds = labelData.totalBounds;
+    QPointF finalPosition = labelAnchor + getTickLabelDrawOffset(labelData);
+    // if label would be partly clipped by widget border on sides, don't draw it (only for outside tick labels):
+    bool labelClippedByBorder = false;
+    if (tickLabelSide == QCPAxis::lsOutside)
+    {
+      if (QCPAxis::orientation(type) == Qt::Horizontal)
+        labelClippedByBorder = finalPosition.x()+glyphLabelSize.width() > viewportRect.right() || finalPosition.x() < viewportRect.left();
+      else
+        labelClippedByBorder = finalPosition.y()+glyphLabelSize.height() > viewportRect.bottom() || finalPosition.y() < viewportRect.top();
+    }
+    if (!labelClippedByBorder)
+    {
+      drawGlyphLabel(painter, finalPosition, text);
+      finalSize = glyphLabelSize;
+    }
+  } else if (mParentPlot->plottingHints().testFlag(QCP::phCacheLabels) && !painter->modes().testFlag(QCPPainter::pmNoCaching)) // label caching enabled
   {
     CachedLabel *cachedLabel = mLabelCache.take(text); // attempt to get label from cache
     if (!cachedLabel)  // no cached label existed, create it
@@ -9810,7 +10570,10 @@ void QCPAxisPainterPrivate::getMaxTickLabelSize(const QFont &font, const QString
 {
   // note: this function must return the same tick label sizes as the placeTickLabel function.
   QSize finalSize;
-  if (mParentPlot->plottingHints().testFlag(QCP::phCacheLabels) && mLabelCache.contains(text)) // label caching enabled and have cached label
+  if (mParentPlot->plottingHints().testFlag(QCP::phCacheLabels) && getGlyphLabelSize(font, text, &finalSize)) // label will be composed from the glyph atlas
+  {
+    // finalSize was set by getGlyphLabelSize
+  } else if (mParentPlot->plottingHints().testFlag(QCP::phCacheLabels) && mLabelCache.contains(text)) // label caching enabled and have cached label
   {
     const CachedLabel *cachedLabel = mLabelCache.object(text);
     finalSize = cachedLabel->pixmap.size()/mParentPlot->bufferDevicePixelRatio();
@@ -10735,6 +11498,7 @@ QCPAbstractPlottable::~QCPAbstractPlottable()
 void QCPAbstractPlottable::setName(const QString &name)
 {
   mName = name;
+  markLegendDirty();
 }
 
 /*!
@@ -10770,6 +11534,7 @@ void QCPAbstractPlottable::setAntialiasedScatters(bool enabled)
 void QCPAbstractPlottable::setPen(const QPen &pen)
 {
   mPen = pen;
+  markLegendDirty();
 }
 
 /*!
@@ -10784,6 +11549,7 @@ void QCPAbstractPlottable::setPen(const QPen &pen)
 void QCPAbstractPlottable::setBrush(const QBrush &brush)
 {
   mBrush = brush;
+  markLegendDirty();
 }
 
 /*!
@@ -11231,6 +11997,20 @@ void QCPAbstractPlottable::applyScattersAntialiasingHint(QCPPainter *painter) co
   applyAntialiasingHint(painter, mAntialiasedScatters, QCP::aeScatters);
 }
 
+/*! \internal
+
+  Marks the layer of the default legend (\ref QCustomPlot::legend) dirty, because the legend item
+  of this plottable shows its name and a legend icon drawn with its current style. Called by the
+  setters of properties that appear in the legend.
+
+  \see QCPLayerable::markLayerDirty
+*/
+void QCPAbstractPlottable::markLegendDirty()
+{
+  if (mParentPlot && mParentPlot->legend)
+    mParentPlot->legend->markLayerDirty();
+}
+
 /* inherits documentation from base class */
 void QCPAbstractPlottable::selectEvent(QMouseEvent *event, bool additive, const QVariant &details, bool *selectionStateChanged)
 {
@@ -12887,7 +13667,8 @@ QCustomPlot::QCustomPlot(QWidget *parent) :
   mReplotQueued(false),
   mOpenGlMultisamples(16),
   mOpenGlAntialiasedElementsBackup(QCP::aeNone),
-  mOpenGlCacheLabelsBackup(true)
+  mOpenGlCacheLabelsBackup(true),
+  mStripThreadPool(0)
 {
   setAttribute(Qt::WA_NoMousePropagation);
   setAttribute(Qt::WA_OpaquePaintEvent);
@@ -12993,6 +13774,7 @@ void QCustomPlot::setAntialiasedElements(const QCP::AntialiasedElements &antiali
   // make sure elements aren't in mNotAntialiasedElements and mAntialiasedElements simultaneously:
   if ((mNotAntialiasedElements & mAntialiasedElements) != 0)
     mNotAntialiasedElements |= ~mAntialiasedElements;
+  invalidatePaintBuffers();
 }
 
 /*!
@@ -13012,6 +13794,7 @@ void QCustomPlot::setAntialiasedElement(QCP::AntialiasedElement antialiasedEleme
   // make sure elements aren't in mNotAntialiasedElements and mAntialiasedElements simultaneously:
   if ((mNotAntialiasedElements & mAntialiasedElements) != 0)
     mNotAntialiasedElements |= ~mAntialiasedElements;
+  invalidatePaintBuffers();
 }
 
 /*!
@@ -13039,6 +13822,7 @@ void QCustomPlot::setNotAntialiasedElements(const QCP::AntialiasedElements &notA
   // make sure elements aren't in mNotAntialiasedElements and mAntialiasedElements simultaneously:
   if ((mNotAntialiasedElements & mAntialiasedElements) != 0)
     mAntialiasedElements |= ~mNotAntialiasedElements;
+  invalidatePaintBuffers();
 }
 
 /*!
@@ -13058,6 +13842,7 @@ void QCustomPlot::setNotAntialiasedElement(QCP::AntialiasedElement notAntialiase
   // make sure elements aren't in mNotAntialiasedElements and mAntialiasedElements simultaneously:
   if ((mNotAntialiasedElements & mAntialiasedElements) != 0)
     mAntialiasedElements |= ~mNotAntialiasedElements;
+  invalidatePaintBuffers();
 }
 
 /*!
@@ -13185,6 +13970,7 @@ void QCustomPlot::setNoAntialiasingOnDrag(bool enabled)
 void QCustomPlot::setPlottingHints(const QCP::PlottingHints &hints)
 {
   mPlottingHints = hints;
+  invalidatePaintBuffers();
 }
 
 /*!
@@ -14419,6 +15205,9 @@ void QCustomPlot::deselectAll()
   If a layer is in mode \ref QCPLayer::lmBuffered (\ref QCPLayer::setMode), it is also possible to
   replot only that specific layer via \ref QCPLayer::replot. See the documentation there for
   details.
+
+  If the plotting hint \ref QCP::phDirtyLayers is set, only the paint buffers of dirty layers are
+  cleared and redrawn, see \ref QCPLayer::markDirty.
 */
 void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
 {
@@ -14439,10 +15228,18 @@ void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
   emit beforeReplot();
   
   updateLayout();
-  // draw all layered objects (grid, axes, plottables, items, legend,...) into their buffers:
+  if (mPlottingHints.testFlag(QCP::phDirtyLayers))
+    markChangedLayers();
+  // draw all (dirty) layered objects (grid, axes, plottables, items, legend,...) into their buffers:
   setupPaintBuffers();
   foreach (QCPLayer *layer, mLayers)
-    layer->drawToPaintBuffer();
+  {
+    if (layer->mDirty)
+    {
+      layer->drawToPaintBuffer();
+      layer->mDirty = false;
+    }
+  }
   for (int i=0; i<mPaintBuffers.size(); ++i)
     mPaintBuffers.at(i)->setInvalidated(false);
   
@@ -15067,6 +15864,27 @@ void QCustomPlot::drawBackground(QCPPainter *painter)
   }
 }
 
+/*! \internal
+
+  Marks the layers of axes and grids dirty whose range, axis rect or ticks changed since the last
+  replot (see \ref QCPAxis::ticksChanged). Called by \ref replot after the layout was updated, if
+  the plotting hint \ref QCP::phDirtyLayers is set.
+*/
+void QCustomPlot::markChangedLayers()
+{
+  foreach (QCPAxisRect *rect, axisRects())
+  {
+    foreach (QCPAxis *axis, rect->axes())
+    {
+      if (axis->ticksChanged())
+      {
+        axis->markLayerDirty();
+        axis->grid()->markLayerDirty();
+      }
+    }
+  }
+}
+
 /*! \internal
 
   Goes through the layers and makes sure this QCustomPlot instance holds the correct number of
@@ -15080,7 +15898,13 @@ void QCustomPlot::drawBackground(QCPPainter *painter)
   This method uses \ref createPaintBuffer to create new paint buffers.
 
   After this method, the paint buffers are empty (filled with \c Qt::transparent) and invalidated
-  (so an attempt to replot only a single buffered layer causes a full replot).
+  (so an attempt to replot only a single buffered layer causes a full replot), and all layers are
+  marked dirty.
+
+  If the plotting hint \ref QCP::phDirtyLayers is set and no paint buffer was invalidated since the
+  last replot, only the paint buffers that hold a dirty layer (or a layer with plottables or items,
+  see \ref QCPLayer::hasUntrackedChildren) are cleared, and all layers on them are marked dirty.
+  The other paint buffers keep their contents and their layers aren't redrawn.
 
   This method is called in every \ref replot call, prior to actually drawing the layers (into their
   associated paint buffer). If the paint buffers don't need changing/reallocating, this method
@@ -15089,9 +15913,14 @@ void QCustomPlot::drawBackground(QCPPainter *painter)
 void QCustomPlot::setupPaintBuffers()
 {
   int bufferIndex = 0;
+  bool redrawAll = !mPlottingHints.testFlag(QCP::phDirtyLayers) || hasInvalidatedPaintBuffers(); // layers moved or buffers were reallocated since the last replot
   if (mPaintBuffers.isEmpty())
+  {
     mPaintBuffers.append(QSharedPointer<QCPAbstractPaintBuffer>(createPaintBuffer()));
+    redrawAll = true;
+  }
   
+  QVector<int> layerBuffers(mLayers.size());
   for (int layerIndex = 0; layerIndex < mLayers.size(); ++layerIndex)
   {
     QCPLayer *layer = mLayers.at(layerIndex);
@@ -15102,25 +15931,58 @@ void QCustomPlot::setupPaintBuffers()
     {
       ++bufferIndex;
       if (bufferIndex >= mPaintBuffers.size())
+      {
         mPaintBuffers.append(QSharedPointer<QCPAbstractPaintBuffer>(createPaintBuffer()));
+        redrawAll = true;
+      }
       layer->mPaintBuffer = mPaintBuffers.at(bufferIndex).toWeakRef();
       if (layerIndex < mLayers.size()-1 && mLayers.at(layerIndex+1)->mode() == QCPLayer::lmLogical) // not last layer, and next one is logical, so prepare another buffer for next layerables
       {
+        layerBuffers[layerIndex] = bufferIndex;
         ++bufferIndex;
         if (bufferIndex >= mPaintBuffers.size())
+        {
           mPaintBuffers.append(QSharedPointer<QCPAbstractPaintBuffer>(createPaintBuffer()));
+          redrawAll = true;
+        }
+        continue;
       }
     }
+    layerBuffers[layerIndex] = bufferIndex;
   }
   // remove unneeded buffers:
   while (mPaintBuffers.size()-1 > bufferIndex)
     mPaintBuffers.removeLast();
-  // resize buffers to viewport size and clear contents:
+  // resize buffers to viewport size (won't do anything if already correct size, invalidates otherwise):
   for (int i=0; i<mPaintBuffers.size(); ++i)
   {
-    mPaintBuffers.at(i)->setSize(viewport().size()); // won't do anything if already correct size
-    mPaintBuffers.at(i)->clear(Qt::transparent);
-    mPaintBuffers.at(i)->setInvalidated();
+    mPaintBuffers.at(i)->setSize(viewport().size());
+    redrawAll |= mPaintBuffers.at(i)->invalidated();
+  }
+  // find the buffers that hold a dirty layer:
+  QVector<bool> dirtyBuffers(mPaintBuffers.size(), redrawAll);
+  if (!redrawAll)
+  {
+    for (int layerIndex = 0; layerIndex < mLayers.size(); ++layerIndex)
+    {
+      QCPLayer *layer = mLayers.at(layerIndex);
+      if (layer->mDirty || layer->hasUntrackedChildren())
+        dirtyBuffers[layerBuffers.at(layerIndex)] = true;
+    }
+  }
+  for (int layerIndex = 0; layerIndex < mLayers.size(); ++layerIndex)
+  {
+    if (dirtyBuffers.at(layerBuffers.at(layerIndex)))
+      mLayers.at(layerIndex)->mDirty = true;
+  }
+  // clear contents of the buffers that are redrawn:
+  for (int i=0; i<mPaintBuffers.size(); ++i)
+  {
+    if (dirtyBuffers.at(i))
+    {
+      mPaintBuffers.at(i)->clear(Qt::transparent);
+      mPaintBuffers.at(i)->setInvalidated();
+    }
   }
 }
 
@@ -15169,6 +16031,19 @@ bool QCustomPlot::hasInvalidatedPaintBuffers()
   return false;
 }
 
+/*! \internal
+
+  Invalidates all paint buffers, so the next \ref replot redraws all layers even if the plotting
+  hint \ref QCP::phDirtyLayers is set, and \ref QCPLayer::replot causes a full replot until then.
+  This is used for changes that may affect layerables on any layer, e.g. of the antialiasing
+  overrides or of the visibility of a parent layerable.
+*/
+void QCustomPlot::invalidatePaintBuffers()
+{
+  for (int i=0; i<mPaintBuffers.size(); ++i)
+    mPaintBuffers.at(i)->setInvalidated();
+}
+
 /*! \internal
 
   When \ref setOpenGl is set to true, this method is used to initialize OpenGL (create a context,
@@ -15919,6 +16794,10 @@ void QCPColorGradient::setPeriodic(bool enabled)
   array, in \a scanLine. \a scanLine will remain a regular (1D) array. This works because \a data
   is addressed <tt>data[i*dataIndexFactor]</tt>.
   
+  NaN values, and values outside the domain of the logarithm if \a logarithmic is true, get the
+  lowest color of the gradient. Infinite values are clamped like any other value outside of \a
+  range (periodic gradients map them to the lowest color, too).
+  
   Use the overloaded method to additionally provide alpha map data.
 
   The QRgb values that are placed in \a scanLine have their r, g and b components premultiplied
@@ -15926,7 +16805,6 @@ void QCPColorGradient::setPeriodic(bool enabled)
 */
 void QCPColorGradient::colorize(const double *data, const QCPRange &range, QRgb *scanLine, int n, int dataIndexFactor, bool logarithmic)
 {
-  // If you change something here, make sure to also adapt color() and the other colorize() overload
   if (!data)
   {
     qDebug() << Q_FUNC_INFO << "null pointer given as data";
@@ -15940,53 +16818,14 @@ void QCPColorGradient::colorize(const double *data, const QCPRange &range, QRgb
   if (mColorBufferInvalidated)
     updateColorBuffer();
   
-  if (!logarithmic)
-  {
-    const double posToIndexFactor = (mLevelCount-1)/range.size();
-    if (mPeriodic)
-    {
-      for (int i=0; i<n; ++i)
-      {
-        int index = (int)((data[dataIndexFactor*i]-range.lower)*posToIndexFactor) % mLevelCount;
-        if (index < 0)
-          index += mLevelCount;
-        scanLine[i] = mColorBuffer.at(index);
-      }
-    } else
-    {
-      for (int i=0; i<n; ++i)
-      {
-        int index = (data[dataIndexFactor*i]-range.lower)*posToIndexFactor;
-        if (index < 0)
-          index = 0;
-        else if (index >= mLevelCount)
-          index = mLevelCount-1;
-        scanLine[i] = mColorBuffer.at(index);
-      }
-    }
-  } else // logarithmic == true
+  const QRgb *colors = mColorBuffer.constData();
+  int indices[256];
+  for (int start=0; start<n; start+=256)
   {
-    if (mPeriodic)
-    {
-      for (int i=0; i<n; ++i)
-      {
-        int index = (int)(qLn(data[dataIndexFactor*i]/range.lower)/qLn(range.upper/range.lower)*(mLevelCount-1)) % mLevelCount;
-        if (index < 0)
-          index += mLevelCount;
-        scanLine[i] = mColorBuffer.at(index);
-      }
-    } else
-    {
-      for (int i=0; i<n; ++i)
-      {
-        int index = qLn(data[dataIndexFactor*i]/range.lower)/qLn(range.upper/range.lower)*(mLevelCount-1);
-        if (index < 0)
-          index = 0;
-        else if (index >= mLevelCount)
-          index = mLevelCount-1;
-        scanLine[i] = mColorBuffer.at(index);
-      }
-    }
+    const int count = qMin(256, n-start);
+    colorIndices(data+dataIndexFactor*start, range, indices, count, dataIndexFactor, logarithmic);
+    for (int i=0; i<count; ++i)
+      scanLine[start+i] = colors[indices[i]];
   }
 }
 
@@ -16000,7 +16839,6 @@ void QCPColorGradient::colorize(const double *data, const QCPRange &range, QRgb
 */
 void QCPColorGradient::colorize(const double *data, const unsigned char *alpha, const QCPRange &range, QRgb *scanLine, int n, int dataIndexFactor, bool logarithmic)
 {
-  // If you change something here, make sure to also adapt color() and the other colorize() overload
   if (!data)
   {
     qDebug() << Q_FUNC_INFO << "null pointer given as data";
@@ -16019,83 +16857,24 @@ void QCPColorGradient::colorize(const double *data, const unsigned char *alpha,
   if (mColorBufferInvalidated)
     updateColorBuffer();
   
-  if (!logarithmic)
-  {
-    const double posToIndexFactor = (mLevelCount-1)/range.size();
-    if (mPeriodic)
-    {
-      for (int i=0; i<n; ++i)
-      {
-        int index = (int)((data[dataIndexFactor*i]-range.lower)*posToIndexFactor) % mLevelCount;
-        if (index < 0)
-          index += mLevelCount;
-        if (alpha[dataIndexFactor*i] == 255)
-        {
-          scanLine[i] = mColorBuffer.at(index);
-        } else
-        {
-          const QRgb rgb = mColorBuffer.at(index);
-          const float alphaF = alpha[dataIndexFactor*i]/255.0f;
-          scanLine[i] = qRgba(qRed(rgb)*alphaF, qGreen(rgb)*alphaF, qBlue(rgb)*alphaF, qAlpha(rgb)*alphaF);
-        }
-      }
-    } else
-    {
-      for (int i=0; i<n; ++i)
-      {
-        int index = (data[dataIndexFactor*i]-range.lower)*posToIndexFactor;
-        if (index < 0)
-          index = 0;
-        else if (index >= mLevelCount)
-          index = mLevelCount-1;
-        if (alpha[dataIndexFactor*i] == 255)
-        {
-          scanLine[i] = mColorBuffer.at(index);
-        } else
-        {
-          const QRgb rgb = mColorBuffer.at(index);
-          const float alphaF = alpha[dataIndexFactor*i]/255.0f;
-          scanLine[i] = qRgba(qRed(rgb)*alphaF, qGreen(rgb)*alphaF, qBlue(rgb)*alphaF, qAlpha(rgb)*alphaF);
-        }
-      }
-    }
-  } else // logarithmic == true
+  const QRgb *colors = mColorBuffer.constData();
+  int indices[256];
+  for (int start=0; start<n; start+=256)
   {
-    if (mPeriodic)
+    const int count = qMin(256, n-start);
+    colorIndices(data+dataIndexFactor*start, range, indices, count, dataIndexFactor, logarithmic);
+    const unsigned char *alphaStart = alpha+dataIndexFactor*start;
+    for (int i=0; i<count; ++i)
     {
-      for (int i=0; i<n; ++i)
+      const QRgb rgb = colors[indices[i]];
+      const unsigned char a = alphaStart[dataIndexFactor*i];
+      if (a == 255)
       {
-        int index = (int)(qLn(data[dataIndexFactor*i]/range.lower)/qLn(range.upper/range.lower)*(mLevelCount-1)) % mLevelCount;
-        if (index < 0)
-          index += mLevelCount;
-        if (alpha[dataIndexFactor*i] == 255)
-        {
-          scanLine[i] = mColorBuffer.at(index);
-        } else
-        {
-          const QRgb rgb = mColorBuffer.at(index);
-          const float alphaF = alpha[dataIndexFactor*i]/255.0f;
-          scanLine[i] = qRgba(qRed(rgb)*alphaF, qGreen(rgb)*alphaF, qBlue(rgb)*alphaF, qAlpha(rgb)*alphaF);
-        }
-      }
-    } else
-    {
-      for (int i=0; i<n; ++i)
+        scanLine[start+i] = rgb;
+      } else
       {
-        int index = qLn(data[dataIndexFactor*i]/range.lower)/qLn(range.upper/range.lower)*(mLevelCount-1);
-        if (index < 0)
-          index = 0;
-        else if (index >= mLevelCount)
-          index = mLevelCount-1;
-        if (alpha[dataIndexFactor*i] == 255)
-        {
-          scanLine[i] = mColorBuffer.at(index);
-        } else
-        {
-          const QRgb rgb = mColorBuffer.at(index);
-          const float alphaF = alpha[dataIndexFactor*i]/255.0f;
-          scanLine[i] = qRgba(qRed(rgb)*alphaF, qGreen(rgb)*alphaF, qBlue(rgb)*alphaF, qAlpha(rgb)*alphaF);
-        }
+        const float alphaF = a/255.0f;
+        scanLine[start+i] = qRgba(qRed(rgb)*alphaF, qGreen(rgb)*alphaF, qBlue(rgb)*alphaF, qAlpha(rgb)*alphaF);
       }
     }
   }
@@ -16115,27 +16894,126 @@ void QCPColorGradient::colorize(const double *data, const unsigned char *alpha,
 */
 QRgb QCPColorGradient::color(double position, const QCPRange &range, bool logarithmic)
 {
-  // If you change something here, make sure to also adapt ::colorize()
   if (mColorBufferInvalidated)
     updateColorBuffer();
   int index = 0;
+  colorIndices(&position, range, &index, 1, 1, logarithmic);
+  return mColorBuffer.at(index);
+}
+
+#ifdef QCP_SSE2
+/*! \internal
+
+  Returns the natural logarithm of the two positive values in \a x. The exponent is taken from the
+  bits of the double, the logarithm of the mantissa (scaled to [sqrt(1/2), sqrt(2))) is the series
+  2*atanh((m-1)/(m+1)), which is accurate to about 1e-9 with five terms.
+
+  Zero gives -inf, negative values and NaN give NaN, like qLn. Infinity and denormals give
+  finite approximations, which is good enough for finding a gradient level.
+*/
+static inline __m128d qcpLnPd(__m128d x)
+{
+  const __m128d one = _mm_set1_pd(1.0);
+  const __m128d mantissaMask = _mm_castsi128_pd(_mm_set_epi32(0x000FFFFF, 0xFFFFFFFF, 0x000FFFFF, 0xFFFFFFFF));
+  // biased exponents of both values, moved to the lower two 32 bit lanes:
+  const __m128i exponentBits = _mm_shuffle_epi32(_mm_srli_epi64(_mm_castpd_si128(x), 52), _MM_SHUFFLE(3, 3, 2, 0));
+  __m128d exponent = _mm_sub_pd(_mm_cvtepi32_pd(exponentBits), _mm_set1_pd(1023.0));
+  __m128d mantissa = _mm_or_pd(_mm_and_pd(x, mantissaMask), one); // in [1, 2)
+  const __m128d above = _mm_cmpgt_pd(mantissa, _mm_set1_pd(M_SQRT2));
+  mantissa = _mm_sub_pd(mantissa, _mm_and_pd(above, _mm_mul_pd(mantissa, _mm_set1_pd(0.5))));
+  exponent = _mm_add_pd(exponent, _mm_and_pd(above, one));
+  const __m128d s = _mm_div_pd(_mm_sub_pd(mantissa, one), _mm_add_pd(mantissa, one));
+  const __m128d s2 = _mm_mul_pd(s, s);
+  __m128d series = _mm_add_pd(_mm_mul_pd(s2, _mm_set1_pd(2.0/9.0)), _mm_set1_pd(2.0/7.0));
+  series = _mm_add_pd(_mm_mul_pd(s2, series), _mm_set1_pd(2.0/5.0));
+  series = _mm_add_pd(_mm_mul_pd(s2, series), _mm_set1_pd(2.0/3.0));
+  series = _mm_add_pd(_mm_mul_pd(s2, series), _mm_set1_pd(2.0));
+  const __m128d result = _mm_add_pd(_mm_mul_pd(exponent, _mm_set1_pd(M_LN2)), _mm_mul_pd(s, series));
+  // values outside the domain:
+  const __m128d positive = _mm_cmpgt_pd(x, _mm_setzero_pd());
+  const __m128d zero = _mm_cmpeq_pd(x, _mm_setzero_pd());
+  const __m128d outside = _mm_or_pd(_mm_and_pd(zero, _mm_set1_pd(-std::numeric_limits<double>::infinity())),
+                                    _mm_andnot_pd(zero, _mm_set1_pd(std::numeric_limits<double>::quiet_NaN())));
+  return _mm_or_pd(_mm_and_pd(positive, result), _mm_andnot_pd(positive, outside));
+}
+#endif
+
+/*! \internal
+
+  Converts the \a n values in \a data (addressed <tt>data[i*dataIndexFactor]</tt>) to indices of
+  \ref mColorBuffer and writes them to \a indices. This is the common part of \ref colorize and
+  \ref color.
+  
+  The mapping factor (and the logarithm of the range boundary) is computed once for all values.
+  Non-periodic gradients are converted four values at a time with SSE2 if available, using \ref
+  qcpLnPd instead of qLn in the logarithmic case. NaN values and values outside the domain of the
+  logarithm map to index 0, all other values are clamped to the valid index range before the
+  conversion to int, so the conversion can't overflow.
+*/
+void QCPColorGradient::colorIndices(const double *data, const QCPRange &range, int *indices, int n, int dataIndexFactor, bool logarithmic) const
+{
+  const int maxIndex = mLevelCount-1;
+  // index = (f(sign*value)-offset)*factor, with f the identity or the natural logarithm:
+  double sign = 1, offset, factor;
   if (!logarithmic)
-    index = (position-range.lower)*(mLevelCount-1)/range.size();
-  else
-    index = qLn(position/range.lower)/qLn(range.upper/range.lower)*(mLevelCount-1);
-  if (mPeriodic)
   {
-    index = index % mLevelCount;
-    if (index < 0)
-      index += mLevelCount;
+    offset = range.lower;
+    factor = maxIndex/range.size();
   } else
   {
-    if (index < 0)
-      index = 0;
-    else if (index >= mLevelCount)
-      index = mLevelCount-1;
+    if (range.lower < 0) // logarithmic ranges may be entirely negative
+      sign = -1;
+    offset = qLn(sign*range.lower);
+    factor = maxIndex/qLn(range.upper/range.lower);
+  }
+  
+  int i = 0;
+  if (mPeriodic)
+  {
+    // bound to a multiple of the level count, so the int conversion can't overflow and non-finite values map to index 0:
+    const double bound = mLevelCount*double((1<<30)/mLevelCount);
+    for (; i<n; ++i)
+    {
+      const double value = data[dataIndexFactor*i];
+      const double position = ((logarithmic ? qLn(sign*value) : value)-offset)*factor;
+      int index = int(qBound(-bound, position, bound)) % mLevelCount;
+      if (index < 0)
+        index += mLevelCount;
+      indices[i] = index;
+    }
+    return;
+  }
+  
+#ifdef QCP_SSE2
+  const __m128d sign2 = _mm_set1_pd(sign);
+  const __m128d offset2 = _mm_set1_pd(offset);
+  const __m128d factor2 = _mm_set1_pd(factor);
+  const __m128d minIndex2 = _mm_setzero_pd();
+  const __m128d maxIndex2 = _mm_set1_pd(maxIndex);
+  for (; i+4 <= n; i+=4)
+  {
+    const double *values = data+dataIndexFactor*i;
+    __m128d v0 = _mm_loadh_pd(_mm_load_sd(values), values+dataIndexFactor);
+    __m128d v1 = _mm_loadh_pd(_mm_load_sd(values+2*dataIndexFactor), values+3*dataIndexFactor);
+    if (logarithmic)
+    {
+      v0 = qcpLnPd(_mm_mul_pd(v0, sign2));
+      v1 = qcpLnPd(_mm_mul_pd(v1, sign2));
+    }
+    v0 = _mm_mul_pd(_mm_sub_pd(v0, offset2), factor2);
+    v1 = _mm_mul_pd(_mm_sub_pd(v1, offset2), factor2);
+    // max returns the second operand if the first one is NaN, so NaN maps to index 0:
+    v0 = _mm_min_pd(_mm_max_pd(v0, minIndex2), maxIndex2);
+    v1 = _mm_min_pd(_mm_max_pd(v1, minIndex2), maxIndex2);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(indices+i), _mm_unpacklo_epi64(_mm_cvttpd_epi32(v0), _mm_cvttpd_epi32(v1)));
+  }
+#endif
+  for (; i<n; ++i)
+  {
+    const double value = data[dataIndexFactor*i];
+    const double position = ((logarithmic ? qLn(sign*value) : value)-offset)*factor;
+    indices[i] = position > 0 ? (position < maxIndex ? int(position) : maxIndex) : 0; // comparisons with NaN are false, so NaN maps to index 0
   }
-  return mColorBuffer.at(index);
 }
 
 /*!
@@ -17321,6 +18199,7 @@ void QCPAxisRect::draw(QCPPainter *painter)
 */
 void QCPAxisRect::setBackground(const QPixmap &pm)
 {
+  markLayerDirty();
   mBackgroundPixmap = pm;
   mScaledBackgroundPixmap = QPixmap();
 }
@@ -17340,6 +18219,7 @@ void QCPAxisRect::setBackground(const QPixmap &pm)
 */
 void QCPAxisRect::setBackground(const QBrush &brush)
 {
+  markLayerDirty();
   mBackgroundBrush = brush;
 }
 
@@ -17352,6 +18232,7 @@ void QCPAxisRect::setBackground(const QBrush &brush)
 */
 void QCPAxisRect::setBackground(const QPixmap &pm, bool scaled, Qt::AspectRatioMode mode)
 {
+  markLayerDirty();
   mBackgroundPixmap = pm;
   mScaledBackgroundPixmap = QPixmap();
   mBackgroundScaled = scaled;
@@ -17370,6 +18251,7 @@ void QCPAxisRect::setBackground(const QPixmap &pm, bool scaled, Qt::AspectRatioM
 */
 void QCPAxisRect::setBackgroundScaled(bool scaled)
 {
+  markLayerDirty();
   mBackgroundScaled = scaled;
 }
 
@@ -17380,6 +18262,7 @@ void QCPAxisRect::setBackgroundScaled(bool scaled)
 */
 void QCPAxisRect::setBackgroundScaledMode(Qt::AspectRatioMode mode)
 {
+  markLayerDirty();
   mBackgroundScaledMode = mode;
 }
 
@@ -18024,6 +18907,7 @@ QCPAbstractLegendItem::QCPAbstractLegendItem(QCPLegend *parent) :
 */
 void QCPAbstractLegendItem::setFont(const QFont &font)
 {
+  markLayerDirty();
   mFont = font;
 }
 
@@ -18034,6 +18918,7 @@ void QCPAbstractLegendItem::setFont(const QFont &font)
 */
 void QCPAbstractLegendItem::setTextColor(const QColor &color)
 {
+  markLayerDirty();
   mTextColor = color;
 }
 
@@ -18045,6 +18930,7 @@ void QCPAbstractLegendItem::setTextColor(const QColor &color)
 */
 void QCPAbstractLegendItem::setSelectedFont(const QFont &font)
 {
+  markLayerDirty();
   mSelectedFont = font;
 }
 
@@ -18056,6 +18942,7 @@ void QCPAbstractLegendItem::setSelectedFont(const QFont &font)
 */
 void QCPAbstractLegendItem::setSelectedTextColor(const QColor &color)
 {
+  markLayerDirty();
   mSelectedTextColor = color;
 }
 
@@ -18083,6 +18970,7 @@ void QCPAbstractLegendItem::setSelectable(bool selectable)
 */
 void QCPAbstractLegendItem::setSelected(bool selected)
 {
+  markLayerDirty();
   if (mSelected != selected)
   {
     mSelected = selected;
@@ -18381,6 +19269,7 @@ QCPLegend::SelectableParts QCPLegend::selectedParts() const
 */
 void QCPLegend::setBorderPen(const QPen &pen)
 {
+  markLayerDirty();
   mBorderPen = pen;
 }
 
@@ -18389,6 +19278,7 @@ void QCPLegend::setBorderPen(const QPen &pen)
 */
 void QCPLegend::setBrush(const QBrush &brush)
 {
+  markLayerDirty();
   mBrush = brush;
 }
 
@@ -18403,6 +19293,7 @@ void QCPLegend::setBrush(const QBrush &brush)
 */
 void QCPLegend::setFont(const QFont &font)
 {
+  markLayerDirty();
   mFont = font;
   for (int i=0; i<itemCount(); ++i)
   {
@@ -18422,6 +19313,7 @@ void QCPLegend::setFont(const QFont &font)
 */
 void QCPLegend::setTextColor(const QColor &color)
 {
+  markLayerDirty();
   mTextColor = color;
   for (int i=0; i<itemCount(); ++i)
   {
@@ -18436,6 +19328,7 @@ void QCPLegend::setTextColor(const QColor &color)
 */
 void QCPLegend::setIconSize(const QSize &size)
 {
+  markLayerDirty();
   mIconSize = size;
 }
 
@@ -18443,6 +19336,7 @@ void QCPLegend::setIconSize(const QSize &size)
 */
 void QCPLegend::setIconSize(int width, int height)
 {
+  markLayerDirty();
   mIconSize.setWidth(width);
   mIconSize.setHeight(height);
 }
@@ -18454,6 +19348,7 @@ void QCPLegend::setIconSize(int width, int height)
 */
 void QCPLegend::setIconTextPadding(int padding)
 {
+  markLayerDirty();
   mIconTextPadding = padding;
 }
 
@@ -18465,6 +19360,7 @@ void QCPLegend::setIconTextPadding(int padding)
 */
 void QCPLegend::setIconBorderPen(const QPen &pen)
 {
+  markLayerDirty();
   mIconBorderPen = pen;
 }
 
@@ -18510,6 +19406,7 @@ void QCPLegend::setSelectableParts(const SelectableParts &selectable)
 */
 void QCPLegend::setSelectedParts(const SelectableParts &selected)
 {
+  markLayerDirty();
   SelectableParts newSelected = selected;
   mSelectedParts = this->selectedParts(); // update mSelectedParts in case item selection changed
 
@@ -18541,6 +19438,7 @@ void QCPLegend::setSelectedParts(const SelectableParts &selected)
 */
 void QCPLegend::setSelectedBorderPen(const QPen &pen)
 {
+  markLayerDirty();
   mSelectedBorderPen = pen;
 }
 
@@ -18551,6 +19449,7 @@ void QCPLegend::setSelectedBorderPen(const QPen &pen)
 */
 void QCPLegend::setSelectedIconBorderPen(const QPen &pen)
 {
+  markLayerDirty();
   mSelectedIconBorderPen = pen;
 }
 
@@ -18562,6 +19461,7 @@ void QCPLegend::setSelectedIconBorderPen(const QPen &pen)
 */
 void QCPLegend::setSelectedBrush(const QBrush &brush)
 {
+  markLayerDirty();
   mSelectedBrush = brush;
 }
 
@@ -18574,6 +19474,7 @@ void QCPLegend::setSelectedBrush(const QBrush &brush)
 */
 void QCPLegend::setSelectedFont(const QFont &font)
 {
+  markLayerDirty();
   mSelectedFont = font;
   for (int i=0; i<itemCount(); ++i)
   {
@@ -18591,6 +19492,7 @@ void QCPLegend::setSelectedFont(const QFont &font)
 */
 void QCPLegend::setSelectedTextColor(const QColor &color)
 {
+  markLayerDirty();
   mSelectedTextColor = color;
   for (int i=0; i<itemCount(); ++i)
   {
@@ -19040,6 +19942,7 @@ QCPTextElement::QCPTextElement(QCustomPlot *parentPlot, const QString &text, con
 */
 void QCPTextElement::setText(const QString &text)
 {
+  markLayerDirty();
   mText = text;
 }
 
@@ -19065,6 +19968,7 @@ void QCPTextElement::setText(const QString &text)
 */
 void QCPTextElement::setTextFlags(int flags)
 {
+  markLayerDirty();
   mTextFlags = flags;
 }
 
@@ -19075,6 +19979,7 @@ void QCPTextElement::setTextFlags(int flags)
 */
 void QCPTextElement::setFont(const QFont &font)
 {
+  markLayerDirty();
   mFont = font;
 }
 
@@ -19085,6 +19990,7 @@ void QCPTextElement::setFont(const QFont &font)
 */
 void QCPTextElement::setTextColor(const QColor &color)
 {
+  markLayerDirty();
   mTextColor = color;
 }
 
@@ -19095,6 +20001,7 @@ void QCPTextElement::setTextColor(const QColor &color)
 */
 void QCPTextElement::setSelectedFont(const QFont &font)
 {
+  markLayerDirty();
   mSelectedFont = font;
 }
 
@@ -19105,6 +20012,7 @@ void QCPTextElement::setSelectedFont(const QFont &font)
 */
 void QCPTextElement::setSelectedTextColor(const QColor &color)
 {
+  markLayerDirty();
   mSelectedTextColor = color;
 }
 
@@ -19132,6 +20040,7 @@ void QCPTextElement::setSelectable(bool selectable)
 */
 void QCPTextElement::setSelected(bool selected)
 {
+  markLayerDirty();
   if (mSelected != selected)
   {
     mSelected = selected;
@@ -19800,6 +20709,7 @@ QCPColorScaleAxisRectPrivate::QCPColorScaleAxisRectPrivate(QCPColorScale *parent
   mParentColorScale(parentColorScale),
   mGradientImageInvalidated(true)
 {
+  mMarksLayerDirty = false; // gradient and data range are set on the color scale without notice
   setParentLayerable(parentColorScale);
   setMinimumMargins(QMargins(0, 0, 0, 0));
   QList<QCPAxis::AxisType> allAxisTypes = QList<QCPAxis::AxisType>() << QCPAxis::atBottom << QCPAxis::atTop << QCPAxis::atLeft << QCPAxis::atRight;
@@ -20142,6 +21052,7 @@ QCPGraph::~QCPGraph()
 void QCPGraph::setData(QSharedPointer<QCPGraphDataContainer> data)
 {
   mDataContainer = data;
+  invalidateGeometryCache();
 }
 
 /*! \overload
@@ -20170,6 +21081,8 @@ void QCPGraph::setData(const QVector<double> &keys, const QVector<double> &value
 void QCPGraph::setLineStyle(LineStyle ls)
 {
   mLineStyle = ls;
+  invalidateGeometryCache();
+  markLegendDirty();
 }
 
 /*!
@@ -20181,6 +21094,8 @@ void QCPGraph::setLineStyle(LineStyle ls)
 void QCPGraph::setScatterStyle(const QCPScatterStyle &style)
 {
   mScatterStyle = style;
+  invalidateGeometryCache(); // scatter size influences adaptive sampling of scatters
+  markLegendDirty();
 }
 
 /*!
@@ -20197,6 +21112,7 @@ void QCPGraph::setScatterStyle(const QCPScatterStyle &style)
 void QCPGraph::setScatterSkip(int skip)
 {
   mScatterSkip = qMax(0, skip);
+  invalidateGeometryCache();
 }
 
 /*!
@@ -20262,6 +21178,7 @@ void QCPGraph::setChannelFillGraph(QCPGraph *targetGraph)
 void QCPGraph::setAdaptiveSampling(bool enabled)
 {
   mAdaptiveSampling = enabled;
+  invalidateGeometryCache();
 }
 
 /*! \overload
@@ -20355,18 +21272,15 @@ void QCPGraph::draw(QCPPainter *painter)
   if (mKeyAxis.data()->range().size() <= 0 || mDataContainer->isEmpty()) return;
   if (mLineStyle == lsNone && mScatterStyle.isNone()) return;
   
-  QVector<QPointF> lines, scatters; // line and (if necessary) scatter pixel coordinates will be stored here while iterating over segments
+  // line and scatter pixel coordinates are only recomputed if axes, data or selection changed since the last draw:
+  updateGeometryCache();
   
   // loop over and draw segments of unselected/selected data:
-  QList<QCPDataRange> selectedSegments, unselectedSegments, allSegments;
-  getDataSegments(selectedSegments, unselectedSegments);
-  allSegments << unselectedSegments << selectedSegments;
+  const QList<QCPDataRange> &allSegments = mGeometryCache.segments;
   for (int i=0; i<allSegments.size(); ++i)
   {
-    bool isSelectedSegment = i >= unselectedSegments.size();
-    // get line pixel points appropriate to line style:
-    QCPDataRange lineDataRange = isSelectedSegment ? allSegments.at(i) : allSegments.at(i).adjusted(-1, 1); // unselected segments extend lines to bordering selected data point (safe to exceed total data bounds in first/last segment, getLines takes care)
-    getLines(&lines, lineDataRange);
+    bool isSelectedSegment = i >= mGeometryCache.unselectedCount;
+    QVector<QPointF> lines = mGeometryCache.lines.at(i); // implicitly shared, no copy
     
     // check data validity if flag set:
 #ifdef QCUSTOMPLOT_CHECK_DATA
@@ -20406,8 +21320,17 @@ void QCPGraph::draw(QCPPainter *painter)
       finalScatterStyle = mSelectionDecorator->getFinalScatterStyle(mScatterStyle);
     if (!finalScatterStyle.isNone())
     {
-      getScatters(&scatters, allSegments.at(i));
-      drawScatterPlot(painter, scatters, finalScatterStyle);
+      // the cache has no scatters if the selection decorator's scatter style was set after it was built. They are computed
+      // into a local vector then, draw must not write the cache (see QCPLayer::drawParallel):
+      if (mGeometryCache.scattersValid.at(i))
+      {
+        drawScatterPlot(painter, mGeometryCache.scatters.at(i), finalScatterStyle);
+      } else
+      {
+        QVector<QPointF> scatters;
+        getScatters(&scatters, allSegments.at(i));
+        drawScatterPlot(painter, scatters, finalScatterStyle);
+      }
     }
   }
   
@@ -20858,6 +21781,9 @@ void QCPGraph::drawScatterPlot(QCPPainter *painter, const QVector<QPointF> &scat
   
   Draws lines between the points in \a lines, given in pixel coordinates.
   
+  One pixel wide aliased lines on the software paint buffer are written directly into the buffer
+  image by \ref QCPPainter::drawPolylineRaster, bypassing the QPainter line pipeline.
+  
   \see drawScatterPlot, drawImpulsePlot, QCPAbstractPlottable1D::drawPolyline
 */
 void QCPGraph::drawLinePlot(QCPPainter *painter, const QVector<QPointF> &lines) const
@@ -20865,7 +21791,8 @@ void QCPGraph::drawLinePlot(QCPPainter *painter, const QVector<QPointF> &lines)
   if (painter->pen().style() != Qt::NoPen && painter->pen().color().alpha() != 0)
   {
     applyDefaultAntialiasingHint(painter);
-    drawPolyline(painter, lines);
+    if (!painter->drawPolylineRaster(lines))
+      drawPolyline(painter, lines);
   }
 }
 
@@ -21463,159 +22390,205 @@ const QPolygonF QCPGraph::getChannelFillPolygon(const QVector<QPointF> *thisData
   if (mChannelFillGraph.data()->mKeyAxis.data()->orientation() != keyAxis->orientation())
     return QPolygonF(); // don't have same axis orientation, can't fill that (Note: if keyAxis fits, valueAxis will fit too, because it's always orthogonal to keyAxis)
   
-  if (thisData->isEmpty()) return QPolygonF();
-  QVector<QPointF> thisSegmentData(thisSegment.size());
-  QVector<QPointF> otherSegmentData(otherSegment.size());
-  std::copy(thisData->constBegin()+thisSegment.begin(), thisData->constBegin()+thisSegment.end(), thisSegmentData.begin());
-  std::copy(otherData->constBegin()+otherSegment.begin(), otherData->constBegin()+otherSegment.end(), otherSegmentData.begin());
+  if (thisData->isEmpty() || thisSegment.isEmpty() || otherSegment.isEmpty()) return QPolygonF();
+  
+  // The segments aren't copied, cropping only moves the begin/end indices of a side. The points at
+  // the cropped ends are replaced by interpolated ones, which are kept in first/last:
+  struct Side
+  {
+    const QVector<QPointF> *data;
+    int begin, end;
+    QPointF first, last;
+    QPointF at(int i) const { return i == begin ? first : (i == end-1 ? last : data->at(i)); }
+  };
+  Side thisSide = {thisData, thisSegment.begin(), thisSegment.end(), thisData->at(thisSegment.begin()), thisData->at(thisSegment.end()-1)};
+  Side otherSide = {otherData, otherSegment.begin(), otherSegment.end(), otherData->at(otherSegment.begin()), otherData->at(otherSegment.end()-1)};
   // pointers to be able to swap them, depending which data range needs cropping:
-  QVector<QPointF> *staticData = &thisSegmentData;
-  QVector<QPointF> *croppedData = &otherSegmentData;
+  Side *staticSide = &thisSide;
+  Side *croppedSide = &otherSide;
+  
+  // crop both sides to ranges in which the keys overlap (which coord is key, depends on axisType):
+  struct Coords
+  {
+    bool keyIsX;
+    double key(const QPointF &point) const { return keyIsX ? point.x() : point.y(); }
+    double value(const QPointF &point) const { return keyIsX ? point.y() : point.x(); }
+    QPointF point(double key, double value) const { return keyIsX ? QPointF(key, value) : QPointF(value, key); }
+  };
+  const Coords c = {keyAxis->orientation() == Qt::Horizontal};
+  
+  // crop lower bound:
+  if (c.key(staticSide->first) < c.key(croppedSide->first)) // other one must be cropped
+    qSwap(staticSide, croppedSide);
+  const double lowKey = c.key(staticSide->first);
+  const int aboveLow = findKeyPixelBound(croppedSide->data, lowKey, true, croppedSide->begin, croppedSide->end); // first point with key above lowKey
+  if (aboveLow == croppedSide->end) return QPolygonF(); // key ranges have no overlap
+  croppedSide->begin = qMax(aboveLow-1, croppedSide->begin);
+  // set lowest point of cropped data to fit exactly key position of first static data point via linear interpolation:
+  if (croppedSide->end-croppedSide->begin < 2) return QPolygonF(); // need at least two points for interpolation
+  const QPointF low0 = croppedSide->data->at(croppedSide->begin);
+  const QPointF low1 = croppedSide->data->at(croppedSide->begin+1);
+  double slope;
+  if (!qFuzzyCompare(c.key(low1), c.key(low0))) // avoid division by zero in step plots
+    slope = (c.value(low1)-c.value(low0))/(c.key(low1)-c.key(low0));
+  else
+    slope = 0;
+  const double lowValue = c.value(low0)+slope*(lowKey-c.key(low0));
+  croppedSide->first = c.point(lowKey, lowValue);
+  
+  // crop upper bound:
+  if (c.key(staticSide->at(staticSide->end-1)) > c.key(croppedSide->at(croppedSide->end-1))) // other one must be cropped
+    qSwap(staticSide, croppedSide);
+  const double highKey = c.key(staticSide->at(staticSide->end-1));
+  // first point with key not below highKey, the first point is searched separately because it may have been moved by the lower crop:
+  int belowHigh = findKeyPixelBound(croppedSide->data, highKey, false, croppedSide->begin+1, croppedSide->end);
+  if (belowHigh == croppedSide->begin+1 && c.key(croppedSide->first) >= highKey)
+    belowHigh = croppedSide->begin;
+  if (belowHigh == croppedSide->begin) return QPolygonF(); // key ranges have no overlap
+  croppedSide->end = qMin(belowHigh, croppedSide->end-1)+1;
+  // set highest point of cropped data to fit exactly key position of last static data point via linear interpolation:
+  if (croppedSide->end-croppedSide->begin < 2) return QPolygonF(); // need at least two points for interpolation
+  croppedSide->last = croppedSide->data->at(croppedSide->end-1);
+  const QPointF high0 = croppedSide->at(croppedSide->end-2);
+  const QPointF high1 = croppedSide->last;
+  if (!qFuzzyCompare(c.key(high1), c.key(high0))) // avoid division by zero in step plots
+    slope = (c.value(high1)-c.value(high0))/(c.key(high1)-c.key(high0));
+  else
+    slope = 0;
+  const double highValue = c.value(high0)+slope*(highKey-c.key(high0));
+  croppedSide->last = c.point(highKey, highValue);
   
-  // crop both vectors to ranges in which the keys overlap (which coord is key, depends on axisType):
-  if (keyAxis->orientation() == Qt::Horizontal)
+  // return joined, other side reversed, otherwise the polygon will be twisted:
+  QPolygonF result(thisSide.end-thisSide.begin + otherSide.end-otherSide.begin);
+  QPointF *out = result.data();
+  *out++ = thisSide.first;
+  if (thisSide.end-thisSide.begin > 1)
   {
-    // x is key
-    // crop lower bound:
-    if (staticData->first().x() < croppedData->first().x()) // other one must be cropped
-      qSwap(staticData, croppedData);
-    const int lowBound = findIndexBelowX(croppedData, staticData->first().x());
-    if (lowBound == -1) return QPolygonF(); // key ranges have no overlap
-    croppedData->remove(0, lowBound);
-    // set lowest point of cropped data to fit exactly key position of first static data point via linear interpolation:
-    if (croppedData->size() < 2) return QPolygonF(); // need at least two points for interpolation
-    double slope;
-    if (!qFuzzyCompare(croppedData->at(1).x(), croppedData->at(0).x()))
-      slope = (croppedData->at(1).y()-croppedData->at(0).y())/(croppedData->at(1).x()-croppedData->at(0).x());
-    else
-      slope = 0;
-    (*croppedData)[0].setY(croppedData->at(0).y()+slope*(staticData->first().x()-croppedData->at(0).x()));
-    (*croppedData)[0].setX(staticData->first().x());
-    
-    // crop upper bound:
-    if (staticData->last().x() > croppedData->last().x()) // other one must be cropped
-      qSwap(staticData, croppedData);
-    int highBound = findIndexAboveX(croppedData, staticData->last().x());
-    if (highBound == -1) return QPolygonF(); // key ranges have no overlap
-    croppedData->remove(highBound+1, croppedData->size()-(highBound+1));
-    // set highest point of cropped data to fit exactly key position of last static data point via linear interpolation:
-    if (croppedData->size() < 2) return QPolygonF(); // need at least two points for interpolation
-    const int li = croppedData->size()-1; // last index
-    if (!qFuzzyCompare(croppedData->at(li).x(), croppedData->at(li-1).x()))
-      slope = (croppedData->at(li).y()-croppedData->at(li-1).y())/(croppedData->at(li).x()-croppedData->at(li-1).x());
-    else
-      slope = 0;
-    (*croppedData)[li].setY(croppedData->at(li-1).y()+slope*(staticData->last().x()-croppedData->at(li-1).x()));
-    (*croppedData)[li].setX(staticData->last().x());
-  } else // mKeyAxis->orientation() == Qt::Vertical
-  {
-    // y is key
-    // crop lower bound:
-    if (staticData->first().y() < croppedData->first().y()) // other one must be cropped
-      qSwap(staticData, croppedData);
-    int lowBound = findIndexBelowY(croppedData, staticData->first().y());
-    if (lowBound == -1) return QPolygonF(); // key ranges have no overlap
-    croppedData->remove(0, lowBound);
-    // set lowest point of cropped data to fit exactly key position of first static data point via linear interpolation:
-    if (croppedData->size() < 2) return QPolygonF(); // need at least two points for interpolation
-    double slope;
-    if (!qFuzzyCompare(croppedData->at(1).y(), croppedData->at(0).y())) // avoid division by zero in step plots
-      slope = (croppedData->at(1).x()-croppedData->at(0).x())/(croppedData->at(1).y()-croppedData->at(0).y());
-    else
-      slope = 0;
-    (*croppedData)[0].setX(croppedData->at(0).x()+slope*(staticData->first().y()-croppedData->at(0).y()));
-    (*croppedData)[0].setY(staticData->first().y());
-    
-    // crop upper bound:
-    if (staticData->last().y() > croppedData->last().y()) // other one must be cropped
-      qSwap(staticData, croppedData);
-    int highBound = findIndexAboveY(croppedData, staticData->last().y());
-    if (highBound == -1) return QPolygonF(); // key ranges have no overlap
-    croppedData->remove(highBound+1, croppedData->size()-(highBound+1));
-    // set highest point of cropped data to fit exactly key position of last static data point via linear interpolation:
-    if (croppedData->size() < 2) return QPolygonF(); // need at least two points for interpolation
-    int li = croppedData->size()-1; // last index
-    if (!qFuzzyCompare(croppedData->at(li).y(), croppedData->at(li-1).y())) // avoid division by zero in step plots
-      slope = (croppedData->at(li).x()-croppedData->at(li-1).x())/(croppedData->at(li).y()-croppedData->at(li-1).y());
-    else
-      slope = 0;
-    (*croppedData)[li].setX(croppedData->at(li-1).x()+slope*(staticData->last().y()-croppedData->at(li-1).y()));
-    (*croppedData)[li].setY(staticData->last().y());
+    out = std::copy(thisData->constBegin()+thisSide.begin+1, thisData->constBegin()+thisSide.end-1, out);
+    *out++ = thisSide.last;
   }
-  
-  // return joined:
-  for (int i=otherSegmentData.size()-1; i>=0; --i) // insert reversed, otherwise the polygon will be twisted
-    thisSegmentData << otherSegmentData.at(i);
-  return QPolygonF(thisSegmentData);
+  if (otherSide.end-otherSide.begin > 1)
+  {
+    *out++ = otherSide.last;
+    out = std::reverse_copy(otherData->constBegin()+otherSide.begin+1, otherData->constBegin()+otherSide.end-1, out);
+  }
+  *out++ = otherSide.first;
+  return result;
 }
 
 /*! \internal
   
-  Finds the smallest index of \a data, whose points x value is just above \a x. Assumes x values in
-  \a data points are ordered ascending, as is ensured by \ref getLines/\ref getScatters if the key
-  axis is horizontal.
+  Returns the index of the first point in the index range [\a begin, \a end) of \a data whose key
+  pixel coordinate is greater than or equal to \a keyPixel, or greater than \a keyPixel if \a
+  upperBound is true. Returns \a end if there is no such point. Assumes the points are sorted
+  ascending by key pixel, as is ensured by \ref getLines/\ref getScatters. Uses binary search.
 
-  Used to calculate the channel fill polygon, see \ref getChannelFillPolygon.
+  Used to find the lines near a pixel position, see \ref pointDistance, and to crop the segments
+  of a channel fill, see \ref getChannelFillPolygon.
 */
-int QCPGraph::findIndexAboveX(const QVector<QPointF> *data, double x) const
+int QCPGraph::findKeyPixelBound(const QVector<QPointF> *data, double keyPixel, bool upperBound, int begin, int end) const
 {
-  for (int i=data->size()-1; i>=0; --i)
+  const bool keyIsX = mKeyAxis->orientation() == Qt::Horizontal;
+  int lower = begin;
+  int upper = end;
+  while (lower < upper)
   {
-    if (data->at(i).x() < x)
-    {
-      if (i<data->size()-1)
-        return i+1;
-      else
-        return data->size()-1;
-    }
+    const int middle = lower+(upper-lower)/2;
+    const double middlePixel = keyIsX ? data->at(middle).x() : data->at(middle).y();
+    if (upperBound ? middlePixel <= keyPixel : middlePixel < keyPixel)
+      lower = middle+1;
+    else
+      upper = middle;
   }
-  return -1;
+  return lower;
 }
 
 /*! \internal
   
-  Finds the highest index of \a data, whose points x value is just below \a x. Assumes x values in
-  \a data points are ordered ascending, as is ensured by \ref getLines/\ref getScatters if the key
-  axis is horizontal.
+  Returns whether the pixel geometry in \a mGeometryCache still matches the current axes, axis
+  rects, data and selection.
   
-  Used to calculate the channel fill polygon, see \ref getChannelFillPolygon.
+  If data points were only appended since the cache was built (see \ref
+  QCPDataContainer::modifyRevision), and a data point beyond the visible key range already existed
+  then, the appended points lie outside of what \ref getVisibleDataBounds returns and the cache
+  stays valid.
 */
-int QCPGraph::findIndexBelowX(const QVector<QPointF> *data, double x) const
+bool QCPGraph::geometryCacheValid() const
 {
-  for (int i=0; i<data->size(); ++i)
-  {
-    if (data->at(i).x() > x)
-    {
-      if (i>0)
-        return i-1;
-      else
-        return 0;
-    }
-  }
-  return -1;
+  const GeometryCache &cache = mGeometryCache;
+  if (!cache.valid || !mKeyAxis || !mValueAxis)
+    return false;
+  if (cache.container != mDataContainer.data() || cache.keyAxis != mKeyAxis.data() || cache.valueAxis != mValueAxis.data())
+    return false;
+  if (cache.keyRange != mKeyAxis->range() || cache.valueRange != mValueAxis->range() ||
+      cache.keyReversed != mKeyAxis->rangeReversed() || cache.valueReversed != mValueAxis->rangeReversed() ||
+      cache.keyScaleType != mKeyAxis->scaleType() || cache.valueScaleType != mValueAxis->scaleType())
+    return false;
+  if (cache.keyAxisRect != mKeyAxis->axisRect()->rect() || cache.valueAxisRect != mValueAxis->axisRect()->rect())
+    return false;
+  if (cache.selection != mSelection)
+    return false;
+  if (cache.revision != mDataContainer->revision())
+    return cache.modifyRevision == mDataContainer->modifyRevision() && cache.dataBeyondVisibleEnd;
+  return true;
 }
 
 /*! \internal
   
-  Finds the smallest index of \a data, whose points y value is just above \a y. Assumes y values in
-  \a data points are ordered ascending, as is ensured by \ref getLines/\ref getScatters if the key
-  axis is vertical.
+  Recomputes the line and, if a scatter style is set, scatter pixel coordinates of all data
+  segments in \a mGeometryCache, unless \ref geometryCacheValid says they are up to date.
   
-  Used to calculate the channel fill polygon, see \ref getChannelFillPolygon.
+  Repaints that don't change the axes, the data or the selection thus don't redo the conversion
+  from data to pixel coordinates.
 */
-int QCPGraph::findIndexAboveY(const QVector<QPointF> *data, double y) const
+void QCPGraph::updateGeometryCache()
 {
-  for (int i=data->size()-1; i>=0; --i)
+  if (geometryCacheValid())
+    return;
+  
+  GeometryCache &cache = mGeometryCache;
+  cache.container = mDataContainer.data();
+  cache.revision = mDataContainer->revision();
+  cache.modifyRevision = mDataContainer->modifyRevision();
+  cache.dataBeyondVisibleEnd = mDataContainer->findEnd(mKeyAxis->range().upper) != mDataContainer->constEnd();
+  cache.keyAxis = mKeyAxis.data();
+  cache.valueAxis = mValueAxis.data();
+  cache.keyRange = mKeyAxis->range();
+  cache.valueRange = mValueAxis->range();
+  cache.keyReversed = mKeyAxis->rangeReversed();
+  cache.valueReversed = mValueAxis->rangeReversed();
+  cache.keyScaleType = mKeyAxis->scaleType();
+  cache.valueScaleType = mValueAxis->scaleType();
+  cache.keyAxisRect = mKeyAxis->axisRect()->rect();
+  cache.valueAxisRect = mValueAxis->axisRect()->rect();
+  cache.selection = mSelection;
+  
+  QList<QCPDataRange> selectedSegments, unselectedSegments;
+  getDataSegments(selectedSegments, unselectedSegments);
+  cache.segments.clear();
+  cache.segments << unselectedSegments << selectedSegments;
+  cache.unselectedCount = unselectedSegments.size();
+  cache.lines.resize(cache.segments.size());
+  cache.scatters.resize(cache.segments.size());
+  cache.scattersValid.fill(false, cache.segments.size());
+  for (int i=0; i<cache.segments.size(); ++i)
   {
-    if (data->at(i).y() < y)
+    // get line pixel points appropriate to line style:
+    bool isSelectedSegment = i >= cache.unselectedCount;
+    QCPDataRange lineDataRange = isSelectedSegment ? cache.segments.at(i) : cache.segments.at(i).adjusted(-1, 1); // unselected segments extend lines to bordering selected data point (safe to exceed total data bounds in first/last segment, getLines takes care)
+    getLines(&cache.lines[i], lineDataRange);
+    // scatters are only needed with a scatter style. They are computed here rather than lazily in draw, so draw only reads
+    // the cache and may run on several threads (see QCPLayer::drawParallel):
+    QCPScatterStyle finalScatterStyle = mScatterStyle;
+    if (isSelectedSegment && mSelectionDecorator)
+      finalScatterStyle = mSelectionDecorator->getFinalScatterStyle(mScatterStyle);
+    if (!finalScatterStyle.isNone())
     {
-      if (i<data->size()-1)
-        return i+1;
-      else
-        return data->size()-1;
+      getScatters(&cache.scatters[i], cache.segments.at(i));
+      cache.scattersValid[i] = true;
     }
   }
-  return -1;
+  cache.valid = true;
 }
 
 /*! \internal
@@ -21661,11 +22634,44 @@ double QCPGraph::pointDistance(const QPointF &pixelPoint, QCPGraphDataContainer:
   // calculate distance to graph line if there is one (if so, will probably be smaller than distance to closest data point):
   if (mLineStyle != lsNone)
   {
-    // line displayed, calculate distance to line segments:
-    QVector<QPointF> lineData;
-    getLines(&lineData, QCPDataRange(0, dataCount()));
     QCPVector2D p(pixelPoint);
     const int step = mLineStyle==lsImpulse ? 2 : 1; // impulse plot differs from other line styles in that the lineData points are only pairwise connected
+    if (geometryCacheValid())
+    {
+      // reuse the lines of the last draw. They are sorted ascending by key pixel, so the lines near pos are found by binary search:
+      const double posKeyPixel = mKeyAxis->orientation() == Qt::Horizontal ? pixelPoint.x() : pixelPoint.y();
+      const double tolerance = mParentPlot->selectionTolerance();
+      for (int segment=0; segment<mGeometryCache.lines.size(); ++segment)
+      {
+        const QVector<QPointF> &lineData = mGeometryCache.lines.at(segment);
+        // segments crossing the window border have one end point outside of it:
+        int first = qMax(0, findKeyPixelBound(&lineData, posKeyPixel-tolerance, false, 0, lineData.size())-1);
+        const int last = qMin(lineData.size(), findKeyPixelBound(&lineData, posKeyPixel+tolerance, true, 0, lineData.size())+1);
+        if (step == 2)
+          first -= first%2;
+        for (int i=first; i<last-1; i+=step)
+        {
+          const double currentDistSqr = p.distanceSquaredToLine(lineData.at(i), lineData.at(i+1));
+          if (currentDistSqr < minDistSqr)
+            minDistSqr = currentDistSqr;
+        }
+      }
+      return qSqrt(minDistSqr);
+    }
+    
+    // no valid lines of the last draw. Only segments with an end point in the key window around pos can be within the selection
+    // tolerance, so don't generate lines for all data. The window is widened by two pixels, such that the adaptive sampling in
+    // getLines forms the same pixel clusters near pos as in draw:
+    double lineKeyMin, lineKeyMax;
+    const double lineMargin = mParentPlot->selectionTolerance()+2;
+    pixelsToCoords(pixelPoint-QPointF(lineMargin, lineMargin), lineKeyMin, dummy);
+    pixelsToCoords(pixelPoint+QPointF(lineMargin, lineMargin), lineKeyMax, dummy);
+    if (lineKeyMin > lineKeyMax)
+      qSwap(lineKeyMin, lineKeyMax);
+    const int lineBegin = mDataContainer->findBegin(lineKeyMin, true)-mDataContainer->constBegin();
+    const int lineEnd = mDataContainer->findEnd(lineKeyMax, true)-mDataContainer->constBegin();
+    QVector<QPointF> lineData;
+    getLines(&lineData, QCPDataRange(lineBegin, lineEnd));
     for (int i=0; i<lineData.size()-1; i+=step)
     {
       const double currentDistSqr = p.distanceSquaredToLine(lineData.at(i), lineData.at(i+1));
@@ -21676,29 +22682,6 @@ double QCPGraph::pointDistance(const QPointF &pixelPoint, QCPGraphDataContainer:
   
   return qSqrt(minDistSqr);
 }
-
-/*! \internal
-  
-  Finds the highest index of \a data, whose points y value is just below \a y. Assumes y values in
-  \a data points are ordered ascending, as is ensured by \ref getLines/\ref getScatters if the key
-  axis is vertical.
-
-  Used to calculate the channel fill polygon, see \ref getChannelFillPolygon.
-*/
-int QCPGraph::findIndexBelowY(const QVector<QPointF> *data, double y) const
-{
-  for (int i=0; i<data->size(); ++i)
-  {
-    if (data->at(i).y() > y)
-    {
-      if (i>0)
-        return i-1;
-      else
-        return 0;
-    }
-  }
-  return -1;
-}
 /* end of 'src/plottables/plottable-graph.cpp' */
 
 
@@ -21870,6 +22853,7 @@ QCPCurve::QCPCurve(QCPAxis *keyAxis, QCPAxis *valueAxis) :
   setScatterStyle(QCPScatterStyle());
   setLineStyle(lsLine);
   setScatterSkip(0);
+  setAdaptiveSampling(false);
 }
 
 QCPCurve::~QCPCurve()
@@ -21941,6 +22925,7 @@ void QCPCurve::setData(const QVector<double> &keys, const QVector<double> &value
 void QCPCurve::setScatterStyle(const QCPScatterStyle &style)
 {
   mScatterStyle = style;
+  markLegendDirty();
 }
 
 /*!
@@ -21969,6 +22954,26 @@ void QCPCurve::setScatterSkip(int skip)
 void QCPCurve::setLineStyle(QCPCurve::LineStyle style)
 {
   mLineStyle = style;
+  markLegendDirty();
+}
+
+/*!
+  Sets whether adaptive sampling shall be used when plotting this curve. With adaptive sampling,
+  consecutive data points inside the visible axis rect that map to within one pixel of the last
+  drawn point are left out of the line, so long curves (e.g. the trail of a X-Y plot) only cost as
+  many line segments as they have visible pixels. The deviation from the exact line is below one
+  pixel.
+
+  Unlike \ref QCPGraph::setAdaptiveSampling, this is disabled by default, because the order of the
+  points of a curve is given by \a t rather than the key, so there is no key-sorted pixel column
+  to bin the points into and the data still has to be walked once per draw. Keep the number of
+  points bounded (e.g. with \ref QCPDataContainer::removeBefore) if redraw cost matters.
+
+  Scatters are not affected, they are drawn for every data point as before.
+*/
+void QCPCurve::setAdaptiveSampling(bool enabled)
+{
+  mAdaptiveSampling = enabled;
 }
 
 /*! \overload
@@ -22343,7 +23348,12 @@ void QCPCurve::getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRa
     {
       if (currentRegion == 5) // still in R, keep adding original points
       {
-        lines->append(coordsToPixels(it->key, it->value));
+        const QPointF point = coordsToPixels(it->key, it->value);
+        // with adaptive sampling, points within one pixel of the last added point are skipped. The last data point is always kept
+        // so the curve ends exactly at it, and NaN gaps are kept because the comparisons below are false for them:
+        if (!mAdaptiveSampling || lines->isEmpty() || it == itEnd-1 ||
+            !(qAbs(point.x()-lines->last().x()) < 1.0 && qAbs(point.y()-lines->last().y()) < 1.0))
+          lines->append(point);
       } else // still outside R, no need to add anything
       {
         // see how this is not doing anything? That's the main optimization...
@@ -25032,10 +26042,21 @@ QVector<QLineF> QCPStatisticalBox::getWhiskerBarLines(QCPStatisticalBoxDataConta
   true current minimum and maximum. The method QCPColorMap::rescaleDataRange offers a convenience
   parameter \a recalculateDataBounds which may be set to true to automatically call \ref
   recalculateDataBounds internally.
+  
+  For scrolling displays like a waterfall spectrogram, the value rows can be used as a ring buffer
+  with \ref pushValueRow. Only the pushed rows are colorized again by the QCPColorMap, instead of
+  the whole map.
 */
 
 /* start of documentation of inline functions */
 
+/*! \fn int QCPColorMapData::ringOffset() const
+  
+  Returns the storage row that holds the cells of value index 0. This is 0 unless rows were added
+  with \ref pushValueRow. The cells returned by \ref cellData are in storage order, so value index
+  \a v is in storage row <tt>(v+ringOffset())%valueSize()</tt>.
+*/
+
 /*! \fn bool QCPColorMapData::isEmpty() const
   
   Returns whether this instance carries no data. This is equivalent to having a size where at least
@@ -25059,7 +26080,9 @@ QCPColorMapData::QCPColorMapData(int keySize, int valueSize, const QCPRange &key
   mIsEmpty(true),
   mData(0),
   mAlpha(0),
-  mDataModified(true)
+  mDataModified(true),
+  mRingOffset(0),
+  mPushedRows(0)
 {
   setSize(keySize, valueSize);
   fill(0);
@@ -25082,7 +26105,9 @@ QCPColorMapData::QCPColorMapData(const QCPColorMapData &other) :
   mIsEmpty(true),
   mData(0),
   mAlpha(0),
-  mDataModified(true)
+  mDataModified(true),
+  mRingOffset(0),
+  mPushedRows(0)
 {
   *this = other;
 }
@@ -25110,6 +26135,8 @@ QCPColorMapData &QCPColorMapData::operator=(const QCPColorMapData &other)
         memcpy(mAlpha, other.mAlpha, sizeof(mAlpha[0])*keySize*valueSize);
     }
     mDataBounds = other.mDataBounds;
+    mRingOffset = other.mRingOffset;
+    mPushedRows = 0;
     mDataModified = true;
   }
   return *this;
@@ -25121,7 +26148,7 @@ double QCPColorMapData::data(double key, double value)
   int keyCell = (key-mKeyRange.lower)/(mKeyRange.upper-mKeyRange.lower)*(mKeySize-1)+0.5;
   int valueCell = (value-mValueRange.lower)/(mValueRange.upper-mValueRange.lower)*(mValueSize-1)+0.5;
   if (keyCell >= 0 && keyCell < mKeySize && valueCell >= 0 && valueCell < mValueSize)
-    return mData[valueCell*mKeySize + keyCell];
+    return mData[ringRow(valueCell)*mKeySize + keyCell];
   else
     return 0;
 }
@@ -25130,7 +26157,7 @@ double QCPColorMapData::data(double key, double value)
 double QCPColorMapData::cell(int keyIndex, int valueIndex)
 {
   if (keyIndex >= 0 && keyIndex < mKeySize && valueIndex >= 0 && valueIndex < mValueSize)
-    return mData[valueIndex*mKeySize + keyIndex];
+    return mData[ringRow(valueIndex)*mKeySize + keyIndex];
   else
     return 0;
 }
@@ -25146,7 +26173,7 @@ double QCPColorMapData::cell(int keyIndex, int valueIndex)
 unsigned char QCPColorMapData::alpha(int keyIndex, int valueIndex)
 {
   if (mAlpha && keyIndex >= 0 && keyIndex < mKeySize && valueIndex >= 0 && valueIndex < mValueSize)
-    return mAlpha[valueIndex*mKeySize + keyIndex];
+    return mAlpha[ringRow(valueIndex)*mKeySize + keyIndex];
   else
     return 255;
 }
@@ -25169,6 +26196,8 @@ void QCPColorMapData::setSize(int keySize, int valueSize)
   {
     mKeySize = keySize;
     mValueSize = valueSize;
+    mRingOffset = 0;
+    mPushedRows = 0;
     if (mData)
       delete[] mData;
     mIsEmpty = mKeySize == 0 || mValueSize == 0;
@@ -25289,7 +26318,7 @@ void QCPColorMapData::setData(double key, double value, double z)
   int valueCell = (value-mValueRange.lower)/(mValueRange.upper-mValueRange.lower)*(mValueSize-1)+0.5;
   if (keyCell >= 0 && keyCell < mKeySize && valueCell >= 0 && valueCell < mValueSize)
   {
-    mData[valueCell*mKeySize + keyCell] = z;
+    mData[ringRow(valueCell)*mKeySize + keyCell] = z;
     if (z < mDataBounds.lower)
       mDataBounds.lower = z;
     if (z > mDataBounds.upper)
@@ -25313,7 +26342,7 @@ void QCPColorMapData::setCell(int keyIndex, int valueIndex, double z)
 {
   if (keyIndex >= 0 && keyIndex < mKeySize && valueIndex >= 0 && valueIndex < mValueSize)
   {
-    mData[valueIndex*mKeySize + keyIndex] = z;
+    mData[ringRow(valueIndex)*mKeySize + keyIndex] = z;
     if (z < mDataBounds.lower)
       mDataBounds.lower = z;
     if (z > mDataBounds.upper)
@@ -25344,7 +26373,7 @@ void QCPColorMapData::setAlpha(int keyIndex, int valueIndex, unsigned char alpha
   {
     if (mAlpha || createAlpha())
     {
-      mAlpha[valueIndex*mKeySize + keyIndex] = alpha;
+      mAlpha[ringRow(valueIndex)*mKeySize + keyIndex] = alpha;
       mDataModified = true;
     }
   } else
@@ -25418,6 +26447,54 @@ void QCPColorMapData::fill(double z)
   mDataModified = true;
 }
 
+/*!
+  Returns a pointer to the cell values, for writing many cells at once (e.g. accumulating and
+  decaying a histogram every replot) without the per-cell overhead of \ref setCell. The cells are
+  stored row by row, the value of the cell (\a keyIndex, \a valueIndex) is at
+  <tt>[valueIndex*keySize() + keyIndex]</tt>. Returns 0 if the map is empty.
+
+  The map image is regenerated on the next replot. The data bounds are not updated, call \ref
+  recalculateDataBounds if you need them. If rows were added with \ref pushValueRow, the rows are
+  in storage order, see \ref ringOffset.
+*/
+double *QCPColorMapData::cellData()
+{
+  mDataModified = true;
+  return mData;
+}
+
+/*!
+  Scrolls the map by one value row: the cells of value index 0 are dropped, every other row moves
+  down by one value index, and the \ref keySize values pointed to by \a values become the row with
+  value index <tt>valueSize()-1</tt>. If an alpha map exists, the new row is fully opaque.
+
+  No cells are moved, the value rows are a ring buffer whose start is \ref ringOffset. So this takes
+  time proportional to \ref keySize only, and on the next replot the QCPColorMap only colorizes the
+  rows pushed since the last replot, as long as nothing else (data range, gradient, other cells)
+  changed in between.
+  
+  The data bounds are expanded by the new values, like with \ref setCell.
+*/
+void QCPColorMapData::pushValueRow(const double *values)
+{
+  if (mIsEmpty || !mData)
+    return;
+  double *row = mData + mRingOffset*mKeySize; // the oldest row becomes the newest one
+  for (int i=0; i<mKeySize; ++i)
+  {
+    const double z = values[i];
+    row[i] = z;
+    if (z < mDataBounds.lower)
+      mDataBounds.lower = z;
+    if (z > mDataBounds.upper)
+      mDataBounds.upper = z;
+  }
+  if (mAlpha)
+    memset(mAlpha + mRingOffset*mKeySize, 255, mKeySize);
+  mRingOffset = (mRingOffset+1)%mValueSize;
+  mPushedRows = qMin(mPushedRows+1, mValueSize);
+}
+
 /*!
   Sets the opacity of all color map cells to \a alpha. A value of 0 for \a alpha results in a fully
   transparent color map, and a value of 255 results in a fully opaque color map.
@@ -25966,6 +27043,8 @@ void QCPColorMap::updateMapImage()
   QCPAxis *keyAxis = mKeyAxis.data();
   if (!keyAxis) return;
   if (mMapData->isEmpty()) return;
+  if (!mMapData->mDataModified && !mMapImageInvalidated && updatePushedRows())
+    return;
   
   const QImage::Format format = QImage::Format_ARGB32_Premultiplied;
   const int keySize = mMapData->keySize();
@@ -26035,9 +27114,44 @@ void QCPColorMap::updateMapImage()
     }
   }
   mMapData->mDataModified = false;
+  mMapData->mPushedRows = 0;
   mMapImageInvalidated = false;
 }
 
+/*! \internal
+  
+  Colorizes only the value rows that were added with \ref QCPColorMapData::pushValueRow since the
+  last update, directly into the existing map image. The image holds the value rows in storage
+  order, \ref draw puts them in place according to \ref QCPColorMapData::ringOffset.
+  
+  Returns false if the whole image needs to be regenerated instead, i.e. if the image size doesn't
+  match the data, the map is oversampled or the key axis isn't horizontal (the value rows then
+  aren't scan lines of the image).
+*/
+bool QCPColorMap::updatePushedRows()
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  const int keySize = mMapData->keySize();
+  const int valueSize = mMapData->valueSize();
+  if (mMapData->mPushedRows <= 0 || !keyAxis || keyAxis->orientation() != Qt::Horizontal ||
+      mMapImage.width() != keySize || mMapImage.height() != valueSize || !mUndersampledMapImage.isNull())
+    return false;
+  
+  const double *rawData = mMapData->mData;
+  const unsigned char *rawAlpha = mMapData->mAlpha;
+  for (int i=0; i<mMapData->mPushedRows; ++i)
+  {
+    const int line = (mMapData->mRingOffset-1-i+valueSize)%valueSize; // storage row of the i-th newest value row
+    QRgb* pixels = reinterpret_cast<QRgb*>(mMapImage.scanLine(valueSize-1-line));
+    if (rawAlpha)
+      mGradient.colorize(rawData+line*keySize, rawAlpha+line*keySize, mDataRange, pixels, keySize, 1, mDataScaleType==QCPAxis::stLogarithmic);
+    else
+      mGradient.colorize(rawData+line*keySize, mDataRange, pixels, keySize, 1, mDataScaleType==QCPAxis::stLogarithmic);
+  }
+  mMapData->mPushedRows = 0;
+  return true;
+}
+
 /* inherits documentation from base class */
 void QCPColorMap::draw(QCPPainter *painter)
 {
@@ -26045,7 +27159,7 @@ void QCPColorMap::draw(QCPPainter *painter)
   if (!mKeyAxis || !mValueAxis) return;
   applyDefaultAntialiasingHint(painter);
   
-  if (mMapData->mDataModified || mMapImageInvalidated)
+  if (mMapData->mDataModified || mMapImageInvalidated || mMapData->mPushedRows > 0)
     updateMapImage();
   
   // use buffer if painting vectorized (PDF):
@@ -26095,7 +27209,59 @@ void QCPColorMap::draw(QCPPainter *painter)
                                   coordsToPixels(mMapData->keyRange().upper, mMapData->valueRange().upper)).normalized();
     localPainter->setClipRect(tightClipRect, Qt::IntersectClip);
   }
-  localPainter->drawImage(imageRect, mMapImage.mirrored(mirrorX, mirrorY));
+  const int ringOffset = mMapData->ringOffset();
+  if (ringOffset == 0)
+  {
+    localPainter->drawImage(imageRect, mMapImage.mirrored(mirrorX, mirrorY));
+  } else
+  {
+    // the value rows are a ring buffer (see QCPColorMapData::pushValueRow) and the image holds them in storage order. Draw
+    // the older rows (storage rows ringOffset..valueSize-1) and the newer rows (storage rows 0..ringOffset-1) separately:
+    const int valueSize = mMapData->valueSize();
+    const double newerFraction = ringOffset/(double)valueSize;
+    QRect olderSource, newerSource;
+    QRectF olderTarget, newerTarget;
+    if (valueAxis()->orientation() == Qt::Vertical) // storage rows are scan lines, bottom up
+    {
+      const int split = mMapImage.height()/valueSize*(valueSize-ringOffset);
+      olderSource = QRect(0, 0, mMapImage.width(), split);
+      newerSource = QRect(0, split, mMapImage.width(), mMapImage.height()-split);
+      const double newerHeight = imageRect.height()*newerFraction;
+      if (!mirrorY)
+      {
+        newerTarget = QRectF(imageRect.left(), imageRect.top(), imageRect.width(), newerHeight);
+        olderTarget = QRectF(imageRect.left(), imageRect.top()+newerHeight, imageRect.width(), imageRect.height()-newerHeight);
+      } else
+      {
+        olderTarget = QRectF(imageRect.left(), imageRect.top(), imageRect.width(), imageRect.height()-newerHeight);
+        newerTarget = QRectF(imageRect.left(), imageRect.bottom()-newerHeight, imageRect.width(), newerHeight);
+      }
+    } else // storage rows are image columns, left to right
+    {
+      const int split = mMapImage.width()/valueSize*ringOffset;
+      newerSource = QRect(0, 0, split, mMapImage.height());
+      olderSource = QRect(split, 0, mMapImage.width()-split, mMapImage.height());
+      const double newerWidth = imageRect.width()*newerFraction;
+      if (!mirrorX)
+      {
+        olderTarget = QRectF(imageRect.left(), imageRect.top(), imageRect.width()-newerWidth, imageRect.height());
+        newerTarget = QRectF(imageRect.right()-newerWidth, imageRect.top(), newerWidth, imageRect.height());
+      } else
+      {
+        newerTarget = QRectF(imageRect.left(), imageRect.top(), newerWidth, imageRect.height());
+        olderTarget = QRectF(imageRect.left()+newerWidth, imageRect.top(), imageRect.width()-newerWidth, imageRect.height());
+      }
+    }
+    if (mirrorX || mirrorY)
+    {
+      localPainter->drawImage(olderTarget, mMapImage.copy(olderSource).mirrored(mirrorX, mirrorY));
+      localPainter->drawImage(newerTarget, mMapImage.copy(newerSource).mirrored(mirrorX, mirrorY));
+    } else
+    {
+      localPainter->drawImage(olderTarget, mMapImage, olderSource);
+      localPainter->drawImage(newerTarget, mMapImage, newerSource);
+    }
+  }
   if (mTightBoundary)
     localPainter->setClipRegion(clipBackup);
   localPainter->setRenderHint(QPainter::SmoothPixmapTransform, smoothBackup);
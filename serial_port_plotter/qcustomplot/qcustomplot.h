@@ -68,6 +68,10 @@
 #include <qmath.h>
 #include <limits>
 #include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define QCP_SSE2
+#  include <emmintrin.h>
+#endif
 #ifdef QCP_OPENGL_FBO
 #  include <QtGui/QOpenGLContext>
 #  include <QtGui/QOpenGLFramebufferObject>
@@ -111,6 +115,7 @@ class QCPSelectionRect;
 class QCPColorMap;
 class QCPColorScale;
 class QCPBars;
+class QThreadPool;
 
 /* including file 'src/global.h', size 16357                                 */
 /* commit ce344b3f96a62e5f652585e55f1ae7c7883cd45b 2018-06-25 01:03:39 +0200 */
@@ -243,6 +248,10 @@ enum PlottingHint { phNone              = 0x000 ///< <tt>0x000</tt> No hints are
                     ,phImmediateRefresh = 0x002 ///< <tt>0x002</tt> causes an immediate repaint() instead of a soft update() when QCustomPlot::replot() is called with parameter \ref QCustomPlot::rpRefreshHint.
                                                 ///<                This is set by default to prevent the plot from freezing on fast consecutive replots (e.g. user drags ranges with mouse).
                     ,phCacheLabels      = 0x004 ///< <tt>0x004</tt> axis (tick) labels will be cached as pixmaps, increasing replot performance.
+                    ,phParallelPlottables = 0x008 ///< <tt>0x008</tt> layers that only contain graphs are drawn in horizontal strips on several threads (see \ref QCPLayer::drawParallel).
+                                                ///<                The result is identical to serial drawing. Only used with the software paint buffer.
+                    ,phDirtyLayers      = 0x010 ///< <tt>0x010</tt> \ref QCustomPlot::replot only clears and redraws the paint buffers of layers that were marked dirty (see \ref QCPLayer::markDirty).
+                                                ///<                Most effective when static layers like "axes", "grid" and "legend" are in \ref QCPLayer::lmBuffered mode.
                   };
 Q_DECLARE_FLAGS(PlottingHints, PlottingHint)
 
@@ -499,6 +508,7 @@ public:
   
   // non-virtual methods:
   void makeNonCosmetic();
+  bool drawPolylineRaster(const QVector<QPointF> &points);
   
 protected:
   // property members:
@@ -507,6 +517,10 @@ protected:
   
   // non-property members:
   QStack<bool> mAntialiasingStack;
+  
+  // non-virtual methods:
+  static bool clipRasterLine(QPointF &p1, QPointF &p2, const QRectF &rect);
+  static void rasterLine(uchar *bits, int bytesPerLine, const QRect &clip, QRgb color, int x1, int y1, int x2, int y2);
 };
 Q_DECLARE_OPERATORS_FOR_FLAGS(QCPPainter::PainterModes)
 Q_DECLARE_METATYPE(QCPPainter::PainterMode)
@@ -565,7 +579,7 @@ public:
   
 protected:
   // non-property members:
-  QPixmap mBuffer;
+  QImage mBuffer;
   
   // reimplemented virtual methods:
   virtual void reallocateBuffer() Q_DECL_OVERRIDE;
@@ -667,6 +681,8 @@ public:
   
   // non-virtual methods:
   void replot();
+  void markDirty() { mDirty = true; }
+  bool dirty() const { return mDirty; }
   
 protected:
   // property members:
@@ -679,9 +695,13 @@ protected:
   
   // non-property members:
   QWeakPointer<QCPAbstractPaintBuffer> mPaintBuffer;
+  bool mDirty;
   
   // non-virtual methods:
+  bool hasUntrackedChildren() const;
   void draw(QCPPainter *painter);
+  bool drawParallel(QCPPainter *painter);
+  void drawChildren(QCPPainter *painter);
   void drawToPaintBuffer();
   void addChild(QCPLayerable *layerable, bool prepend);
   void removeChild(QCPLayerable *layerable);
@@ -691,6 +711,7 @@ private:
   
   friend class QCustomPlot;
   friend class QCPLayerable;
+  friend class QCPLayerStripTask;
 };
 Q_DECLARE_METATYPE(QCPLayer::LayerMode)
 
@@ -726,6 +747,7 @@ public:
 
   // non-property methods:
   bool realVisibility() const;
+  void markLayerDirty() { if (mLayer) mLayer->markDirty(); }
   
 signals:
   void layerChanged(QCPLayer *newLayer);
@@ -738,6 +760,9 @@ protected:
   QCPLayer *mLayer;
   bool mAntialiased;
   
+  // non-property members:
+  bool mMarksLayerDirty;
+  
   // introduced virtual methods:
   virtual void parentPlotInitialized(QCustomPlot *parentPlot);
   virtual QCP::Interaction selectionCategory() const;
@@ -1573,6 +1598,17 @@ protected:
   int mTickCount;
   double mTickOrigin;
   
+  // non-property members:
+  bool mLabelCacheEnabled;
+  double mCachedTickStep;
+  QLocale mCachedLocale;
+  QChar mCachedFormatChar;
+  int mCachedPrecision;
+  QVector<double> mCachedTicks, mCachedSubTicks;
+  int mCachedSubTickCount;
+  QVector<double> mCachedLabelTicks;
+  QVector<QString> mCachedLabels;
+  
   // introduced virtual methods:
   virtual double getTickStep(const QCPRange &range);
   virtual int getSubTickCount(double tickStep);
@@ -1582,6 +1618,7 @@ protected:
   virtual QVector<QString> createLabelVector(const QVector<double> &ticks, const QLocale &locale, QChar formatChar, int precision);
   
   // non-virtual methods:
+  void clearCache();
   void trimTicks(const QCPRange &range, QVector<double> &ticks, bool keepOneOutlier) const;
   double pickClosest(double target, const QVector<double> &candidates) const;
   double getMantissa(double input, double *magnitude=0) const;
@@ -2179,6 +2216,10 @@ protected:
   bool mDragging;
   QCPRange mDragStartRange;
   QCP::AntialiasedElements mAADragBackup, mNotAADragBackup;
+  QCPRange mDrawnRange;
+  QRect mDrawnAxisRect;
+  QVector<double> mDrawnTickVector, mDrawnSubTickVector;
+  QVector<QString> mDrawnTickVectorLabels;
   
   // introduced virtual methods:
   virtual int calculateMargin();
@@ -2198,6 +2239,7 @@ protected:
   
   // non-virtual methods:
   void setupTickVectors();
+  bool ticksChanged();
   QPen getBasePen() const;
   QPen getTickPen() const;
   QPen getSubTickPen() const;
@@ -2276,9 +2318,19 @@ protected:
   QCustomPlot *mParentPlot;
   QByteArray mLabelParameterHash; // to determine whether mLabelCache needs to be cleared due to changed parameters
   QCache<QString, CachedLabel> mLabelCache;
+  QByteArray mGlyphAtlasHash; // to determine whether mGlyphAtlas needs to be rendered again due to changed font, color or pixel ratio
+  QFont mGlyphAtlasFont;
+  QPixmap mGlyphAtlas;
+  QVector<int> mGlyphOffsets, mGlyphAdvances;
+  int mGlyphHeight;
   QRect mAxisSelectionBox, mTickLabelsSelectionBox, mLabelSelectionBox;
   
   virtual QByteArray generateLabelParameterHash() const;
+  virtual QByteArray generateGlyphAtlasHash() const;
+  void setupGlyphAtlas();
+  bool getGlyphLabelSize(const QFont &font, const QString &text, QSize *size) const;
+  void drawGlyphLabel(QCPPainter *painter, const QPointF &pos, const QString &text) const;
+  static int glyphIndex(QChar c);
   
   virtual void placeTickLabel(QCPPainter *painter, double position, int distanceToAxis, const QString &text, QSize *tickLabelsSize);
   virtual void drawTickLabel(QCPPainter *painter, double x, double y, const TickLabelData &labelData) const;
@@ -2408,6 +2460,25 @@ Q_DECLARE_METATYPE(QCPScatterStyle::ScatterShape)
 template <class DataType>
 inline bool qcpLessThanSortKey(const DataType &a, const DataType &b) { return a.sortKey() < b.sortKey(); }
 
+/*! \relates QCPDataContainer
+  Widens \a lower and \a upper to include the value ranges of the data points in [\a begin, \a
+  end). NaN values are skipped, because comparisons with NaN are always false. Initialize \a lower
+  with +infinity and \a upper with -infinity to find the range of the data points alone.
+
+  This is the inner loop of \ref QCPDataContainer::valueRange. It is specialized for \ref
+  QCPGraphData, see there.
+*/
+template <class DataType>
+inline void qcpValueMinMax(typename QVector<DataType>::const_iterator begin, typename QVector<DataType>::const_iterator end, double &lower, double &upper)
+{
+  for (typename QVector<DataType>::const_iterator it = begin; it != end; ++it)
+  {
+    const QCPRange current = it->valueRange();
+    if (current.lower < lower) lower = current.lower;
+    if (current.upper > upper) upper = current.upper;
+  }
+}
+
 template <class DataType>
 class QCPDataContainer // no QCP_LIB_DECL, template class ends up in header (cpp included below)
 {
@@ -2421,6 +2492,8 @@ public:
   int size() const { return mData.size()-mPreallocSize; }
   bool isEmpty() const { return size() == 0; }
   bool autoSqueeze() const { return mAutoSqueeze; }
+  quint64 revision() const { return mRevision; }
+  quint64 modifyRevision() const { return mModifyRevision; }
   
   // setters:
   void setAutoSqueeze(bool enabled);
@@ -2441,8 +2514,8 @@ public:
   
   const_iterator constBegin() const { return mData.constBegin()+mPreallocSize; }
   const_iterator constEnd() const { return mData.constEnd(); }
-  iterator begin() { return mData.begin()+mPreallocSize; }
-  iterator end() { return mData.end(); }
+  iterator begin() { markModified(); return mData.begin()+mPreallocSize; }
+  iterator end() { markModified(); return mData.end(); }
   const_iterator findBegin(double sortKey, bool expandedRange=true) const;
   const_iterator findEnd(double sortKey, bool expandedRange=true) const;
   const_iterator at(int index) const { return constBegin()+qBound(0, index, size()); }
@@ -2459,10 +2532,15 @@ protected:
   QVector<DataType> mData;
   int mPreallocSize;
   int mPreallocIteration;
+  QVector<QCPRange> mValueChunks; // value range of each complete chunk of ValueChunkSize data points, see valueRange
+  enum { ValueChunkSize = 4096 };
+  quint64 mRevision, mModifyRevision;
   
   // non-virtual methods:
   void preallocateGrow(int minimumPreallocSize);
   void performAutoSqueeze();
+  void updateValueChunks(int chunkCount);
+  void markModified() { ++mRevision; mModifyRevision = mRevision; if (!mValueChunks.isEmpty()) mValueChunks.clear(); }
 };
 
 // include implementation in header since it is a class template:
@@ -2570,6 +2648,9 @@ protected:
   You can manipulate the data points in-place through the non-const iterators, but great care must
   be taken when manipulating the sort key of a data point, see \ref sort, or the detailed
   description of this class.
+
+  Requesting a non-const iterator discards the value ranges cached by \ref valueRange. Don't keep
+  non-const iterators across calls to \ref valueRange if you modify values through them.
 */
 
 /*! \fn QCPDataContainer::iterator QCPDataContainer<DataType>::end() const
@@ -2597,6 +2678,24 @@ protected:
   begin index of the returned range is 0, and the end index is \ref size.
 */
 
+/*! \fn quint64 QCPDataContainer::revision() const
+
+  Returns a counter that is incremented each time the data in this container changes. Plottables
+  use it to find out whether geometry computed from the data is still up to date.
+
+  \see modifyRevision
+*/
+
+/*! \fn quint64 QCPDataContainer::modifyRevision() const
+
+  Returns the \ref revision of the last change that wasn't a plain append of a single data point
+  with a (sort-)key greater than or equal to all existing ones (see \ref add(const DataType &data)).
+  If this value didn't change while \ref revision did, all data points that existed before are
+  unchanged and at the same indices.
+
+  Requesting a non-const iterator (\ref begin, \ref end) counts as a modification.
+*/
+
 /* end documentation of inline functions */
 
 /*!
@@ -2607,7 +2706,9 @@ template <class DataType>
 QCPDataContainer<DataType>::QCPDataContainer() :
   mAutoSqueeze(true),
   mPreallocSize(0),
-  mPreallocIteration(0)
+  mPreallocIteration(0),
+  mRevision(0),
+  mModifyRevision(0)
 {
 }
 
@@ -2658,6 +2759,7 @@ void QCPDataContainer<DataType>::set(const QVector<DataType> &data, bool already
   mData = data;
   mPreallocSize = 0;
   mPreallocIteration = 0;
+  markModified();
   if (!alreadySorted)
     sort();
 }
@@ -2722,12 +2824,15 @@ void QCPDataContainer<DataType>::add(const QVector<DataType> &data, bool already
     std::copy(data.constBegin(), data.constEnd(), begin());
   } else // don't need to prepend, so append and then sort and merge if necessary
   {
+    // work on mData directly, so the value chunks of the existing points survive a pure append (see add(const DataType&))
     mData.resize(mData.size()+n);
-    std::copy(data.constBegin(), data.constEnd(), end()-n);
+    std::copy(data.constBegin(), data.constEnd(), mData.end()-n);
     if (!alreadySorted) // sort appended subrange if it wasn't already sorted
-      std::sort(end()-n, end(), qcpLessThanSortKey<DataType>);
+      std::sort(mData.end()-n, mData.end(), qcpLessThanSortKey<DataType>);
     if (oldSize > 0 && !qcpLessThanSortKey<DataType>(*(constEnd()-n-1), *(constEnd()-n))) // if appended range keys aren't all greater than existing ones, merge the two partitions
-      std::inplace_merge(begin(), end()-n, end(), qcpLessThanSortKey<DataType>);
+      std::inplace_merge(begin(), end()-n, end(), qcpLessThanSortKey<DataType>); // begin() marks the existing points as modified
+    else
+      ++mRevision; // existing data points are untouched, so mModifyRevision stays
   }
 }
 
@@ -2743,6 +2848,7 @@ void QCPDataContainer<DataType>::add(const DataType &data)
   if (isEmpty() || !qcpLessThanSortKey<DataType>(data, *(constEnd()-1))) // quickly handle appends if new data key is greater or equal to existing ones
   {
     mData.append(data);
+    ++mRevision; // existing data points are untouched, so mModifyRevision stays
   } else if (qcpLessThanSortKey<DataType>(data, *constBegin()))  // quickly handle prepends using preallocated space
   {
     if (mPreallocSize < 1)
@@ -2841,6 +2947,7 @@ void QCPDataContainer<DataType>::clear()
   mData.clear();
   mPreallocIteration = 0;
   mPreallocSize = 0;
+  markModified();
 }
 
 /*!
@@ -3077,6 +3184,11 @@ QCPRange QCPDataContainer<DataType>::keyRange(bool &foundRange, QCP::SignDomain
   relevant e.g. for logarithmic plots which can mathematically only display one sign domain at a
   time.
 
+  If the DataType reports that its main key is equal to the sort key (\a sortKeyIsMainKey), the
+  data points inside \a inKeyRange are found by binary search. For \ref QCP::sdBoth, the value
+  ranges of complete chunks of data points are cached, so repeated calls (e.g. autoscaling while
+  data is appended) only scan the chunks that were added or modified since the last call.
+
   \see keyRange
 */
 template <class DataType>
@@ -3096,14 +3208,43 @@ QCPRange QCPDataContainer<DataType>::valueRange(bool &foundRange, QCP::SignDomai
   QCPDataContainer<DataType>::const_iterator itEnd = constEnd();
   if (DataType::sortKeyIsMainKey() && restrictKeyRange)
   {
-    itBegin = findBegin(inKeyRange.lower);
-    itEnd = findEnd(inKeyRange.upper);
+    itBegin = findBegin(inKeyRange.lower, false); // non-expanded bounds hold exactly the keys inside inKeyRange, so the keys needn't be checked again below
+    itEnd = findEnd(inKeyRange.upper, false);
   }
-  if (signDomain == QCP::sdBoth) // range may be anywhere
+  const bool checkKeys = restrictKeyRange && !DataType::sortKeyIsMainKey();
+  if (signDomain == QCP::sdBoth && !checkKeys) // range may be anywhere, reduce complete chunks from the cache
+  {
+    double lower = std::numeric_limits<double>::infinity();
+    double upper = -std::numeric_limits<double>::infinity();
+    const int beginIndex = int(itBegin-constBegin());
+    const int endIndex = int(itEnd-constBegin());
+    const int firstChunk = (beginIndex+ValueChunkSize-1)/ValueChunkSize;
+    const int endChunk = endIndex/ValueChunkSize;
+    if (firstChunk < endChunk)
+    {
+      updateValueChunks(endChunk);
+      qcpValueMinMax<DataType>(itBegin, constBegin()+firstChunk*ValueChunkSize, lower, upper);
+      for (int i=firstChunk; i<endChunk; ++i)
+      {
+        const QCPRange &chunk = mValueChunks.at(i);
+        if (chunk.lower < lower) lower = chunk.lower;
+        if (chunk.upper > upper) upper = chunk.upper;
+      }
+      qcpValueMinMax<DataType>(constBegin()+endChunk*ValueChunkSize, itEnd, lower, upper);
+    } else
+      qcpValueMinMax<DataType>(itBegin, itEnd, lower, upper);
+    foundRange = lower <= upper; // stays false if there were no non-NaN values
+    if (foundRange)
+    {
+      range.lower = lower;
+      range.upper = upper;
+    }
+    return range;
+  } else if (signDomain == QCP::sdBoth) // range may be anywhere
   {
     for (QCPDataContainer<DataType>::const_iterator it = itBegin; it != itEnd; ++it)
     {
-      if (restrictKeyRange && (it->mainKey() < inKeyRange.lower || it->mainKey() > inKeyRange.upper))
+      if (checkKeys && (it->mainKey() < inKeyRange.lower || it->mainKey() > inKeyRange.upper))
         continue;
       current = it->valueRange();
       if ((current.lower < range.lower || !haveLower) && !qIsNaN(current.lower))
@@ -3121,7 +3262,7 @@ QCPRange QCPDataContainer<DataType>::valueRange(bool &foundRange, QCP::SignDomai
   {
     for (QCPDataContainer<DataType>::const_iterator it = itBegin; it != itEnd; ++it)
     {
-      if (restrictKeyRange && (it->mainKey() < inKeyRange.lower || it->mainKey() > inKeyRange.upper))
+      if (checkKeys && (it->mainKey() < inKeyRange.lower || it->mainKey() > inKeyRange.upper))
         continue;
       current = it->valueRange();
       if ((current.lower < range.lower || !haveLower) && current.lower < 0 && !qIsNaN(current.lower))
@@ -3139,7 +3280,7 @@ QCPRange QCPDataContainer<DataType>::valueRange(bool &foundRange, QCP::SignDomai
   {
     for (QCPDataContainer<DataType>::const_iterator it = itBegin; it != itEnd; ++it)
     {
-      if (restrictKeyRange && (it->mainKey() < inKeyRange.lower || it->mainKey() > inKeyRange.upper))
+      if (checkKeys && (it->mainKey() < inKeyRange.lower || it->mainKey() > inKeyRange.upper))
         continue;
       current = it->valueRange();
       if ((current.lower < range.lower || !haveLower) && current.lower > 0 && !qIsNaN(current.lower))
@@ -3201,6 +3342,30 @@ void QCPDataContainer<DataType>::preallocateGrow(int minimumPreallocSize)
   mPreallocSize = newPreallocSize;
 }
 
+/*! \internal
+  
+  Makes sure the value ranges of the first \a chunkCount complete chunks of data points are in
+  the cache used by \ref valueRange. Only the chunks not cached yet are scanned. Appending data
+  points doesn't touch complete chunks, all other modifications discard the cache (see \ref
+  markModified).
+*/
+template <class DataType>
+void QCPDataContainer<DataType>::updateValueChunks(int chunkCount)
+{
+  mValueChunks.reserve(chunkCount);
+  for (int i=mValueChunks.size(); i<chunkCount; ++i)
+  {
+    double lower = std::numeric_limits<double>::infinity();
+    double upper = -std::numeric_limits<double>::infinity();
+    const_iterator chunkBegin = constBegin()+i*ValueChunkSize;
+    qcpValueMinMax<DataType>(chunkBegin, chunkBegin+ValueChunkSize, lower, upper);
+    QCPRange chunk;
+    chunk.lower = lower; // assigned directly, the QCPRange constructor would swap the bounds of an all-NaN chunk
+    chunk.upper = upper;
+    mValueChunks.append(chunk);
+  }
+}
+
 /*! \internal
   
   This method decides, depending on the total allocation size and the size of the unused pre- and
@@ -3386,6 +3551,7 @@ protected:
   // non-virtual methods:
   void applyFillAntialiasingHint(QCPPainter *painter) const;
   void applyScattersAntialiasingHint(QCPPainter *painter) const;
+  void markLegendDirty();
 
 private:
   Q_DISABLE_COPY(QCPAbstractPlottable)
@@ -3798,6 +3964,7 @@ protected:
   int mOpenGlMultisamples;
   QCP::AntialiasedElements mOpenGlAntialiasedElementsBackup;
   bool mOpenGlCacheLabelsBackup;
+  QThreadPool *mStripThreadPool; // created by the first QCPLayer::drawParallel
 #ifdef QCP_OPENGL_FBO
   QSharedPointer<QOpenGLContext> mGlContext;
   QSharedPointer<QSurface> mGlSurface;
@@ -3832,15 +3999,18 @@ protected:
   QCPLayerable *layerableAt(const QPointF &pos, bool onlySelectable, QVariant *selectionDetails=0) const;
   QList<QCPLayerable*> layerableListAt(const QPointF &pos, bool onlySelectable, QList<QVariant> *selectionDetails=0) const;
   void drawBackground(QCPPainter *painter);
+  void markChangedLayers();
   void setupPaintBuffers();
   QCPAbstractPaintBuffer *createPaintBuffer();
   bool hasInvalidatedPaintBuffers();
+  void invalidatePaintBuffers();
   bool setupOpenGl();
   void freeOpenGl();
   
   friend class QCPLegend;
   friend class QCPAxis;
   friend class QCPLayer;
+  friend class QCPLayerable;
   friend class QCPAxisRect;
   friend class QCPAbstractPlottable;
   friend class QCPGraph;
@@ -4511,6 +4681,7 @@ protected:
   // non-virtual methods:
   bool stopsUseAlpha() const;
   void updateColorBuffer();
+  void colorIndices(const double *data, const QCPRange &range, int *indices, int n, int dataIndexFactor, bool logarithmic) const;
 };
 Q_DECLARE_METATYPE(QCPColorGradient::ColorInterpolation)
 Q_DECLARE_METATYPE(QCPColorGradient::GradientPreset)
@@ -5148,6 +5319,47 @@ public:
 };
 Q_DECLARE_TYPEINFO(QCPGraphData, Q_PRIMITIVE_TYPE);
 
+/*! \relates QCPGraphData
+  Specialization of \ref qcpValueMinMax for \ref QCPGraphData. Where SSE2 is available, two
+  values are reduced per instruction. minpd/maxpd return the second operand if either one is NaN,
+  so passing the data first skips NaN values just like the generic version.
+*/
+template <>
+inline void qcpValueMinMax<QCPGraphData>(QVector<QCPGraphData>::const_iterator begin, QVector<QCPGraphData>::const_iterator end, double &lower, double &upper)
+{
+  if (begin == end)
+    return;
+  const QCPGraphData *it = &*begin;
+  const QCPGraphData *itEnd = it + (end-begin);
+#ifdef QCP_SSE2
+  if (itEnd-it >= 4)
+  {
+    __m128d min0 = _mm_set1_pd(lower), min1 = min0;
+    __m128d max0 = _mm_set1_pd(upper), max1 = max0;
+    for (; itEnd-it >= 4; it += 4) // two accumulators per bound to hide the instruction latency
+    {
+      const __m128d values0 = _mm_unpackhi_pd(_mm_loadu_pd(&it[0].key), _mm_loadu_pd(&it[1].key)); // (key, value) pairs -> (value, value)
+      const __m128d values1 = _mm_unpackhi_pd(_mm_loadu_pd(&it[2].key), _mm_loadu_pd(&it[3].key));
+      min0 = _mm_min_pd(values0, min0);
+      max0 = _mm_max_pd(values0, max0);
+      min1 = _mm_min_pd(values1, min1);
+      max1 = _mm_max_pd(values1, max1);
+    }
+    min0 = _mm_min_pd(min0, min1);
+    max0 = _mm_max_pd(max0, max1);
+    min0 = _mm_min_sd(min0, _mm_unpackhi_pd(min0, min0));
+    max0 = _mm_max_sd(max0, _mm_unpackhi_pd(max0, max0));
+    lower = _mm_cvtsd_f64(min0);
+    upper = _mm_cvtsd_f64(max0);
+  }
+#endif
+  for (; it != itEnd; ++it)
+  {
+    if (it->value < lower) lower = it->value;
+    if (it->value > upper) upper = it->value;
+  }
+}
+
 
 /*! \typedef QCPGraphDataContainer
   
@@ -5223,6 +5435,29 @@ protected:
   QPointer<QCPGraph> mChannelFillGraph;
   bool mAdaptiveSampling;
   
+  // non-property members:
+  struct GeometryCache
+  {
+    GeometryCache() : valid(false) {}
+    bool valid;
+    // state the pixel geometry was computed for, see geometryCacheValid:
+    const QCPGraphDataContainer *container;
+    quint64 revision, modifyRevision;
+    bool dataBeyondVisibleEnd; // appended data points can't become visible, see getVisibleDataBounds
+    const QCPAxis *keyAxis, *valueAxis;
+    QCPRange keyRange, valueRange;
+    bool keyReversed, valueReversed;
+    QCPAxis::ScaleType keyScaleType, valueScaleType;
+    QRect keyAxisRect, valueAxisRect;
+    QCPDataSelection selection;
+    // pixel geometry of each data segment (unselected segments first):
+    QList<QCPDataRange> segments;
+    int unselectedCount;
+    QVector<QVector<QPointF> > lines, scatters;
+    QVector<bool> scattersValid; // scatters are only computed when a scatter style is set, draw computes missing ones locally
+  };
+  GeometryCache mGeometryCache;
+  
   // reimplemented virtual methods:
   virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const Q_DECL_OVERRIDE;
@@ -5245,20 +5480,21 @@ protected:
   QVector<QPointF> dataToStepRightLines(const QVector<QCPGraphData> &data) const;
   QVector<QPointF> dataToStepCenterLines(const QVector<QCPGraphData> &data) const;
   QVector<QPointF> dataToImpulseLines(const QVector<QCPGraphData> &data) const;
+  bool geometryCacheValid() const;
+  void updateGeometryCache();
+  void invalidateGeometryCache() { mGeometryCache.valid = false; }
   QVector<QCPDataRange> getNonNanSegments(const QVector<QPointF> *lineData, Qt::Orientation keyOrientation) const;
   QVector<QPair<QCPDataRange, QCPDataRange> > getOverlappingSegments(QVector<QCPDataRange> thisSegments, const QVector<QPointF> *thisData, QVector<QCPDataRange> otherSegments, const QVector<QPointF> *otherData) const;
   bool segmentsIntersect(double aLower, double aUpper, double bLower, double bUpper, int &bPrecedence) const;
   QPointF getFillBasePoint(QPointF matchingDataPoint) const;
   const QPolygonF getFillPolygon(const QVector<QPointF> *lineData, QCPDataRange segment) const;
   const QPolygonF getChannelFillPolygon(const QVector<QPointF> *lineData, QCPDataRange thisSegment, const QVector<QPointF> *otherData, QCPDataRange otherSegment) const;
-  int findIndexBelowX(const QVector<QPointF> *data, double x) const;
-  int findIndexAboveX(const QVector<QPointF> *data, double x) const;
-  int findIndexBelowY(const QVector<QPointF> *data, double y) const;
-  int findIndexAboveY(const QVector<QPointF> *data, double y) const;
+  int findKeyPixelBound(const QVector<QPointF> *data, double keyPixel, bool upperBound, int begin, int end) const;
   double pointDistance(const QPointF &pixelPoint, QCPGraphDataContainer::const_iterator &closestData) const;
   
   friend class QCustomPlot;
   friend class QCPLegend;
+  friend class QCPLayer;
 };
 Q_DECLARE_METATYPE(QCPGraph::LineStyle)
 
@@ -5307,6 +5543,7 @@ class QCP_LIB_DECL QCPCurve : public QCPAbstractPlottable1D<QCPCurveData>
   Q_PROPERTY(QCPScatterStyle scatterStyle READ scatterStyle WRITE setScatterStyle)
   Q_PROPERTY(int scatterSkip READ scatterSkip WRITE setScatterSkip)
   Q_PROPERTY(LineStyle lineStyle READ lineStyle WRITE setLineStyle)
+  Q_PROPERTY(bool adaptiveSampling READ adaptiveSampling WRITE setAdaptiveSampling)
   /// \endcond
 public:
   /*!
@@ -5327,6 +5564,7 @@ public:
   QCPScatterStyle scatterStyle() const { return mScatterStyle; }
   int scatterSkip() const { return mScatterSkip; }
   LineStyle lineStyle() const { return mLineStyle; }
+  bool adaptiveSampling() const { return mAdaptiveSampling; }
   
   // setters:
   void setData(QSharedPointer<QCPCurveDataContainer> data);
@@ -5335,6 +5573,7 @@ public:
   void setScatterStyle(const QCPScatterStyle &style);
   void setScatterSkip(int skip);
   void setLineStyle(LineStyle style);
+  void setAdaptiveSampling(bool enabled);
   
   // non-property methods:
   void addData(const QVector<double> &t, const QVector<double> &keys, const QVector<double> &values, bool alreadySorted=false);
@@ -5352,6 +5591,7 @@ protected:
   QCPScatterStyle mScatterStyle;
   int mScatterSkip;
   LineStyle mLineStyle;
+  bool mAdaptiveSampling;
   
   // reimplemented virtual methods:
   virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
@@ -5723,6 +5963,9 @@ public:
   void clearAlpha();
   void fill(double z);
   void fillAlpha(unsigned char alpha);
+  double *cellData();
+  void pushValueRow(const double *values);
+  int ringOffset() const { return mRingOffset; }
   bool isEmpty() const { return mIsEmpty; }
   void coordToCell(double key, double value, int *keyIndex, int *valueIndex) const;
   void cellToCoord(int keyIndex, int valueIndex, double *key, double *value) const;
@@ -5738,8 +5981,11 @@ protected:
   unsigned char *mAlpha;
   QCPRange mDataBounds;
   bool mDataModified;
+  int mRingOffset; // storage row of value index 0, see pushValueRow
+  int mPushedRows; // rows pushed since the map image was last updated
   
   bool createAlpha(bool initializeOpaque=true);
+  int ringRow(int valueIndex) const { return mRingOffset == 0 ? valueIndex : (valueIndex+mRingOffset)%mValueSize; }
   
   friend class QCPColorMap;
 };
@@ -5814,6 +6060,9 @@ protected:
   virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const Q_DECL_OVERRIDE;
   
+  // non-virtual methods:
+  bool updatePushedRows();
+  
   friend class QCustomPlot;
   friend class QCPLegend;
 };
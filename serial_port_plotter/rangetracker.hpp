@@ -0,0 +1,147 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#ifndef RANGETRACKER_HPP
+#define RANGETRACKER_HPP
+
+#include <deque>
+#include <limits>
+#include "qcustomplot/qcustomplot.h"
+
+/**
+ * @brief 增量维护一条曲线的数值范围
+ *
+ * 数据按X轴递增的顺序追加（滚动显示）。全部数据的最小/最大值直接累计；
+ * 可见窗口 [lower, +inf) 的最小/最大值用单调队列维护，窗口左边界只向右移动，
+ * 所以每个点最多进出队列一次，每帧的代价是均摊 O(1)。
+ */
+class RangeTracker
+{
+public:
+    RangeTracker() { clear(); }
+
+    void clear()
+    {
+        m_minQueue.clear();
+        m_maxQueue.clear();
+        m_total = QCPRange();
+        m_count = 0;
+        m_lastKey = -std::numeric_limits<double>::max();
+        m_windowLower = -std::numeric_limits<double>::max();
+    }
+
+    /* 追加一个点，key 必须不小于之前的 key */
+    void add (double key, double value)
+    {
+        if (qIsNaN (value))
+            return;
+
+        if (m_count == 0)
+        {
+            m_total = QCPRange (value, value);
+        }
+        else
+        {
+            if (value < m_total.lower) m_total.lower = value;
+            if (value > m_total.upper) m_total.upper = value;
+        }
+        m_count++;
+        m_lastKey = key;
+
+        while (!m_minQueue.empty() && m_minQueue.back().value >= value)
+            m_minQueue.pop_back();
+        m_minQueue.push_back (Entry {key, value});
+        while (!m_maxQueue.empty() && m_maxQueue.back().value <= value)
+            m_maxQueue.pop_back();
+        m_maxQueue.push_back (Entry {key, value});
+    }
+
+    /* 全部数据的范围 */
+    bool totalRange (QCPRange *range) const
+    {
+        if (m_count == 0)
+            return false;
+        *range = m_total;
+        return true;
+    }
+
+    double lastKey() const { return m_lastKey; }
+
+    /* 窗口左边界只能向右移动，向左移动时需要调用 rebuild() */
+    bool canSlideTo (double lower) const { return lower >= m_windowLower; }
+
+    /* 把窗口左边界移动到 lower，丢掉更早的点 */
+    void slideTo (double lower)
+    {
+        m_windowLower = lower;
+        while (!m_minQueue.empty() && m_minQueue.front().key < lower)
+            m_minQueue.pop_front();
+        while (!m_maxQueue.empty() && m_maxQueue.front().key < lower)
+            m_maxQueue.pop_front();
+    }
+
+    /* 窗口 [lower, +inf) 的范围，调用前先 slideTo() */
+    bool windowRange (QCPRange *range) const
+    {
+        if (m_minQueue.empty())
+            return false;
+        *range = QCPRange (m_minQueue.front().value, m_maxQueue.front().value);
+        return true;
+    }
+
+    /* 窗口左边界向左移动后，从曲线数据重新建立队列，只扫描窗口内的数据 */
+    void rebuild (const QCPGraphDataContainer &data, double lower)
+    {
+        m_minQueue.clear();
+        m_maxQueue.clear();
+        m_windowLower = lower;
+
+        QCPRange total = m_total;
+        int count = m_count;
+        for (QCPGraphDataContainer::const_iterator it = data.findBegin (lower, false); it != data.constEnd(); ++it)
+        {
+            add (it->key, it->value);
+        }
+        m_total = total;
+        m_count = count;
+    }
+
+private:
+    struct Entry
+    {
+        double key;
+        double value;
+    };
+
+    std::deque<Entry> m_minQueue;                                                         // value 单调递增
+    std::deque<Entry> m_maxQueue;                                                         // value 单调递减
+    QCPRange m_total;
+    int m_count;
+    double m_lastKey;
+    double m_windowLower;
+};
+
+#endif // RANGETRACKER_HPP
@@ -0,0 +1,54 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#ifndef SERIALFRAME_HPP
+#define SERIALFRAME_HPP
+
+#include <QVector>
+#include <QStringList>
+#include <QMetaType>
+
+/* One parsed message: @v0 v1 v2 ...* */
+struct SerialFrame
+{
+    double timestamp;                                                                     // Monotonic time of the read (seconds)
+    QVector<double> values;                                                               // Fields of the message
+};
+
+/* Everything parsed from one read of a port */
+struct SerialBatch
+{
+    int port;                                                                             // Index of the port in MainWindow
+    int session = 0;                                                                      // Connection the port belongs to, stale batches are dropped
+    QVector<SerialFrame> frames;
+    QVector<SerialFrame> stream;                                                          // Every frame of the read while triggered and recording, for the CSV
+    QStringList text;                                                                     // Lines for the text box (raw or filtered)
+    bool triggered = false;                                                               // frames is one triggered sweep, it replaces the previous one
+    int triggerIndex = 0;                                                                 // Index of the trigger frame in frames
+};
+Q_DECLARE_METATYPE(SerialBatch)
+
+#endif // SERIALFRAME_HPP
@@ -0,0 +1,243 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#include "serialworker.hpp"
+#include <cctype>
+
+/**
+ * @brief Constructor，只保存参数，串口在 open() 中创建
+ * @param port 串口编号
+ * @param session 连接的编号，写入每一批数据，用于丢弃关闭前发出的数据
+ * @param clock 所有串口共用的时间起点
+ */
+SerialWorker::SerialWorker(int port, int session, const QSerialPortInfo &portInfo, int baudRate, QSerialPort::DataBits dataBits,
+                           QSerialPort::Parity parity, QSerialPort::StopBits stopBits, const QElapsedTimer &clock) :
+    QObject (nullptr),
+    m_port (port),
+    m_session (session),
+    m_portInfo (portInfo),
+    m_baudRate (baudRate),
+    m_dataBits (dataBits),
+    m_parity (parity),
+    m_stopBits (stopBits),
+    m_clock (clock)
+{
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief Destructor
+ */
+SerialWorker::~SerialWorker()
+{
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 在工作线程中创建并打开串口
+ * @return true 打开成功
+ */
+bool SerialWorker::open()
+{
+    m_serialPort = new QSerialPort (m_portInfo, this);//创建串口
+
+    if (!m_serialPort->open (QIODevice::ReadWrite))
+    {
+        m_errorString = m_serialPort->errorString();
+        delete m_serialPort;
+        m_serialPort = nullptr;
+        return false;
+    }
+
+    m_serialPort->setBaudRate (m_baudRate);
+    m_serialPort->setParity (m_parity);
+    m_serialPort->setDataBits (m_dataBits);
+    m_serialPort->setStopBits (m_stopBits);
+
+    m_state = WAIT_START;
+    m_receivedData.clear();
+    m_lastReadTime = -1;
+    m_fieldCount = 0;
+
+    /*串口数据读取槽函数*/
+    connect (m_serialPort, SIGNAL(readyRead()), this, SLOT(readData()));
+    return true;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 在工作线程中关闭并删除串口
+ */
+void SerialWorker::close()
+{
+    if (m_serialPort == nullptr)
+        return;
+
+    m_serialPort->close();
+    delete m_serialPort;
+    m_serialPort = nullptr;
+    m_receivedData.clear();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 在工作线程中设置触发条件
+ * @param settings edge 为 TRIGGER_OFF 时每一帧都发送（滚动显示）
+ */
+void SerialWorker::setTrigger (TriggerSettings settings)
+{
+    m_trigger.setSettings (settings);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 在工作线程中设置派生通道
+ * @param derived 已经编译的表达式，结果追加在每一帧的字段后面
+ */
+void SerialWorker::setDerivedChannels (DerivedChannels derived)
+{
+    m_derived = derived;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 在工作线程中设置滤波器链，滤波器的状态重新开始
+ * @param settings stages 为空时不滤波
+ */
+void SerialWorker::setFilters (FilterSettings settings)
+{
+    m_filters.setSettings (settings);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 从串口中读取数据并解析，每次读取只发送一次信号
+ */
+void SerialWorker::readData()
+{
+    QByteArray data = m_serialPort->readAll(); //读取所有数据
+    if (data.isEmpty())//得到的数据是否为空
+        return;
+
+    /* 读取时刻的单调时钟。一次读取到多帧时，按帧尾在数据中的位置在上次读取和这次读取之间插值，
+       否则同一次读取的帧间隔为0，下一次读取的第一帧间隔很大 */
+    double readTime = m_clock.nsecsElapsed() * 1e-9;
+    double chunkStart = m_lastReadTime;
+    if (chunkStart < 0)//第一次读取，按波特率（每字节约10位）估计第一个字节的到达时间
+        chunkStart = readTime - data.size() * 10.0 / m_baudRate;
+    m_lastReadTime = readTime;
+
+    m_bytesReceived.fetch_add (quint64(data.size()), std::memory_order_relaxed);
+
+    if (m_hexCapture.load (std::memory_order_relaxed)) {//十六进制窗口打开时才保存原始数据
+        m_hexRing.push (data.constData(), quint32(data.size()));
+    }
+
+    SerialBatch batch;
+    batch.port = m_port;
+    batch.session = m_session;
+    batch.triggered = m_trigger.enabled();
+
+    bool rawText = m_rawText.load (std::memory_order_relaxed);
+    if (rawText) {//是否要显示过滤前的数据
+        batch.text.append (QString::fromUtf8 (data));
+    }
+
+    const char *temp = data.constData();
+    const int length = data.size();
+    for (int i = 0; i < length; i++) {//遍历数组
+        switch (m_state) {
+        case WAIT_START://等待帧头状态
+            if (temp[i] == START_MSG) {//接收到帧头
+                m_state = IN_MESSAGE;
+                m_receivedData.clear(); //清空数据
+            }
+            break;
+        case IN_MESSAGE://接收到帧头
+            if (temp[i] == END_MSG) {//接收到帧尾
+                m_state = WAIT_START;
+
+                /* 使用空格将它们分割 */
+                const QList<QByteArray> fields = m_receivedData.split (' ');
+                SerialFrame frame;
+                frame.timestamp = chunkStart + (readTime - chunkStart) * (i + 1) / length;
+                m_fieldCount = qMax (m_fieldCount, fields.size());
+                frame.values.reserve (m_fieldCount + m_filters.appendedFields (m_fieldCount) + m_derived.count());//补齐、滤波和派生通道追加时不重新分配
+                for (const QByteArray &field : fields) {
+                    frame.values.append (field.toDouble());
+                }
+                m_parsed.append (frame);
+
+                if (!rawText) {
+                    batch.text.append (QString::fromLatin1 (m_receivedData));
+                }
+            }
+            else if (isdigit (uchar(temp[i])) || isspace (uchar(temp[i])) || temp[i] == '-' || temp[i] == '.')//检查字符是否为数字，空格，'-'，'.'
+            {
+                m_receivedData.append (temp[i]);
+            }
+            break;
+        default: break;
+        }
+    }
+
+    /* 滤波拷贝和派生通道追加在字段后面。字段少的帧先补0（和空字段相同），
+       追加的通道在每一帧中的位置相同，不会画到其它通道的曲线上 */
+    if (m_derived.count() > 0 || m_filters.appendedFields (m_fieldCount) > 0)
+    {
+        for (SerialFrame &frame : m_parsed)
+        {
+            while (frame.values.size() < m_fieldCount)
+                frame.values.append (0);
+        }
+    }
+
+    /* 整批滤波，然后按列计算派生通道，最后交给触发 */
+    m_filters.process (m_parsed);
+    m_derived.apply (m_parsed, m_fieldCount);//chN 只用消息中的字段，不会用到滤波拷贝
+    bool recordStream = batch.triggered && m_recordStream.load (std::memory_order_relaxed);
+    for (SerialFrame &frame : m_parsed)
+    {
+        if (recordStream)//触发时 frames 只有完成的扫描，CSV 保存所有的帧
+        {
+            batch.stream.append (frame);
+        }
+        if (!batch.triggered)
+        {
+            batch.frames.append (frame);
+        }
+        else if (m_trigger.process (frame, &m_sweep, &batch.triggerIndex))//只发送完成的扫描，一次读取完成多次时只保留最新的
+        {
+            batch.frames.swap (m_sweep);
+        }
+    }
+    m_framesReceived.fetch_add (quint64(m_parsed.size()), std::memory_order_relaxed);//触发时 frames 只有完成的扫描，按解析出的帧计数
+    m_parsed.resize (0);
+
+    if (!batch.frames.isEmpty() || !batch.stream.isEmpty() || !batch.text.isEmpty()) {
+        emit framesReady (batch); //发送信号，解析到数据用于显示到绘图区
+    }
+}
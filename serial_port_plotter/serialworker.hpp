@@ -0,0 +1,117 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#ifndef SERIALWORKER_HPP
+#define SERIALWORKER_HPP
+
+#include <QObject>
+#include <QVector>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QtSerialPort/QSerialPort>
+#include <QSerialPortInfo>
+#include <atomic>
+#include "bytering.hpp"
+#include "serialframe.hpp"
+#include "derivedchannels.hpp"
+#include "filterbank.hpp"
+#include "triggerengine.hpp"
+
+#define START_MSG       '@'
+#define END_MSG         '*'
+
+#define WAIT_START      1
+#define IN_MESSAGE      2
+#define UNDEFINED       3
+
+/**
+ * Reads and parses one serial port. Lives in its own QThread so a busy
+ * port never blocks the GUI or the other ports.
+ */
+class SerialWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SerialWorker(int port, int session, const QSerialPortInfo &portInfo, int baudRate, QSerialPort::DataBits dataBits,
+                          QSerialPort::Parity parity, QSerialPort::StopBits stopBits, const QElapsedTimer &clock);
+    ~SerialWorker();
+
+    QString portName() const { return m_portInfo.portName(); }
+    QString errorString() const { return m_errorString; }
+
+    /* Thread safe accessors used by the GUI thread */
+    ByteRing *hexRing() { return &m_hexRing; }
+    void setHexCapture (bool enable) { m_hexCapture.store (enable, std::memory_order_relaxed); }
+    void setRawText (bool enable) { m_rawText.store (enable, std::memory_order_relaxed); }
+    void setRecordStream (bool enable) { m_recordStream.store (enable, std::memory_order_relaxed); }
+    quint64 bytesReceived() const { return m_bytesReceived.load (std::memory_order_relaxed); }
+    quint64 framesReceived() const { return m_framesReceived.load (std::memory_order_relaxed); }
+
+public slots:
+    bool open();                                                                          // Must run in the worker thread
+    void close();                                                                         // Must run in the worker thread
+    void setTrigger(TriggerSettings settings);                                            // Must run in the worker thread
+    void setDerivedChannels(DerivedChannels derived);                                     // Must run in the worker thread
+    void setFilters(FilterSettings settings);                                             // Must run in the worker thread
+
+signals:
+    void framesReady(SerialBatch batch);                                                  // Emitted once per read
+
+private slots:
+    void readData();
+
+private:
+    int m_port;
+    int m_session;
+    QSerialPortInfo m_portInfo;
+    int m_baudRate;
+    QSerialPort::DataBits m_dataBits;
+    QSerialPort::Parity m_parity;
+    QSerialPort::StopBits m_stopBits;
+    QElapsedTimer m_clock;                                                                // Shared epoch, so ports line up in time
+    QString m_errorString;
+
+    QSerialPort *m_serialPort = nullptr;
+    QByteArray m_receivedData;                                                            // Message being received
+    int m_state = WAIT_START;                                                             // State of receiving message from port
+    double m_lastReadTime = -1;                                                           // Clock of the previous read, frames of a read are spread from here
+    TriggerEngine m_trigger;                                                              // Only triggered sweeps are emitted while enabled
+    DerivedChannels m_derived;                                                            // Appended to every frame before the trigger sees it
+    FilterBank m_filters;                                                                 // Runs on the fields before the derived channels
+    QVector<SerialFrame> m_parsed;                                                        // Frames of the current read, filtered as one batch
+    int m_fieldCount = 0;                                                                 // Most fields seen in a frame, shorter frames are padded before channels are appended
+    QVector<SerialFrame> m_sweep;
+
+    ByteRing m_hexRing;
+    std::atomic<bool> m_hexCapture { false };
+    std::atomic<bool> m_rawText { false };
+    std::atomic<bool> m_recordStream { false };                                           // Also send the frames outside of the sweeps (SerialBatch::stream)
+    std::atomic<quint64> m_bytesReceived { 0 };
+    std::atomic<quint64> m_framesReceived { 0 };
+};
+
+#endif // SERIALWORKER_HPP
@@ -0,0 +1,271 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#include "spectrumworker.hpp"
+#include <qmath.h>
+
+/**
+ * @brief Constructor
+ */
+SpectrumWorker::SpectrumWorker(QObject *parent) :
+    QObject (parent)
+{
+    prepare();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 在工作线程中设置窗函数、FFT点数、重叠和平均次数
+ * @param settings window 为 SPECTRUM_OFF 时不计算频谱
+ */
+void SpectrumWorker::setSettings (SpectrumSettings settings)
+{
+    /* FFT点数取不超过 size 的2的幂 */
+    int size = 2;
+    while (size * 2 <= settings.size)
+        size *= 2;
+    settings.size = size;
+    settings.overlap = qBound (0, settings.overlap, 99);
+    settings.averages = qMax (settings.averages, 1);
+    settings.firstField = qMax (settings.firstField, 0);
+
+    bool rebuild = settings.size != m_settings.size || settings.window != m_settings.window;
+    m_settings = settings;
+    m_hop = qMax (m_settings.size * (100 - m_settings.overlap) / 100, 1);
+    if (rebuild)
+        prepare();
+    clear();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 丢掉缓存的采样和平均值，缓存本身保留
+ */
+void SpectrumWorker::clear()
+{
+    for (QVector<Channel> &port : m_ports)
+    {
+        for (Channel &channel : port)
+        {
+            channel.head = 0;
+            channel.count = 0;
+            channel.pending = 0;
+            channel.power.fill (0);
+            channel.averaged = 0;
+            channel.updated = false;
+        }
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 计算窗函数和FFT用的表
+ *
+ * 幅度按窗函数的系数之和归一化，正弦信号的谱峰就是它的幅度。
+ */
+void SpectrumWorker::prepare()
+{
+    const int n = m_settings.size;
+
+    m_window.resize (n);
+    double sum = 0;
+    for (int i = 0; i < n; i++)
+    {
+        double phase = 2 * M_PI * i / n;//周期窗，频谱泄漏比对称窗小
+        if (m_settings.window == SPECTRUM_BLACKMAN)
+            m_window[i] = 0.42 - 0.5 * qCos (phase) + 0.08 * qCos (2 * phase);
+        else
+            m_window[i] = 0.5 - 0.5 * qCos (phase);
+        sum += m_window[i];
+    }
+    m_amplitudeScale = 2.0 / sum;
+
+    m_cos.resize (n / 2);
+    m_sin.resize (n / 2);
+    for (int i = 0; i < n / 2; i++)
+    {
+        m_cos[i] = qCos (2 * M_PI * i / n);
+        m_sin[i] = -qSin (2 * M_PI * i / n);
+    }
+
+    int bits = 0;
+    while ((1 << bits) < n)
+        bits++;
+    m_bitReverse.resize (n);
+    for (int i = 0; i < n; i++)
+    {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++)
+        {
+            if (i & (1 << b))
+                reversed |= 1 << (bits - 1 - b);
+        }
+        m_bitReverse[i] = reversed;
+    }
+
+    m_re.resize (n);
+    m_im.resize (n);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 在工作线程中处理一次读取的数据，每个通道每收到 m_hop 个新采样做一次FFT
+ * @param batch 串口线程一次读取解析出来的数据
+ */
+void SpectrumWorker::addBatch (SerialBatch batch)
+{
+    if (m_settings.window == SPECTRUM_OFF || batch.port < 0)
+        return;
+
+    if (m_ports.size() <= batch.port)
+        m_ports.resize (batch.port + 1);
+    QVector<Channel> &port = m_ports[batch.port];
+
+    /* 两次触发扫描之间的数据不连续，重新开始填充和平均；没有扫描的批次只有文本或 CSV 数据 */
+    if (batch.triggered && !batch.frames.isEmpty())
+    {
+        for (Channel &channel : port)
+        {
+            channel.head = 0;
+            channel.count = 0;
+            channel.pending = 0;
+            channel.power.fill (0);
+            channel.averaged = 0;
+        }
+    }
+
+    const int n = m_settings.size;
+    for (const SerialFrame &frame : batch.frames)
+    {
+        for (int i = m_settings.firstField; i < frame.values.size(); i++)
+        {
+            int index = i - m_settings.firstField;
+            if (port.size() <= index)
+                port.resize (index + 1);
+            Channel &channel = port[index];
+            if (channel.samples.size() != n)
+            {
+                channel.samples.resize (n);
+                channel.power.resize (n / 2 + 1);
+                channel.power.fill (0);
+                channel.head = 0;
+                channel.count = 0;
+                channel.pending = 0;
+                channel.averaged = 0;
+            }
+
+            /* NaN/Inf 会一直留在平均值里，按0处理 */
+            double value = frame.values[i];
+            channel.samples[channel.head] = qIsFinite (value) ? value : 0;
+            channel.head = (channel.head + 1) % n;
+            channel.count = qMin (channel.count + 1, n);
+            channel.pending++;
+            if (channel.count == n && channel.pending >= m_hop)
+            {
+                transform (channel);
+                channel.pending = 0;
+                channel.updated = true;
+            }
+        }
+    }
+
+    SpectrumBatch spectra;
+    spectra.port = batch.port;
+    spectra.size = n;
+    for (int c = 0; c < port.size(); c++)
+    {
+        Channel &channel = port[c];
+        if (!channel.updated)
+            continue;
+        channel.updated = false;
+
+        QVector<double> db (channel.power.size());
+        for (int k = 0; k < db.size(); k++)
+        {
+            db[k] = channel.power[k] > 0 ? qMax (10 * log10 (channel.power[k]), SPECTRUM_FLOOR_DB) : SPECTRUM_FLOOR_DB;
+        }
+        spectra.channels.append (c);
+        spectra.spectra.append (db);
+    }
+
+    if (!spectra.channels.isEmpty())
+        emit spectrumReady (spectra);
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 对环形缓冲中的采样加窗做FFT，功率谱加到平均值中
+ *
+ * 基2迭代FFT，输入按位反转的顺序直接写入工作数组。前 averages 次是算术平均，
+ * 之后是指数平均，相当于最近 averages 次的平均。
+ */
+void SpectrumWorker::transform (Channel &channel)
+{
+    const int n = m_settings.size;
+    double *re = m_re.data();
+    double *im = m_im.data();
+
+    /* 最旧的采样在 head 处 */
+    for (int i = 0; i < n; i++)
+    {
+        int j = m_bitReverse[i];
+        re[j] = channel.samples[(channel.head + i) % n] * m_window[i];
+        im[j] = 0;
+    }
+
+    for (int length = 2; length <= n; length *= 2)
+    {
+        const int half = length / 2;
+        const int step = n / length;
+        for (int start = 0; start < n; start += length)
+        {
+            for (int k = 0; k < half; k++)
+            {
+                const double wr = m_cos[k * step];
+                const double wi = m_sin[k * step];
+                const int a = start + k;
+                const int b = a + half;
+                const double tr = re[b] * wr - im[b] * wi;
+                const double ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+
+    channel.averaged = qMin (channel.averaged + 1, m_settings.averages);
+    const double weight = 1.0 / channel.averaged;
+    const double scale = m_amplitudeScale * m_amplitudeScale;
+    for (int k = 0; k <= n / 2; k++)
+    {
+        double power = (re[k] * re[k] + im[k] * im[k]) * scale;
+        if (k == 0 || k == n / 2)//直流和奈奎斯特频率没有对称的负频率分量
+            power *= 0.25;
+        channel.power[k] += (power - channel.power[k]) * weight;
+    }
+}
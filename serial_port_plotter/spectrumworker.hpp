@@ -0,0 +1,110 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#ifndef SPECTRUMWORKER_HPP
+#define SPECTRUMWORKER_HPP
+
+#include <QObject>
+#include <QVector>
+#include <QMetaType>
+#include "serialframe.hpp"
+
+/* Spectrum window (index of comboSpectrum) */
+#define SPECTRUM_OFF        0                                                             // No spectrum view
+#define SPECTRUM_HANN       1
+#define SPECTRUM_BLACKMAN   2
+#define SPECTRUM_FLOOR_DB   -200.0                                                        // Amplitude of empty bins
+
+struct SpectrumSettings
+{
+    int window = SPECTRUM_OFF;                                                            // SPECTRUM_*
+    int size = 1024;                                                                      // FFT length, power of two
+    int overlap = 50;                                                                     // Percent of the samples shared by consecutive FFTs
+    int averages = 4;                                                                     // Number of spectra in the running average
+    int firstField = 0;                                                                   // Index of channel 0 in SerialFrame::values
+};
+Q_DECLARE_METATYPE(SpectrumSettings)
+
+/* Newest averaged spectra of the channels of one port */
+struct SpectrumBatch
+{
+    int port;                                                                             // Index of the port in MainWindow
+    int size;                                                                             // FFT length the spectra were computed with
+    QVector<int> channels;                                                                // Channel of each spectrum
+    QVector<QVector<double> > spectra;                                                    // Amplitude in dB of bins 0 .. size / 2
+};
+Q_DECLARE_METATYPE(SpectrumBatch)
+
+/**
+ * Windowed FFTs over the newest samples of every channel of every port.
+ * Lives in its own QThread and is fed straight from the SerialWorker
+ * signals, so the transforms never run on the GUI thread. The window,
+ * twiddle factors and work arrays are only rebuilt when the settings change.
+ */
+class SpectrumWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SpectrumWorker(QObject *parent = nullptr);
+
+public slots:
+    void setSettings(SpectrumSettings settings);                                          // Also drops the buffered samples and averages
+    void addBatch(SerialBatch batch);                                                     // Samples of one read of a port
+    void clear();                                                                         // Drop the buffered samples and averages
+
+signals:
+    void spectrumReady(SpectrumBatch batch);                                              // At most once per addBatch
+
+private:
+    struct Channel
+    {
+        QVector<double> samples;                                                          // Ring of the newest size samples
+        int head = 0;                                                                     // Next write position in samples
+        int count = 0;                                                                    // Valid samples in the ring
+        int pending = 0;                                                                  // New samples since the last FFT
+        QVector<double> power;                                                            // Averaged power of bins 0 .. size / 2
+        int averaged = 0;                                                                 // Spectra in power, up to averages
+        bool updated = false;                                                             // FFT done during the current batch
+    };
+
+    SpectrumSettings m_settings;
+    int m_hop = 1;                                                                        // Samples between consecutive FFTs
+    QVector<QVector<Channel> > m_ports;                                                   // [port][channel]
+
+    QVector<double> m_window;                                                             // Window coefficients
+    double m_amplitudeScale = 0;                                                          // |X| -> amplitude of a sine, for the window
+    QVector<double> m_cos;                                                                // Twiddle factors of the size point FFT
+    QVector<double> m_sin;
+    QVector<int> m_bitReverse;
+    QVector<double> m_re;                                                                 // FFT work arrays
+    QVector<double> m_im;
+
+    void prepare();                                                                       // Window and FFT tables for m_settings
+    void transform(Channel &channel);                                                     // FFT of the ring, added to the average
+};
+
+#endif // SPECTRUMWORKER_HPP
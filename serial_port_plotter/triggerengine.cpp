@@ -0,0 +1,184 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#include "triggerengine.hpp"
+
+#define TRIGGER_ARMED       0                                                             // Waiting for an edge
+#define TRIGGER_CAPTURING   1                                                             // Collecting the post-trigger frames
+#define TRIGGER_HOLDOFF     2                                                             // Ignoring edges after a sweep
+
+/**
+ * @brief Constructor
+ */
+TriggerEngine::TriggerEngine() :
+    m_state (TRIGGER_ARMED)
+{
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 设置触发条件，正在采集的扫描作废
+ */
+void TriggerEngine::setSettings (const TriggerSettings &settings)
+{
+    m_settings = settings;
+    m_settings.preFrames = qMax (m_settings.preFrames, 0);
+    m_settings.postFrames = qMax (m_settings.postFrames, 0);
+    m_settings.hysteresis = qAbs (m_settings.hysteresis);
+    reset();
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 丢掉缓存的帧，重新等待触发
+ */
+void TriggerEngine::reset()
+{
+    m_state = TRIGGER_ARMED;
+    m_history.clear();
+    m_history.resize (m_settings.preFrames);
+    m_historyHead = 0;
+    m_historyCount = 0;
+    m_sweep.clear();
+    m_holdoff = 0;
+    m_armedRising = false;
+    m_armedFalling = false;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 处理一帧数据
+ * @param frame 新的一帧
+ * @param sweep 输出，完成的扫描：预触发帧 + 触发帧 + 触发后的帧
+ * @param triggerIndex 输出，触发帧在 sweep 中的下标
+ * @return true 完成了一次扫描
+ */
+bool TriggerEngine::process (const SerialFrame &frame, QVector<SerialFrame> *sweep, int *triggerIndex)
+{
+    switch (m_state)
+    {
+    case TRIGGER_CAPTURING:
+        m_sweep.append (frame);
+        if (m_sweep.size() - m_triggerIndex - 1 >= m_settings.postFrames)
+            return finishSweep (sweep, triggerIndex);
+        return false;
+
+    case TRIGGER_HOLDOFF:
+        if (m_holdoff > 0)
+        {
+            m_holdoff--;
+            pushHistory (frame);
+            return false;
+        }
+        m_state = TRIGGER_ARMED;
+        /* fall through */
+
+    default:
+        if (m_settings.field >= frame.values.size() || !edgeDetected (frame.values[m_settings.field]))
+        {
+            pushHistory (frame);
+            return false;
+        }
+
+        /* 触发：预触发的帧按时间顺序放在前面 */
+        m_sweep.clear();
+        m_sweep.reserve (m_historyCount + 1 + m_settings.postFrames);
+        int oldest = (m_historyHead - m_historyCount + m_history.size()) % qMax (m_history.size(), 1);
+        for (int i = 0; i < m_historyCount; i++)
+        {
+            m_sweep.append (m_history[(oldest + i) % m_history.size()]);
+        }
+        m_historyCount = 0;
+        m_triggerIndex = m_sweep.size();
+        m_sweep.append (frame);
+        m_state = TRIGGER_CAPTURING;
+        if (m_settings.postFrames == 0)
+            return finishSweep (sweep, triggerIndex);
+        return false;
+    }
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 保存到预触发环形缓冲区
+ */
+void TriggerEngine::pushHistory (const SerialFrame &frame)
+{
+    if (m_history.isEmpty())
+        return;
+
+    m_history[m_historyHead] = frame;
+    m_historyHead = (m_historyHead + 1) % m_history.size();
+    m_historyCount = qMin (m_historyCount + 1, m_history.size());
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 带迟滞的边沿检测
+ *
+ * 上升沿：信号先低于 level - hysteresis 才算准备好，然后达到 level 时触发；下降沿相反。
+ * 噪声在 level 附近来回穿越时不会反复触发。
+ */
+bool TriggerEngine::edgeDetected (double value)
+{
+    bool fired = false;
+
+    if (m_settings.edge & TRIGGER_RISING)
+    {
+        if (value < m_settings.level - m_settings.hysteresis)
+            m_armedRising = true;
+        else if (m_armedRising && value >= m_settings.level)
+            fired = true;
+    }
+    if (m_settings.edge & TRIGGER_FALLING)
+    {
+        if (value > m_settings.level + m_settings.hysteresis)
+            m_armedFalling = true;
+        else if (m_armedFalling && value <= m_settings.level)
+            fired = true;
+    }
+
+    if (fired)
+    {
+        m_armedRising = false;
+        m_armedFalling = false;
+    }
+    return fired;
+}
+/** ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+/**
+ * @brief 扫描完成，进入释抑
+ */
+bool TriggerEngine::finishSweep (QVector<SerialFrame> *sweep, int *triggerIndex)
+{
+    sweep->swap (m_sweep);
+    m_sweep.clear();
+    *triggerIndex = m_triggerIndex;
+    m_holdoff = m_settings.holdoffFrames;
+    m_state = TRIGGER_HOLDOFF;
+    return true;
+}
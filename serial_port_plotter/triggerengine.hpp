@@ -0,0 +1,87 @@
+/***************************************************************************
+**  This file is part of Serial Port Plotter                              **
+**                                                                        **
+**                                                                        **
+**  Serial Port Plotter is a program for plotting integer data from       **
+**  serial port using Qt and QCustomPlot                                  **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: agent                                                **
+**           Contact: agent@local                                         **
+**           Date: 18.10.26                                               **
+****************************************************************************/
+
+#ifndef TRIGGERENGINE_HPP
+#define TRIGGERENGINE_HPP
+
+#include <QVector>
+#include <QMetaType>
+#include "serialframe.hpp"
+
+/* Trigger edge (index of comboTrigger), bit 0 rising, bit 1 falling */
+#define TRIGGER_OFF         0                                                             // Rolling display, every frame is plotted
+#define TRIGGER_RISING      1
+#define TRIGGER_FALLING     2
+#define TRIGGER_BOTH        3
+
+/* Trigger configuration, sent from the GUI thread to every SerialWorker */
+struct TriggerSettings
+{
+    int edge = TRIGGER_OFF;                                                               // TRIGGER_*
+    int field = 0;                                                                        // Index of the trigger channel in SerialFrame::values
+    double level = 0;
+    double hysteresis = 0;                                                                // Distance from level the signal must reach before an edge counts
+    int preFrames = 0;                                                                    // Frames kept before the trigger frame
+    int postFrames = 0;                                                                   // Frames captured after the trigger frame
+    int holdoffFrames = 0;                                                                // Frames ignored after a sweep before re-arming
+};
+Q_DECLARE_METATYPE(TriggerSettings)
+
+/**
+ * Edge trigger over the parsed frames of one port. Runs in the acquisition
+ * thread, so frames outside of the triggered sweeps never reach the GUI.
+ */
+class TriggerEngine
+{
+public:
+    TriggerEngine();
+
+    void setSettings (const TriggerSettings &settings);                                   // Also drops the captured frames
+    bool enabled() const { return m_settings.edge != TRIGGER_OFF; }
+    void reset();
+                                                                                          // Feed one frame, true when a sweep is complete
+    bool process (const SerialFrame &frame, QVector<SerialFrame> *sweep, int *triggerIndex);
+
+private:
+    TriggerSettings m_settings;
+    int m_state;
+
+    QVector<SerialFrame> m_history;                                                       // Ring of the last preFrames frames
+    int m_historyHead = 0;
+    int m_historyCount = 0;
+
+    QVector<SerialFrame> m_sweep;                                                         // Sweep being captured
+    int m_triggerIndex = 0;
+    int m_holdoff = 0;                                                                    // Frames left until re-arming
+    bool m_armedRising = false;                                                           // Signal was below level - hysteresis
+    bool m_armedFalling = false;                                                          // Signal was above level + hysteresis
+
+    void pushHistory (const SerialFrame &frame);
+    bool edgeDetected (double value);
+    bool finishSweep (QVector<SerialFrame> *sweep, int *triggerIndex);
+};
+
+#endif // TRIGGERENGINE_HPP